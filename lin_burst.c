@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *
+ * lin_burst.c - LIN checksum error burst detection
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lin_burst.h"
+
+#define LIN_BURST_OLDEST_BIT ((lin_burst_history_t)1 << (LIN_BURST_WINDOW - 1))
+
+/******************************************************************************/
+
+static uint8_t lin_burst_window_update(lin_burst_window_t *w, const bool ok, const lin_burst_config_t *config) {
+	// The failure count is kept in step with the history bits by subtracting
+	// the bit falling out of the window and adding the one coming in, so the
+	// cost is the same regardless of window size. Returns 1 if a burst was
+	// raised, 2 if cleared, otherwise 0.
+	if(w->history & LIN_BURST_OLDEST_BIT) w->fail_count--;
+	w->history <<= 1;
+	if(!ok) {
+		w->history |= 1;
+		w->fail_count++;
+	}
+
+	if(!w->burst && w->fail_count >= config->raise_threshold) {
+		w->burst = true;
+		return 1;
+	} else if(w->burst && w->fail_count <= config->clear_threshold) {
+		w->burst = false;
+		return 2;
+	}
+
+	return 0;
+}
+
+void lin_burst_init(lin_burst_t *bd, const lin_burst_config_t *config) {
+	memset(bd, 0, sizeof(*bd));
+	bd->config = config;
+}
+
+uint8_t lin_burst_update(lin_burst_t *bd, const uint8_t fid, const bool ok) {
+	uint8_t events, node;
+
+	events = lin_burst_window_update(&bd->fid[fid & 0x3F], ok, bd->config);
+
+	if(bd->config->node_map != NULL) {
+		node = bd->config->node_map[fid & 0x3F];
+		if(node < LIN_BURST_NODES) {
+			events |= lin_burst_window_update(&bd->node[node], ok, bd->config) << 2;
+		}
+	}
+
+	return events;
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+ *
+ * lin_burst.h - LIN checksum error burst detection header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_BURST_H__
+#define LIN_BURST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of most recent frames each failure rate is taken over. Must be 8, 16
+// or 32. On the STM8 a 16-frame window is used by default to keep RAM usage and
+// shift costs down; on a host, 32.
+#ifndef LIN_BURST_WINDOW
+#ifdef __SDCC
+#define LIN_BURST_WINDOW 16
+#else
+#define LIN_BURST_WINDOW 32
+#endif
+#endif
+
+// Maximum number of nodes that frame IDs may be mapped to.
+#ifndef LIN_BURST_NODES
+#define LIN_BURST_NODES 8
+#endif
+
+#if LIN_BURST_WINDOW == 8
+typedef uint8_t lin_burst_history_t;
+#define LIN_BURST_RATE_SHIFT 5
+#elif LIN_BURST_WINDOW == 16
+typedef uint16_t lin_burst_history_t;
+#define LIN_BURST_RATE_SHIFT 4
+#elif LIN_BURST_WINDOW == 32
+typedef uint32_t lin_burst_history_t;
+#define LIN_BURST_RATE_SHIFT 3
+#else
+#error "LIN_BURST_WINDOW must be 8, 16 or 32"
+#endif
+
+// Value in a node map for frame IDs not belonging to any node.
+#define LIN_BURST_NO_NODE 0xFF
+
+// Event flags, as returned by lin_burst_update().
+#define LIN_BURST_EVT_FID_RAISE 0x01
+#define LIN_BURST_EVT_FID_CLEAR 0x02
+#define LIN_BURST_EVT_NODE_RAISE 0x04
+#define LIN_BURST_EVT_NODE_CLEAR 0x08
+
+typedef struct {
+	lin_burst_history_t history; // One bit per frame, set on failure; bit 0 is newest
+	uint8_t fail_count;
+	bool burst;
+} lin_burst_window_t;
+
+typedef struct {
+	// Node index (less than LIN_BURST_NODES) of each frame ID's publisher, or
+	// LIN_BURST_NO_NODE. May be NULL if per-node tracking is not wanted.
+	const uint8_t *node_map;
+	// A burst is raised when the number of failures in the window reaches the
+	// raise threshold, and cleared when it falls to the clear threshold.
+	uint8_t raise_threshold;
+	uint8_t clear_threshold;
+} lin_burst_config_t;
+
+typedef struct {
+	const lin_burst_config_t *config;
+	lin_burst_window_t fid[64];
+	lin_burst_window_t node[LIN_BURST_NODES];
+} lin_burst_t;
+
+// Failure rate of a window in fixed-point 0.8 format (i.e. 256 = 100%, but
+// saturating at 255).
+#define lin_burst_rate(w) ((uint8_t)((w)->fail_count >= LIN_BURST_WINDOW ? 255 : (w)->fail_count << LIN_BURST_RATE_SHIFT))
+
+extern void lin_burst_init(lin_burst_t *bd, const lin_burst_config_t *config);
+extern uint8_t lin_burst_update(lin_burst_t *bd, const uint8_t fid, const bool ok);
+
+#endif // LIN_BURST_H__
@@ -0,0 +1,215 @@
+/*******************************************************************************
+ *
+ * lin_bus.c - LIN bus driver
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lin_checksum.h"
+#include "lin_frames.h"
+#include "lin_master.h"
+#include "lin_stats.h"
+#include "lin_trace.h"
+#include "lin_bus.h"
+
+/******************************************************************************/
+
+static void lin_bus_count(lin_bus_t *bus, const uint8_t pid, const uint8_t type) {
+	if(bus->stats != NULL) lin_stats_update(bus->stats, pid, type);
+}
+
+static uint8_t lin_bus_header(lin_bus_t *bus, const uint8_t pid) {
+	// For a frame this node publishes, the response is put together now, so
+	// that what is sent (and read back) can't be changed part way through by
+	// the application updating the frame's data. The master also takes the
+	// response to any header not in its table (i.e. an event-triggered frame),
+	// of as many bytes as arrive before the slot ends.
+	const lin_frame_def_t *frame = lin_frame_find(bus->table->frames, bus->table->frame_count, pid);
+	const uint8_t *data;
+
+	bus->pid = pid;
+	bus->pos = 0;
+
+	if(frame == NULL) {
+		if(bus->master == NULL) return LIN_BUS_EVT_NONE;
+		bus->frame = LIN_BUS_NO_FRAME;
+		bus->len = sizeof(bus->rx);
+		bus->state = LIN_BUS_STATE_RESPONSE;
+		return LIN_BUS_EVT_NONE;
+	}
+
+	bus->frame = (uint8_t)(frame - bus->table->frames);
+	bus->len = frame->data_len + 1;
+	bus->state = LIN_BUS_STATE_RESPONSE;
+
+	if(!(frame->flags & LIN_FRAME_FLAG_PUBLISH)) return LIN_BUS_EVT_NONE;
+
+	data = &bus->table->data[frame->data_offset];
+	memcpy(bus->tx, data, frame->data_len);
+	bus->tx[frame->data_len] = lin_calculate_checksum_enhanced(lin_frame_checksum_pid(frame), data, frame->data_len);
+
+	return LIN_BUS_EVT_HEADER;
+}
+
+static uint8_t lin_bus_response(lin_bus_t *bus) {
+	// A complete response is either the read back of one this node sent, or
+	// one received. The master leaves those it receives for the next slot to
+	// handle, as only the schedule knows what it was expecting.
+	const lin_frame_def_t *frame;
+
+	if(bus->frame == LIN_BUS_NO_FRAME) return LIN_BUS_EVT_NONE;
+
+	frame = &bus->table->frames[bus->frame];
+	if(frame->flags & LIN_FRAME_FLAG_PUBLISH) {
+		if(lin_verify_readback(lin_frame_checksum_pid(frame), bus->tx, bus->rx, frame->data_len) != LIN_READBACK_OK) return LIN_BUS_EVT_TX_ERROR;
+		lin_bus_count(bus, bus->pid, LIN_STATS_OK);
+		return LIN_BUS_EVT_TX_OK;
+	}
+	if(bus->master != NULL) return LIN_BUS_EVT_NONE;
+
+	if(!lin_frame_receive(bus->table, bus->frame, bus->rx, bus->rx[frame->data_len])) {
+		lin_bus_count(bus, bus->pid, LIN_STATS_CKSUM);
+		return LIN_BUS_EVT_RX_ERROR;
+	}
+	lin_bus_count(bus, bus->pid, LIN_STATS_OK);
+	return LIN_BUS_EVT_RX_OK;
+}
+
+void lin_bus_init(lin_bus_t *bus, const lin_frame_table_t *table, lin_master_t *master) {
+	memset(bus, 0, sizeof(*bus));
+	bus->table = table;
+	bus->master = master;
+	bus->frame = LIN_BUS_NO_FRAME;
+}
+
+uint8_t lin_bus_isr(lin_bus_t *bus, volatile uint8_t *uart) {
+	// Receive interrupt handling shared by every bus: each channel's handler
+	// passes its own context and the base address of its UART. Reading the
+	// status register then the data register clears any error flags. A byte
+	// with a framing error is discarded, which includes the zero byte received
+	// along with a break.
+	const uint8_t sr = uart[LIN_BUS_UART_SR];
+	uint8_t evt = LIN_BUS_EVT_NONE, b;
+
+	if(uart[LIN_BUS_UART_CR4] & LIN_BUS_UART_CR4_LBDF) {
+		uart[LIN_BUS_UART_CR4] &= ~LIN_BUS_UART_CR4_LBDF;
+		evt = lin_bus_break(bus);
+	}
+
+	if(sr & LIN_BUS_UART_SR_RXNE) {
+		b = uart[LIN_BUS_UART_DR];
+		if(!(sr & LIN_BUS_UART_SR_FE)) evt = lin_bus_rx(bus, b);
+	}
+
+	return evt;
+}
+
+uint8_t lin_bus_break(lin_bus_t *bus) {
+	// A break starts a new frame. A slave still waiting for the rest of a
+	// response has had it time out; the master finds out from the schedule.
+	const uint8_t evt = (bus->state == LIN_BUS_STATE_RESPONSE && bus->master == NULL ? LIN_BUS_EVT_TIMEOUT : LIN_BUS_EVT_NONE);
+
+	bus->state = LIN_BUS_STATE_SYNC;
+	if(evt == LIN_BUS_EVT_TIMEOUT) lin_bus_count(bus, bus->pid, LIN_STATS_TIMEOUT);
+
+	lin_trace(LIN_TRACE_BREAK, bus->pid, evt);
+	return evt;
+}
+
+uint8_t lin_bus_rx(lin_bus_t *bus, const uint8_t b) {
+	// Handles each byte received, whether from a UART or any other source
+	// (e.g. a software UART). Anything between a header not of interest and
+	// the next break is ignored.
+	uint8_t fid, evt;
+
+	switch(bus->state) {
+		case LIN_BUS_STATE_SYNC:
+			if(b != 0x55) {
+				bus->state = LIN_BUS_STATE_IDLE;
+				lin_trace(LIN_TRACE_HEADER, b, LIN_BUS_EVT_SYNC_ERROR);
+				return LIN_BUS_EVT_SYNC_ERROR;
+			}
+			bus->state = LIN_BUS_STATE_PID;
+			break;
+		case LIN_BUS_STATE_PID:
+			bus->state = LIN_BUS_STATE_IDLE;
+			if(!lin_verify_protected_id(b, &fid)) {
+				lin_bus_count(bus, fid, LIN_STATS_PARITY);
+				lin_trace(LIN_TRACE_HEADER, b, LIN_BUS_EVT_PID_ERROR);
+				return LIN_BUS_EVT_PID_ERROR;
+			}
+			evt = lin_bus_header(bus, b);
+			lin_trace(LIN_TRACE_HEADER, b, evt);
+			return evt;
+		case LIN_BUS_STATE_RESPONSE:
+			bus->rx[bus->pos++] = b;
+			if(bus->pos == bus->len) {
+				bus->state = LIN_BUS_STATE_IDLE;
+				evt = lin_bus_response(bus);
+				lin_trace(LIN_TRACE_RESPONSE, bus->pid, evt);
+				return evt;
+			}
+			break;
+	}
+
+	return LIN_BUS_EVT_NONE;
+}
+
+uint8_t lin_bus_master_slot(lin_bus_t *bus) {
+	// To be called at the start of each slot on a bus this node is master of.
+	// Whatever was received in the previous slot is handled by the schedule
+	// engine, with the outcome put in the context. Only responses from slaves
+	// are counted, those the master sent having been counted as read back; an
+	// event-triggered frame with no response or a collision is not an error.
+	// Returns the protected ID of the header to send, or zero for none.
+	const lin_frame_table_t *table = bus->master->config->table;
+	const uint8_t frame = bus->master->frame;
+	const uint8_t len = (bus->pos > 0 ? bus->pos - 1 : 0);
+	uint8_t pid;
+
+	bus->result = lin_master_response(bus->master, bus->rx, len, bus->rx[len]);
+	bus->state = LIN_BUS_STATE_IDLE;
+	bus->pos = 0;
+
+	if(frame == LIN_MASTER_NO_FRAME) {
+		if(bus->result == LIN_MASTER_RESP_OK) lin_bus_count(bus, bus->pid, LIN_STATS_OK);
+	} else if(!(table->frames[frame].flags & LIN_FRAME_FLAG_PUBLISH)) {
+		switch(bus->result) {
+			case LIN_MASTER_RESP_OK:
+				lin_bus_count(bus, table->frames[frame].pid, LIN_STATS_OK);
+				break;
+			case LIN_MASTER_RESP_ERROR:
+				lin_bus_count(bus, table->frames[frame].pid, LIN_STATS_CKSUM);
+				break;
+			case LIN_MASTER_RESP_NONE:
+				lin_bus_count(bus, table->frames[frame].pid, LIN_STATS_TIMEOUT);
+				break;
+		}
+	}
+
+	pid = lin_master_next(bus->master);
+	lin_trace(LIN_TRACE_SLOT, pid, bus->result);
+	return pid;
+}
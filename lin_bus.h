@@ -0,0 +1,96 @@
+/*******************************************************************************
+ *
+ * lin_bus.h - LIN bus driver header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_BUS_H__
+#define LIN_BUS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_frames.h"
+#include "lin_master.h"
+#include "lin_stats.h"
+
+// Greatest data length of a frame.
+#define LIN_BUS_MAX_DATA 8
+
+// Receive states.
+#define LIN_BUS_STATE_IDLE 0 // Waiting for break
+#define LIN_BUS_STATE_SYNC 1
+#define LIN_BUS_STATE_PID 2
+#define LIN_BUS_STATE_RESPONSE 3
+
+// Value of current frame index when the header is not of a frame in the table.
+#define LIN_BUS_NO_FRAME 0xFF
+
+// Events, as returned by lin_bus_isr(), lin_bus_break() and lin_bus_rx().
+#define LIN_BUS_EVT_NONE 0
+#define LIN_BUS_EVT_HEADER 1 // Header of a frame this node publishes; send its response
+#define LIN_BUS_EVT_RX_OK 2 // Response to a subscribed frame stored
+#define LIN_BUS_EVT_RX_ERROR 3 // Response to a subscribed frame failed checksum
+#define LIN_BUS_EVT_TX_OK 4 // Response sent by this node read back correctly
+#define LIN_BUS_EVT_TX_ERROR 5 // Response sent by this node read back wrong (bit error)
+#define LIN_BUS_EVT_TIMEOUT 6 // Response incomplete when the next break came
+#define LIN_BUS_EVT_SYNC_ERROR 7
+#define LIN_BUS_EVT_PID_ERROR 8
+
+// Base addresses of the STM8 UARTs capable of LIN. UART2 and UART3 are never
+// both present on the same device, so share an address.
+#define LIN_BUS_UART1 ((volatile uint8_t *)0x5230)
+#define LIN_BUS_UART2 ((volatile uint8_t *)0x5240)
+#define LIN_BUS_UART3 ((volatile uint8_t *)0x5240)
+
+// Offsets of registers from a UART's base address, which are the same for all
+// of them, and their bits used.
+#define LIN_BUS_UART_SR 0
+#define LIN_BUS_UART_DR 1
+#define LIN_BUS_UART_CR4 7
+#define LIN_BUS_UART_SR_RXNE 0x20
+#define LIN_BUS_UART_SR_FE 0x02
+#define LIN_BUS_UART_CR4_LBDF 0x10
+
+// Everything about one LIN bus, so that any number of buses can be run by the
+// same code, each with its own context.
+typedef struct {
+	const lin_frame_table_t *table;
+	lin_master_t *master; // Schedule engine if this node is master of the bus, otherwise NULL
+	lin_stats_t *stats; // Statistics to count frames and errors in, or NULL (the default)
+	uint8_t state;
+	uint8_t pid;
+	uint8_t frame; // Index in frame table of current frame, or LIN_BUS_NO_FRAME
+	uint8_t len; // Number of response bytes expected, including checksum
+	uint8_t pos; // Number of response bytes received so far
+	uint8_t result; // Master only: outcome of response in previous slot
+	uint8_t tx[LIN_BUS_MAX_DATA + 1]; // Response to send for a published frame, data then checksum
+	uint8_t rx[LIN_BUS_MAX_DATA + 1]; // Response received (or read back), data then checksum
+} lin_bus_t;
+
+extern void lin_bus_init(lin_bus_t *bus, const lin_frame_table_t *table, lin_master_t *master);
+extern uint8_t lin_bus_isr(lin_bus_t *bus, volatile uint8_t *uart);
+extern uint8_t lin_bus_break(lin_bus_t *bus);
+extern uint8_t lin_bus_rx(lin_bus_t *bus, const uint8_t b);
+extern uint8_t lin_bus_master_slot(lin_bus_t *bus);
+
+#endif // LIN_BUS_H__
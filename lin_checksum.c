@@ -28,6 +28,8 @@
 #include <stdbool.h>
 #include "lin_checksum.h"
 
+#ifdef __SDCC
+
 #if !defined(__SDCCCALL) || __SDCCCALL != 1
 #error "SDCC calling convention other than 1 not supported"
 #endif
@@ -41,65 +43,308 @@
 #define ASM_RETURN ret
 #endif
 
-// A look-up table is actually smaller than the code to do the protected ID
-// parity bits calculation. Array index is frame ID value.
-static const uint8_t lin_pid_lut[64] = {
-	0x80, 0xC1, 0x42, 0x03, 0xC4, 0x85, 0x06, 0x47,
-	0x08, 0x49, 0xCA, 0x8B, 0x4C, 0x0D, 0x8E, 0xCF,
-	0x50, 0x11, 0x92, 0xD3, 0x14, 0x55, 0xD6, 0x97,
-	0xD8, 0x99, 0x1A, 0x5B, 0x9C, 0xDD, 0x5E, 0x1F,
-	0x20, 0x61, 0xE2, 0xA3, 0x64, 0x25, 0xA6, 0xE7,
-	0xA8, 0xE9, 0x6A, 0x2B, 0xEC, 0xAD, 0x2E, 0x6F,
-	0xF0, 0xB1, 0x32, 0x73, 0xB4, 0xF5, 0x76, 0x37,
-	0x78, 0x39, 0xBA, 0xFB, 0x3C, 0x7D, 0xFE, 0xBF,
-};
+#endif // __SDCC
+
+#ifdef __SDCC
+
+// Far pointer used by the far checksum kernel, as it may only be accessed
+// indirectly from an absolute memory location. Stored big-endian, so the
+// 24-bit address is the low three bytes of a lin_far_ptr_t.
+static uint8_t lin_far_ptr[3];
+
+#endif // __SDCC
 
 /******************************************************************************/
 
-static uint8_t lin_calculate_checksum_intermediate(uint8_t cksum_init, const void *data, uint8_t data_len) __naked {
-	(void)cksum_init; // a
+#ifdef __SDCC
+
+static uint8_t lin_calculate_checksum_intermediate(const void *data, uint8_t data_len) __naked {
 	(void)data; // x
-	(void)data_len; // stack
+	(void)data_len; // a
 	
 	// The checksum calculation is done with assembly here because that makes it
 	// trivial to handle the addition of carry resulting from any overflow.
+	// Both arguments arrive in registers and the loop count is kept in Y, so no
+	// stack is used beyond the return address and there is no read-modify-write
+	// of memory for each byte.
 	
 	__asm
-		; Offsets and sizes for all stack-held arguments.
-		DATA_LEN_SP_OFFSET = ASM_SP_ARGS_OFFSET + 1
-		DATA_LEN_SIZE = 1
-	
-		; Given initial value for checksum is already in A reg.
-		
-		; Bail out early if data length is zero.
-		tnz (DATA_LEN_SP_OFFSET, sp)
+		; Bail out early if data length is zero. Checksum is zero in A reg.
+		tnz a
 		jreq 0002$
 		
-		; Ensure carry is zero before we begin.
+		; Move data length into Y reg to serve as loop counter. Then clear A reg
+		; for checksum and ensure carry is zero before we begin.
+		clrw y
+		ld yl, a
+		clr a
 		rcf
 		
 	0001$:
 		; Add next data byte to checksum, including carry from any overflow from
-		; previous addition. Increment the data pointer.
+		; previous addition. Increment the data pointer. Neither INCW or DECW
+		; affect the carry flag, so it survives to the next addition.
 		adc a, (x)
 		incw x
 		
 		; Decrement data length. Loop around if not yet zero.
-		dec (DATA_LEN_SP_OFFSET, sp)
+		decw y
+		jrne 0001$
+		
+		; There might be leftover carry from the final addition, so add it too.
+		adc a, #0
+		
+	0002$:
+		; Return value is un-inverted checksum in A reg.
+		ASM_RETURN
+	__endasm;
+}
+
+static uint8_t lin_calculate_checksum_intermediate_far(const lin_far_ptr_t *data, uint8_t data_len) __naked {
+	(void)data; // x
+	(void)data_len; // a
+	
+	// As above, but reading the data with LDF from a 24-bit address. LDF can
+	// only load into the A reg, so the checksum is kept on the stack instead.
+	// Rather than being pointed to by the X reg, the 24-bit address must be in
+	// memory, so it goes in the lin_far_ptr variable, and the Y reg is used as
+	// an index from it. Any previous value of that variable is saved on entry
+	// and restored on exit, so that a call from an interrupt handler does not
+	// upset one already in progress when the interrupt occurred.
+	
+	__asm
+		; Bail out early if data length is zero. Checksum is zero in A reg.
+		tnz a
+		jreq 0002$
+		
+		; Save existing far pointer value on stack.
+		push _lin_far_ptr+2
+		push _lin_far_ptr+1
+		push _lin_far_ptr+0
+		
+		; Move data length into Y reg for now.
+		clrw y
+		ld yl, a
+		
+		; Copy low three bytes of 32-bit far address pointed to by X reg to far
+		; pointer.
+		ld a, (1, x)
+		ld _lin_far_ptr+0, a
+		ld a, (2, x)
+		ld _lin_far_ptr+1, a
+		ld a, (3, x)
+		ld _lin_far_ptr+2, a
+		
+		; Data length becomes loop counter in X reg, and Y reg is zeroed to be
+		; the index into the data.
+		exgw x, y
+		clrw y
+		
+		; Push initial zero checksum on stack. Ensure carry is zero before we
+		; begin.
+		push #0
+		rcf
+		
+	0001$:
+		; Load next data byte from far address, add checksum to it, including
+		; carry from any overflow from previous addition, and save back as new
+		; checksum. None of LDF, LD, INCW or DECW affect the carry flag, so it
+		; survives to the next addition. Increment the data index.
+		ldf a, ([_lin_far_ptr], y)
+		adc a, (1, sp)
+		ld (1, sp), a
+		incw y
+		
+		; Decrement data length. Loop around if not yet zero.
+		decw x
 		jrne 0001$
 		
 		; There might be leftover carry from the final addition, so add it too.
 		adc a, #0
 		
+		; Discard checksum from stack and restore saved far pointer value.
+		addw sp, #1
+		pop _lin_far_ptr+0
+		pop _lin_far_ptr+1
+		pop _lin_far_ptr+2
+		
 	0002$:
 		; Return value is un-inverted checksum in A reg.
+		ASM_RETURN
+	__endasm;
+}
+
+#else
+
+// Portable equivalent of the above for when the library is compiled for a host
+// machine (i.e. for use by the host tools). Any carry out of the 8-bit sum is
+// immediately wrapped around and added back in.
+static uint8_t lin_calculate_checksum_intermediate(const void *data, uint8_t data_len) {
+	const uint8_t *ptr = data;
+	uint16_t sum = 0;
+	
+	while(data_len--) {
+		sum += *ptr++;
+		if(sum > 0xFF) sum -= 0xFF;
+	}
+	
+	return sum;
+}
+
+#endif // __SDCC
+
+static inline uint8_t lin_checksum_add(const uint8_t sum, const uint8_t val) {
+	// Adds a value to an intermediate checksum with the carry wrapped around.
+	// Because the intermediate result only depends on the total of all bytes
+	// summed, this gives the same as having started the checksum from the value.
+	uint16_t res = (uint16_t)sum + val;
+	return (uint8_t)(res + (res >> 8));
+}
+
+uint8_t lin_calculate_checksum_classic(const void *data, const uint8_t data_len) {
+	return ~lin_calculate_checksum_intermediate(data, data_len);
+}
+
+uint8_t lin_calculate_checksum_enhanced(const uint8_t pid, const void *data, const uint8_t data_len) {
+	return ~lin_checksum_add(lin_calculate_checksum_intermediate(data, data_len), pid);
+}
+
+bool lin_verify_checksum_classic(const uint8_t cksum, const void *data, const uint8_t data_len) {
+	return (cksum + lin_calculate_checksum_intermediate(data, data_len) == 0xFF);
+}
+
+bool lin_verify_checksum_enhanced(const uint8_t cksum, const uint8_t pid, const void *data, const uint8_t data_len) {
+	return (cksum + lin_checksum_add(lin_calculate_checksum_intermediate(data, data_len), pid) == 0xFF);
+}
+
+uint8_t lin_reseed_checksum(const uint8_t cksum, const uint8_t old_pid, const uint8_t new_pid) {
+	// Swapping one PID for another in the sum is adding the new one and the
+	// ones' complement of the old one (i.e. subtracting it), as the carry is
+	// wrapped around, so the data need not be summed again. As the new PID is
+	// never zero, neither is the result, so there is no ambiguity between the
+	// two forms of zero that ones' complement arithmetic has.
+	return ~lin_checksum_add(lin_checksum_add((uint8_t)~cksum, (uint8_t)~old_pid), new_pid);
+}
+
+#ifdef __SDCC
+
+void lin_verify_checksum_batch(const lin_frame_t *frames, const uint8_t count, uint8_t *results) __naked {
+	(void)frames; // x
+	(void)count; // a
+	(void)results; // stack
+	
+	// Verifies every frame in a single pass, with the checksum loop inlined, so
+	// there is no call, argument passing or PID look-up per frame. The result
+	// for each frame is shifted into a byte on the stack that starts out with
+	// only its top bit set; when that bit is shifted out after 8 frames, the
+	// byte is complete and is written to the results bitmap.
+	
+	__asm
+		; Offsets and sizes for all stack-held arguments and locals.
+		LOCALS_SIZE = 4
+		FRAME_SP_OFFSET = 1
+		COUNT_SP_OFFSET = 3
+		BITS_SP_OFFSET = 4
+		RESULTS_SP_OFFSET = LOCALS_SIZE + ASM_SP_ARGS_OFFSET + 1
+		RESULTS_SIZE = 2
+		
+		; Offsets of fields in lin_frame_t struct, and its size.
+		FRAME_DATA_OFFSET = 0
+		FRAME_DATA_LEN_OFFSET = 2
+		FRAME_PID_OFFSET = 3
+		FRAME_CKSUM_OFFSET = 4
+		FRAME_SIZE = 5
+		
+		; Nothing to do if there are no frames.
+		tnz a
+		jreq 0009$
+		
+		; Make room for locals and initialise them. Pointer to first frame is
+		; already in X reg.
+		sub sp, #LOCALS_SIZE
+		ld (COUNT_SP_OFFSET, sp), a
+		ld a, #0x80
+		ld (BITS_SP_OFFSET, sp), a
+		
+	0001$:
+		; Save pointer to current frame, then get its data length in A reg and
+		; data pointer in X reg.
+		ldw (FRAME_SP_OFFSET, sp), x
+		ld a, (FRAME_DATA_LEN_OFFSET, x)
+		ldw x, (x)
+		
+		; Sum the data, exactly as lin_calculate_checksum_intermediate() does.
+		tnz a
+		jreq 0003$
+		clrw y
+		ld yl, a
+		clr a
+		rcf
+	0002$:
+		adc a, (x)
+		incw x
+		decw y
+		jrne 0002$
+		adc a, #0
+		
+	0003$:
+		; Add the PID (zero for classic), with carry wrapped around, then the
+		; received checksum. Verified only if the result is 0xFF with no carry.
+		; Set carry flag if so, otherwise clear it.
+		ldw x, (FRAME_SP_OFFSET, sp)
+		add a, (FRAME_PID_OFFSET, x)
+		adc a, #0
+		add a, (FRAME_CKSUM_OFFSET, x)
+		jrc 0004$
+		cp a, #0xFF
+		jrne 0004$
+		scf
+		jra 0005$
+	0004$:
+		rcf
+		
+	0005$:
+		; Shift result into results byte. If the marker bit comes out, the byte
+		; is complete, so write it out, advance the results pointer, and start
+		; a new byte.
+		rrc (BITS_SP_OFFSET, sp)
+		jrnc 0006$
+		ld a, (BITS_SP_OFFSET, sp)
+		ldw y, (RESULTS_SP_OFFSET, sp)
+		ld (y), a
+		incw y
+		ldw (RESULTS_SP_OFFSET, sp), y
+		ld a, #0x80
+		ld (BITS_SP_OFFSET, sp), a
+		
+	0006$:
+		; Advance to next frame. Loop around if there are any more.
+		addw x, #FRAME_SIZE
+		dec (COUNT_SP_OFFSET, sp)
+		jrne 0001$
 		
+		; If there is a partially-filled results byte, shift the results down
+		; until the marker bit comes out, then write it out.
+		ld a, (BITS_SP_OFFSET, sp)
+		cp a, #0x80
+		jreq 0008$
+	0007$:
+		srl a
+		jrnc 0007$
+		ldw y, (RESULTS_SP_OFFSET, sp)
+		ld (y), a
+		
+	0008$:
+		; Discard locals.
+		addw sp, #LOCALS_SIZE
+		
+	0009$:
 #ifdef ASM_CALLEE_CLEANUP
 		; Callee must adjust stack on medium memory model where return value is
 		; 16 bits or smaller (or void). So we must discard stack args and return
 		; a different way.
 		ldw x, (1, sp)
-		addw sp, #(DATA_LEN_SIZE + ASM_SP_ARGS_OFFSET)
+		addw sp, #(RESULTS_SIZE + ASM_SP_ARGS_OFFSET)
 		jp (x)
 #else
 		ASM_RETURN
@@ -107,27 +352,255 @@ static uint8_t lin_calculate_checksum_intermediate(uint8_t cksum_init, const voi
 	__endasm;
 }
 
-uint8_t lin_calculate_checksum_classic(const void *data, const uint8_t data_len) {
-	return ~lin_calculate_checksum_intermediate(0, data, data_len);
+#else
+
+void lin_verify_checksum_batch(const lin_frame_t *frames, const uint8_t count, uint8_t *results) {
+	for(uint8_t i = 0; i < count; i++) {
+		if((i & 7) == 0) results[i >> 3] = 0;
+		if(lin_verify_checksum_enhanced(frames[i].cksum, frames[i].pid, frames[i].data, frames[i].data_len)) {
+			results[i >> 3] |= (1 << (i & 7));
+		}
+	}
 }
 
-uint8_t lin_calculate_checksum_enhanced(const uint8_t pid, const void *data, const uint8_t data_len) {
-	return ~lin_calculate_checksum_intermediate(pid, data, data_len);
+#endif // __SDCC
+
+#ifdef __SDCC
+
+bool lin_verify_checksum_compare(const lin_frame_t *frame, const void *stored, uint8_t *changed) __naked {
+	(void)frame; // x
+	(void)stored; // stack
+	(void)changed; // stack
+	
+	// Each data byte is both added to the checksum and compared to the stored
+	// copy in the same pass. Because the accumulator is also needed for the
+	// comparison, the carry from each addition is wrapped around immediately
+	// rather than carried into the next, which gives the same sum. Bytes that
+	// differ have the bit for their position set in the changed bitmap.
+	
+	__asm
+		; Offsets and sizes for all stack-held arguments and locals.
+		LOCALS_SIZE = 5
+		SUM_SP_OFFSET = 1
+		COUNT_SP_OFFSET = 2
+		BITS_SP_OFFSET = 3
+		MASK_SP_OFFSET = 4
+		CKSUM_SP_OFFSET = 5
+		STORED_SP_OFFSET = LOCALS_SIZE + ASM_SP_ARGS_OFFSET + 1
+		CHANGED_SP_OFFSET = STORED_SP_OFFSET + 2
+		ARGS_SIZE = 4
+		
+		; Offsets of fields in lin_frame_t struct.
+		FRAME_DATA_LEN_OFFSET = 2
+		FRAME_PID_OFFSET = 3
+		FRAME_CKSUM_OFFSET = 4
+		
+		; Make room for locals and initialise them from the frame. The sum
+		; starts with the PID (zero for classic).
+		sub sp, #LOCALS_SIZE
+		ld a, (FRAME_PID_OFFSET, x)
+		ld (SUM_SP_OFFSET, sp), a
+		ld a, (FRAME_CKSUM_OFFSET, x)
+		ld (CKSUM_SP_OFFSET, sp), a
+		clr (BITS_SP_OFFSET, sp)
+		ld a, #1
+		ld (MASK_SP_OFFSET, sp), a
+		ld a, (FRAME_DATA_LEN_OFFSET, x)
+		ld (COUNT_SP_OFFSET, sp), a
+		jreq 0003$
+		
+		; Data pointer in X reg, stored copy pointer in Y reg.
+		ldw x, (x)
+		ldw y, (STORED_SP_OFFSET, sp)
+		
+	0001$:
+		; Add byte to sum, wrapping carry around.
+		ld a, (x)
+		add a, (SUM_SP_OFFSET, sp)
+		adc a, #0
+		ld (SUM_SP_OFFSET, sp), a
+		
+		; Compare with stored byte, and if different, set bit in bitmap for
+		; this position.
+		ld a, (x)
+		xor a, (y)
+		jreq 0002$
+		ld a, (MASK_SP_OFFSET, sp)
+		or a, (BITS_SP_OFFSET, sp)
+		ld (BITS_SP_OFFSET, sp), a
+		
+	0002$:
+		; Advance to next position and loop around if there are any more.
+		sll (MASK_SP_OFFSET, sp)
+		incw x
+		incw y
+		dec (COUNT_SP_OFFSET, sp)
+		jrne 0001$
+		
+	0003$:
+		; Output the changed bitmap.
+		ldw x, (CHANGED_SP_OFFSET, sp)
+		ld a, (BITS_SP_OFFSET, sp)
+		ld (x), a
+		
+		; Verified only if the received checksum plus the sum is 0xFF with no
+		; carry. Return true if so, otherwise false.
+		ld a, (SUM_SP_OFFSET, sp)
+		add a, (CKSUM_SP_OFFSET, sp)
+		jrc 0004$
+		inc a
+		jrne 0004$
+		ld a, #1
+		jra 0005$
+	0004$:
+		clr a
+		
+	0005$:
+		; Discard locals.
+		addw sp, #LOCALS_SIZE
+		
+#ifdef ASM_CALLEE_CLEANUP
+		; Callee must adjust stack on medium memory model where return value is
+		; 16 bits or smaller (or void). So we must discard stack args and return
+		; a different way.
+		ldw x, (1, sp)
+		addw sp, #(ARGS_SIZE + ASM_SP_ARGS_OFFSET)
+		jp (x)
+#else
+		ASM_RETURN
+#endif
+	__endasm;
 }
 
-bool lin_verify_checksum_classic(const uint8_t cksum, const void *data, const uint8_t data_len) {
-	return (cksum + lin_calculate_checksum_intermediate(0, data, data_len) == 0xFF);
+#else
+
+bool lin_verify_checksum_compare(const lin_frame_t *frame, const void *stored, uint8_t *changed) {
+	const uint8_t *data = frame->data;
+	*changed = 0;
+	for(uint8_t i = 0; i < frame->data_len; i++) {
+		if(data[i] != ((const uint8_t *)stored)[i]) *changed |= (1 << i);
+	}
+	return lin_verify_checksum_enhanced(frame->cksum, frame->pid, frame->data, frame->data_len);
 }
 
-bool lin_verify_checksum_enhanced(const uint8_t cksum, const uint8_t pid, const void *data, const uint8_t data_len) {
-	return (cksum + lin_calculate_checksum_intermediate(pid, data, data_len) == 0xFF);
+#endif // __SDCC
+
+#ifdef __SDCC
+
+uint8_t lin_verify_readback(const uint8_t pid, const void *sent, const void *echo, const uint8_t data_len) __naked {
+	(void)pid; // a
+	(void)sent; // x
+	(void)echo; // stack
+	(void)data_len; // stack
+	
+	// Each echoed byte is compared to the one that was sent and, if the same,
+	// added to the checksum, so the echoed checksum byte following the data can
+	// be checked without a second pass. As for lin_verify_checksum_compare(),
+	// the accumulator is needed for the comparison, so the carry from each
+	// addition is wrapped around immediately. The first mismatch ends the loop,
+	// as nothing after it matters.
+	
+	__asm
+		; Offsets and sizes for all stack-held arguments and locals.
+		LOCALS_SIZE = 2
+		SUM_SP_OFFSET = 1
+		COUNT_SP_OFFSET = 2
+		ECHO_SP_OFFSET = LOCALS_SIZE + ASM_SP_ARGS_OFFSET + 1
+		DATA_LEN_SP_OFFSET = ECHO_SP_OFFSET + 2
+		ARGS_SIZE = 3
+		
+		; Make room for locals and initialise them. The sum starts with the PID
+		; (zero for classic).
+		sub sp, #LOCALS_SIZE
+		ld (SUM_SP_OFFSET, sp), a
+		
+		; Sent data pointer in Y reg, echoed data pointer in X reg. Skip the
+		; loop if data length is zero.
+		ldw y, x
+		ldw x, (ECHO_SP_OFFSET, sp)
+		ld a, (DATA_LEN_SP_OFFSET, sp)
+		ld (COUNT_SP_OFFSET, sp), a
+		jreq 0002$
+		
+	0001$:
+		; Compare echoed byte with sent byte. Stop at the first that differs.
+		ld a, (x)
+		cp a, (y)
+		jrne 0004$
+		
+		; Add byte to sum, wrapping carry around.
+		add a, (SUM_SP_OFFSET, sp)
+		adc a, #0
+		ld (SUM_SP_OFFSET, sp), a
+		
+		; Advance to next position and loop around if there are any more.
+		incw x
+		incw y
+		dec (COUNT_SP_OFFSET, sp)
+		jrne 0001$
+		
+	0002$:
+		; All data matched, and X reg now points to the echoed checksum. It is
+		; good only if added to the sum it gives 0xFF with no carry, in which
+		; case return 0xFF.
+		ld a, (x)
+		add a, (SUM_SP_OFFSET, sp)
+		jrc 0004$
+		inc a
+		jrne 0004$
+		ld a, #0xFF
+		jra 0005$
+		
+	0004$:
+		; Return position of mismatch, being data length less remaining count
+		; (which is zero for the checksum).
+		ld a, (DATA_LEN_SP_OFFSET, sp)
+		sub a, (COUNT_SP_OFFSET, sp)
+		
+	0005$:
+		; Discard locals.
+		addw sp, #LOCALS_SIZE
+		
+#ifdef ASM_CALLEE_CLEANUP
+		; Callee must adjust stack on medium memory model where return value is
+		; 16 bits or smaller (or void). So we must discard stack args and return
+		; a different way.
+		ldw x, (1, sp)
+		addw sp, #(ARGS_SIZE + ASM_SP_ARGS_OFFSET)
+		jp (x)
+#else
+		ASM_RETURN
+#endif
+	__endasm;
+}
+
+#else
+
+uint8_t lin_verify_readback(const uint8_t pid, const void *sent, const void *echo, const uint8_t data_len) {
+	for(uint8_t i = 0; i < data_len; i++) {
+		if(((const uint8_t *)echo)[i] != ((const uint8_t *)sent)[i]) return i;
+	}
+	return (lin_verify_checksum_enhanced(((const uint8_t *)echo)[data_len], pid, echo, data_len) ? LIN_READBACK_OK : data_len);
+}
+
+#endif // __SDCC
+
+#ifdef __SDCC
+
+uint8_t lin_calculate_checksum_classic_far(const lin_far_ptr_t *data, const uint8_t data_len) {
+	return ~lin_calculate_checksum_intermediate_far(data, data_len);
 }
 
-uint8_t lin_get_protected_id(const uint8_t fid) {	
-	return lin_pid_lut[fid & 0x3F];
+uint8_t lin_calculate_checksum_enhanced_far(const uint8_t pid, const lin_far_ptr_t *data, const uint8_t data_len) {
+	return ~lin_checksum_add(lin_calculate_checksum_intermediate_far(data, data_len), pid);
 }
 
-bool lin_verify_protected_id(const uint8_t pid, uint8_t *fid_out) {
-	*fid_out = pid & 0x3F;
-	return (lin_pid_lut[*fid_out] == pid);
+bool lin_verify_checksum_classic_far(const uint8_t cksum, const lin_far_ptr_t *data, const uint8_t data_len) {
+	return (cksum + lin_calculate_checksum_intermediate_far(data, data_len) == 0xFF);
 }
+
+bool lin_verify_checksum_enhanced_far(const uint8_t cksum, const uint8_t pid, const lin_far_ptr_t *data, const uint8_t data_len) {
+	return (cksum + lin_checksum_add(lin_calculate_checksum_intermediate_far(data, data_len), pid) == 0xFF);
+}
+
+#endif // __SDCC
@@ -30,10 +30,38 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Record of a received frame for batch verification. A PID of zero (which is
+// never a valid protected ID) selects the classic checksum.
+typedef struct {
+	const void *data;
+	uint8_t data_len;
+	uint8_t pid;
+	uint8_t cksum;
+} lin_frame_t;
+
+// Returned by lin_verify_readback() when every echoed byte is correct.
+#define LIN_READBACK_OK 0xFF
+
+#ifdef __SDCC
+// A 24-bit address anywhere in the STM8 memory space (e.g. flash above 0xFFFF),
+// held in the low three bytes.
+typedef uint32_t lin_far_ptr_t;
+#endif
+
 extern uint8_t lin_calculate_checksum_classic(const void *data, const uint8_t data_len);
 extern uint8_t lin_calculate_checksum_enhanced(const uint8_t pid, const void *data, const uint8_t data_len);
 extern bool lin_verify_checksum_classic(const uint8_t cksum, const void *data, const uint8_t data_len);
 extern bool lin_verify_checksum_enhanced(const uint8_t cksum, const uint8_t pid, const void *data, const uint8_t data_len);
+extern uint8_t lin_reseed_checksum(const uint8_t cksum, const uint8_t old_pid, const uint8_t new_pid);
+#ifdef __SDCC
+extern uint8_t lin_calculate_checksum_classic_far(const lin_far_ptr_t *data, const uint8_t data_len);
+extern uint8_t lin_calculate_checksum_enhanced_far(const uint8_t pid, const lin_far_ptr_t *data, const uint8_t data_len);
+extern bool lin_verify_checksum_classic_far(const uint8_t cksum, const lin_far_ptr_t *data, const uint8_t data_len);
+extern bool lin_verify_checksum_enhanced_far(const uint8_t cksum, const uint8_t pid, const lin_far_ptr_t *data, const uint8_t data_len);
+#endif
+extern void lin_verify_checksum_batch(const lin_frame_t *frames, const uint8_t count, uint8_t *results);
+extern bool lin_verify_checksum_compare(const lin_frame_t *frame, const void *stored, uint8_t *changed);
+extern uint8_t lin_verify_readback(const uint8_t pid, const void *sent, const void *echo, const uint8_t data_len);
 extern uint8_t lin_get_protected_id(const uint8_t fid);
 extern bool lin_verify_protected_id(const uint8_t pid, uint8_t *fid_out);
 
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ *
+ * lin_frames.c - LIN frame and signal definition tables
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_checksum.h"
+#include "lin_frames.h"
+#include "lin_trace.h"
+
+/******************************************************************************/
+
+const lin_frame_def_t *lin_frame_find(const lin_frame_def_t *frames, const uint8_t count, const uint8_t pid) {
+	// A node uses only a handful of frames, so a linear search is the smallest
+	// and, for so few, no slower than anything else. As the table is ordered
+	// by frame ID, the search can stop as soon as it has gone past the one
+	// wanted. The whole PID must match, so one with bad parity is not found.
+	const uint8_t fid = pid & 0x3F;
+
+	for(uint8_t i = 0; i < count; i++) {
+		if((frames[i].pid & 0x3F) >= fid) {
+			return (frames[i].pid == pid ? &frames[i] : NULL);
+		}
+	}
+
+	return NULL;
+}
+
+static void lin_frame_set_flag(uint8_t *flags, const uint8_t i) {
+	flags[i >> 3] |= (1 << (i & 7));
+}
+
+bool lin_frame_receive(const lin_frame_table_t *table, const uint8_t index, const void *data, const uint8_t cksum) {
+	// The checksum is verified and the received data compared with the stored
+	// copy in one pass. Only if verified is anything stored, and then only the
+	// bytes that changed, with flags set for the frame and for each signal
+	// whose bits differ (not merely one sharing a changed byte). Returns
+	// whether the checksum was verified.
+	const lin_frame_def_t *frame = &table->frames[index];
+	const lin_signal_def_t *sig;
+	const uint8_t *rx = data;
+	uint8_t *stored = &table->data[frame->data_offset];
+	lin_frame_t rx_frame;
+	uint8_t changed, first, last, mask, lo, hi;
+
+	rx_frame.data = data;
+	rx_frame.data_len = frame->data_len;
+	rx_frame.pid = lin_frame_checksum_pid(frame);
+	rx_frame.cksum = cksum;
+	if(!lin_verify_checksum_compare(&rx_frame, stored, &changed)) {
+		lin_trace(LIN_TRACE_VERIFY_ERROR, frame->pid, 0);
+		return false;
+	}
+	lin_trace(LIN_TRACE_VERIFY_OK, frame->pid, changed);
+	if(changed == 0) return true;
+
+	for(uint8_t i = 0; i < frame->signal_count; i++) {
+		sig = &table->signals[frame->signal_index + i];
+		first = sig->bit_offset >> 3;
+		last = (sig->bit_offset + sig->bit_size - 1) >> 3;
+		for(uint8_t b = first; b <= last; b++) {
+			if(!(changed & (1 << b))) continue;
+			lo = (b == first ? sig->bit_offset & 7 : 0);
+			hi = (b == last ? ((sig->bit_offset + sig->bit_size - 1) & 7) + 1 : 8);
+			mask = (uint8_t)(0xFF << lo) & (uint8_t)(0xFF >> (8 - hi));
+			if((rx[b] ^ stored[b]) & mask) {
+				lin_frame_set_flag(table->signal_flags, frame->signal_index + i);
+				break;
+			}
+		}
+	}
+
+	for(uint8_t b = 0; changed != 0; b++, changed >>= 1) {
+		if(changed & 1) stored[b] = rx[b];
+	}
+
+	lin_frame_set_flag(table->frame_flags, index);
+
+	return true;
+}
+
+#ifdef __SDCC
+
+uint8_t lin_frame_flags_take(uint8_t *flags) __naked {
+	(void)flags; // x
+	
+	// Reads and clears a byte of update flags with interrupts disabled, so
+	// that none set by an interrupt handler in between are lost. The previous
+	// interrupt mask is restored, so this may itself be called from one.
+	
+	__asm
+		push cc
+		sim
+		ld a, (x)
+		clr (x)
+		pop cc
+#ifdef __SDCC_MODEL_LARGE
+		retf
+#else
+		ret
+#endif
+	__endasm;
+}
+
+#else
+
+uint8_t lin_frame_flags_take(uint8_t *flags) {
+	const uint8_t val = *flags;
+	*flags = 0;
+	return val;
+}
+
+#endif // __SDCC
@@ -0,0 +1,81 @@
+/*******************************************************************************
+ *
+ * lin_frames.h - LIN frame and signal definition tables header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_FRAMES_H__
+#define LIN_FRAMES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_checksum.h"
+
+// Flags of a frame definition.
+#define LIN_FRAME_FLAG_CLASSIC 0x01 // Classic checksum, otherwise enhanced
+#define LIN_FRAME_FLAG_PUBLISH 0x02 // Published by this node, otherwise subscribed
+
+// Definition of a frame used by a node, as generated from a LIN description
+// file by the linldf host tool. Tables of these are in ascending order of
+// frame ID.
+typedef struct {
+	uint8_t pid;
+	uint8_t data_len;
+	uint8_t flags;
+	uint8_t data_offset; // Offset of the frame's data in a buffer of all frames
+	uint8_t signal_index; // Index of first signal in signal table
+	uint8_t signal_count;
+} lin_frame_def_t;
+
+// Definition of a signal within a frame's data. Bit offset counts from the
+// least-significant bit of the first data byte, as transmitted.
+typedef struct {
+	uint8_t bit_offset;
+	uint8_t bit_size;
+} lin_signal_def_t;
+
+// A node's frame and signal tables, its buffer of all frames' data, and
+// bitmaps of frames and signals updated (one bit per table entry, bit 0 of
+// the first byte for the first), as generated by linldf.
+typedef struct {
+	const lin_frame_def_t *frames;
+	const lin_signal_def_t *signals;
+	uint8_t *data;
+	uint8_t *frame_flags;
+	uint8_t *signal_flags;
+	uint8_t frame_count;
+} lin_frame_table_t;
+
+// Test whether bit for entry 'i' is set in a bitmap of update flags.
+#define lin_frame_flag_test(flags, i) (((flags)[(i) >> 3] & (1 << ((i) & 7))) != 0)
+
+// The PID to give to the checksum functions for a frame: zero for classic, as
+// the enhanced checksum with a PID of zero is the same as the classic one.
+#define lin_frame_checksum_pid(f) (((f)->flags & LIN_FRAME_FLAG_CLASSIC) ? 0 : (f)->pid)
+
+extern const lin_frame_def_t *lin_frame_find(const lin_frame_def_t *frames, const uint8_t count, const uint8_t pid);
+extern bool lin_frame_receive(const lin_frame_table_t *table, const uint8_t index, const void *data, const uint8_t cksum);
+extern uint8_t lin_frame_flags_take(uint8_t *flags);
+
+#endif // LIN_FRAMES_H__
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ * lin_gateway.c - LIN-to-LIN frame gateway
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_checksum.h"
+#include "lin_trace.h"
+#include "lin_gateway.h"
+
+/******************************************************************************/
+
+uint8_t lin_gateway_forward(const lin_route_t *routes, lin_frame_t *frame) {
+	// The frame record is rewritten in place for the destination bus, with its
+	// data pointer left as it is, so the data is sent from the buffer it was
+	// received into rather than being copied. The checksum is re-seeded from
+	// the change of PID instead of being calculated from the data again. That
+	// can't be done from enhanced to classic, where the PID is removed, as the
+	// result could be either form of zero, so only there is it calculated.
+	const lin_route_t *route = &routes[frame->pid & 0x3F];
+	const uint8_t src_pid = ((route->flags & LIN_ROUTE_FLAG_SRC_CLASSIC) ? 0 : frame->pid);
+
+	if(route->pid == 0 || !lin_verify_checksum_enhanced(frame->cksum, src_pid, frame->data, frame->data_len)) {
+		lin_trace(LIN_TRACE_FORWARD, frame->pid, LIN_GATEWAY_DROP);
+		return LIN_GATEWAY_DROP;
+	}
+
+	if(!(route->flags & LIN_ROUTE_FLAG_DEST_CLASSIC)) {
+		frame->cksum = lin_reseed_checksum(frame->cksum, src_pid, route->pid);
+	} else if(src_pid != 0) {
+		frame->cksum = lin_calculate_checksum_classic(frame->data, frame->data_len);
+	}
+	lin_trace(LIN_TRACE_FORWARD, frame->pid, route->dest);
+	frame->pid = route->pid;
+
+	return route->dest;
+}
@@ -0,0 +1,51 @@
+/*******************************************************************************
+ *
+ * lin_gateway.h - LIN-to-LIN frame gateway header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_GATEWAY_H__
+#define LIN_GATEWAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_checksum.h"
+
+// Flags of a route.
+#define LIN_ROUTE_FLAG_SRC_CLASSIC 0x01 // Classic checksum on source bus, otherwise enhanced
+#define LIN_ROUTE_FLAG_DEST_CLASSIC 0x02 // Classic checksum on destination bus, otherwise enhanced
+
+// Returned by lin_gateway_forward() for a frame that is not forwarded.
+#define LIN_GATEWAY_DROP 0xFF
+
+// Where frames with one frame ID received on a bus are forwarded to. A routing
+// table has one of these for each of the 64 frame IDs.
+typedef struct {
+	uint8_t pid; // Protected ID on destination bus, or zero if not forwarded
+	uint8_t dest; // Index of destination bus
+	uint8_t flags;
+} lin_route_t;
+
+extern uint8_t lin_gateway_forward(const lin_route_t *routes, lin_frame_t *frame);
+
+#endif // LIN_GATEWAY_H__
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ *
+ * lin_master.c - LIN master schedule engine
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lin_checksum.h"
+#include "lin_frames.h"
+#include "lin_master.h"
+
+/******************************************************************************/
+
+static void lin_master_resolve(lin_master_t *m, const lin_slot_t *slot, const uint8_t *data, const uint8_t len) {
+	// Colliding responses are wired-AND on the bus (dominant being zero), so
+	// the first data byte received, which each slave sends as the PID of its
+	// associated frame, has only those bits set that are set in the PID of
+	// every responder. Only associated frames whose PID has all of them set
+	// can have responded, so only those are polled. If there are none (e.g.
+	// the byte itself was corrupted), or no byte was received, all are.
+	const uint8_t *assoc = &m->config->assoc[slot->assoc_index];
+	uint8_t pid;
+
+	m->resolve_count = 0;
+	m->resolve_pos = 0;
+	m->resolve_delay = slot->delay;
+
+	if(len > 0) {
+		for(uint8_t i = 0; i < slot->assoc_count; i++) {
+			pid = m->config->table->frames[assoc[i]].pid;
+			if((pid & data[0]) == data[0]) m->resolve[m->resolve_count++] = assoc[i];
+		}
+	}
+	if(m->resolve_count == 0) {
+		for(uint8_t i = 0; i < slot->assoc_count; i++) m->resolve[m->resolve_count++] = assoc[i];
+	}
+}
+
+static uint8_t lin_master_event_response(lin_master_t *m, const lin_slot_t *slot, const uint8_t *data, const uint8_t len, uint8_t cksum) {
+	// A single response is checksummed with the event-triggered frame's PID,
+	// and its first byte identifies which associated frame it is. Anything
+	// else is taken to be a collision. The checksum for the associated frame's
+	// PID is got by re-seeding, unless that frame is classic.
+	const lin_frame_def_t *frame;
+	uint8_t index;
+
+	if(len == 0) return LIN_MASTER_RESP_NONE;
+
+	if(lin_verify_checksum_enhanced(cksum, slot->pid, data, len)) {
+		for(uint8_t i = 0; i < slot->assoc_count; i++) {
+			index = m->config->assoc[slot->assoc_index + i];
+			frame = &m->config->table->frames[index];
+			if(frame->pid == data[0] && frame->data_len == len) {
+				if(frame->flags & LIN_FRAME_FLAG_CLASSIC) {
+					cksum = lin_calculate_checksum_classic(data, len);
+				} else {
+					cksum = lin_reseed_checksum(cksum, slot->pid, frame->pid);
+				}
+				lin_frame_receive(m->config->table, index, data, cksum);
+				return LIN_MASTER_RESP_OK;
+			}
+		}
+	}
+
+	lin_master_resolve(m, slot, data, len);
+
+	return LIN_MASTER_RESP_COLLISION;
+}
+
+void lin_master_init(lin_master_t *m, const lin_master_config_t *config) {
+	// The first slot is the first of the schedule.
+	memset(m, 0, sizeof(*m));
+	m->config = config;
+	m->slot = config->slot_count - 1;
+	m->frame = LIN_MASTER_NO_FRAME;
+}
+
+uint8_t lin_master_next(lin_master_t *m) {
+	// Advances to the next slot, returning the protected ID of the header to
+	// send, or zero for an empty slot (a sporadic slot with no frame pending).
+	// Collision resolution slots are inserted before the next slot of the
+	// schedule. The frame index and slot length are updated.
+	const lin_slot_t *slot;
+	uint8_t index;
+
+	if(m->resolve_pos < m->resolve_count) {
+		m->frame = m->resolve[m->resolve_pos++];
+		m->delay = m->resolve_delay;
+		return m->config->table->frames[m->frame].pid;
+	}
+
+	if(++m->slot >= m->config->slot_count) m->slot = 0;
+	slot = &m->config->schedule[m->slot];
+	m->delay = slot->delay;
+	m->frame = LIN_MASTER_NO_FRAME;
+
+	switch(slot->type) {
+		case LIN_SLOT_UNCONDITIONAL:
+			m->frame = slot->frame;
+			return m->config->table->frames[m->frame].pid;
+		case LIN_SLOT_EVENT:
+			return slot->pid;
+		case LIN_SLOT_SPORADIC:
+			for(uint8_t i = 0; i < slot->assoc_count; i++) {
+				index = m->config->assoc[slot->assoc_index + i];
+				if(m->pending[index >> 3] & (1 << (index & 7))) {
+					m->pending[index >> 3] &= ~(1 << (index & 7));
+					m->frame = index;
+					return m->config->table->frames[index].pid;
+				}
+			}
+			break;
+	}
+
+	return 0;
+}
+
+uint8_t lin_master_response(lin_master_t *m, const void *data, const uint8_t len, const uint8_t cksum) {
+	// Handles what was received in response to the current header: 'len'
+	// bytes of data (zero if none) and, if any, the checksum. Frames the
+	// master publishes are not responded to by slaves, so are ignored.
+	const lin_slot_t *slot = &m->config->schedule[m->slot];
+	const lin_frame_def_t *frame;
+
+	if(m->frame == LIN_MASTER_NO_FRAME) {
+		if(slot->type == LIN_SLOT_EVENT) return lin_master_event_response(m, slot, data, len, cksum);
+		return LIN_MASTER_RESP_NONE;
+	}
+
+	frame = &m->config->table->frames[m->frame];
+	if(frame->flags & LIN_FRAME_FLAG_PUBLISH) return LIN_MASTER_RESP_OK;
+	if(len == 0) return LIN_MASTER_RESP_NONE;
+	if(len != frame->data_len || !lin_frame_receive(m->config->table, m->frame, data, cksum)) return LIN_MASTER_RESP_ERROR;
+
+	return LIN_MASTER_RESP_OK;
+}
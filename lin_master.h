@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *
+ * lin_master.h - LIN master schedule engine header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_MASTER_H__
+#define LIN_MASTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_frames.h"
+
+// Greatest number of unconditional frames associated with an event-triggered
+// frame, and so of collision resolution slots.
+#ifndef LIN_MASTER_MAX_ASSOC
+#define LIN_MASTER_MAX_ASSOC 8
+#endif
+
+// Types of schedule slot.
+#define LIN_SLOT_UNCONDITIONAL 0
+#define LIN_SLOT_EVENT 1
+#define LIN_SLOT_SPORADIC 2
+
+// Value of current frame index when the header is not of a frame in the table
+// (i.e. of an event-triggered frame), or the slot is empty.
+#define LIN_MASTER_NO_FRAME 0xFF
+
+// Outcomes of a response, as returned by lin_master_response().
+#define LIN_MASTER_RESP_OK 0
+#define LIN_MASTER_RESP_NONE 1
+#define LIN_MASTER_RESP_ERROR 2
+#define LIN_MASTER_RESP_COLLISION 3
+
+typedef struct {
+	uint8_t type;
+	uint8_t frame; // Unconditional: index of frame in frame table
+	uint8_t pid; // Event-triggered: protected ID of the event-triggered frame
+	uint8_t assoc_index; // Event-triggered and sporadic: first index in associated frame list
+	uint8_t assoc_count;
+	uint8_t delay; // Length of slot, in the application's time base ticks
+} lin_slot_t;
+
+typedef struct {
+	const lin_frame_table_t *table;
+	const lin_slot_t *schedule;
+	// Indexes in frame table of the frames associated with each event-triggered
+	// slot, and of the frames of each sporadic slot in descending priority.
+	const uint8_t *assoc;
+	uint8_t slot_count;
+} lin_master_config_t;
+
+typedef struct {
+	const lin_master_config_t *config;
+	uint8_t slot; // Index of current slot
+	uint8_t frame; // Index in frame table of current frame, or LIN_MASTER_NO_FRAME
+	uint8_t delay; // Length of current slot
+	uint8_t pending[8]; // Bitmap of sporadic frames with updated data to send
+	uint8_t resolve[LIN_MASTER_MAX_ASSOC]; // Frames to poll to resolve a collision
+	uint8_t resolve_count;
+	uint8_t resolve_pos;
+	uint8_t resolve_delay;
+} lin_master_t;
+
+// Mark a sporadic frame, by its index in the frame table, as having updated
+// data, so that it is sent in the next sporadic slot it belongs to.
+#define lin_master_sporadic_request(m, i) ((m)->pending[(i) >> 3] |= (1 << ((i) & 7)))
+
+extern void lin_master_init(lin_master_t *m, const lin_master_config_t *config);
+extern uint8_t lin_master_next(lin_master_t *m);
+extern uint8_t lin_master_response(lin_master_t *m, const void *data, const uint8_t len, const uint8_t cksum);
+
+#endif // LIN_MASTER_H__
@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *
+ * lin_stats.c - LIN runtime statistics
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lin_stats.h"
+
+/******************************************************************************/
+
+static inline void lin_stats_increment(uint16_t *count) {
+	if(*count != 0xFFFF) (*count)++;
+}
+
+void lin_stats_init(lin_stats_t *st) {
+	memset(st, 0, sizeof(*st));
+}
+
+void lin_stats_update(lin_stats_t *st, const uint8_t fid, const uint8_t type) {
+	// Meant to be called from an interrupt handler, and only ever from handlers
+	// of the same priority (or with interrupts disabled), so one update can't
+	// interrupt another. The sequence number tells a snapshot being taken that
+	// the counters changed under it. Only the low 6 bits of the frame ID are
+	// used, so a protected ID may be given instead.
+	lin_stats_increment(&st->fid[fid & 0x3F].count[type]);
+	lin_stats_increment(&st->total.count[type]);
+	st->seq++;
+}
+
+void lin_stats_snapshot(const lin_stats_t *st, const uint8_t fid, lin_stats_counters_t *out) {
+	// Copies one frame ID's counters, or the global ones, so that they are
+	// consistent with each other, without disabling interrupts at all. An
+	// update by an interrupt handler always completes before the copy carries
+	// on, so if the sequence number is the same afterwards, there was none
+	// during the copy; otherwise it is simply done again. The counters are
+	// read as volatile so that the copy can't be moved outside the check.
+	const volatile uint16_t *src = (fid == LIN_STATS_TOTAL ? st->total.count : st->fid[fid & 0x3F].count);
+	uint8_t seq;
+
+	do {
+		seq = st->seq;
+		for(uint8_t i = 0; i < LIN_STATS_TYPES; i++) out->count[i] = src[i];
+	} while(seq != st->seq);
+}
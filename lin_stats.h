@@ -0,0 +1,57 @@
+/*******************************************************************************
+ *
+ * lin_stats.h - LIN runtime statistics header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_STATS_H__
+#define LIN_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Types of counter.
+#define LIN_STATS_OK 0 // Frames received or sent correctly
+#define LIN_STATS_PARITY 1 // Protected ID parity errors
+#define LIN_STATS_CKSUM 2 // Checksum errors
+#define LIN_STATS_TIMEOUT 3 // Responses missing or incomplete
+#define LIN_STATS_TYPES 4
+
+// Frame ID to give to lin_stats_snapshot() for the global counters.
+#define LIN_STATS_TOTAL 0xFF
+
+typedef struct {
+	uint16_t count[LIN_STATS_TYPES]; // Saturating at 0xFFFF
+} lin_stats_counters_t;
+
+typedef struct {
+	lin_stats_counters_t total;
+	lin_stats_counters_t fid[64];
+	volatile uint8_t seq; // Incremented by every update
+} lin_stats_t;
+
+extern void lin_stats_init(lin_stats_t *st);
+extern void lin_stats_update(lin_stats_t *st, const uint8_t fid, const uint8_t type);
+extern void lin_stats_snapshot(const lin_stats_t *st, const uint8_t fid, lin_stats_counters_t *out);
+
+#endif // LIN_STATS_H__
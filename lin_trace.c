@@ -0,0 +1,160 @@
+/*******************************************************************************
+ *
+ * lin_trace.c - LIN event tracing
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lin_trace.h"
+
+#ifdef LIN_TRACE
+
+#ifdef __SDCC
+
+#if !defined(__SDCCCALL) || __SDCCCALL != 1
+#error "SDCC calling convention other than 1 not supported"
+#endif
+
+#ifdef __SDCC_MODEL_LARGE
+#define ASM_RETURN retf
+#else
+#define ASM_RETURN ret
+#endif
+
+#endif // __SDCC
+
+// The head counts every record ever written, and the tail every one dumped,
+// both wrapping around at 0x10000. The low bits of either give the position
+// in the buffer.
+static lin_trace_rec_t lin_trace_buf[LIN_TRACE_SIZE];
+static volatile uint16_t lin_trace_head;
+static uint16_t lin_trace_tail;
+
+/******************************************************************************/
+
+#ifdef __SDCC
+
+void lin_trace_record(const uint8_t type, const uint16_t pid_status) __naked {
+	(void)type; // a
+	(void)pid_status; // x
+	
+	// Called from the hot paths of the bus driver and verification, so done in
+	// assembly to keep to a handful of instructions with nothing on the stack
+	// but the saved flags and type. Interrupts are disabled only while a slot
+	// is taken and filled, so that a handler of higher priority recording in
+	// the middle of it can't take the same slot, or leave a half-written one.
+	// The previous interrupt mask is restored, as this is usually called from
+	// an interrupt handler.
+	
+	__asm
+		push cc
+		sim
+		push a
+		
+		; Take the next slot by advancing the head. The low bits of the old head
+		; are the index of the slot, and multiplied by the record size give the
+		; offset of it in the buffer.
+		ldw y, _lin_trace_head
+		ld a, yl
+		incw y
+		ldw _lin_trace_head, y
+		and a, #(LIN_TRACE_SIZE - 1)
+		ld yl, a
+		ld a, #LIN_TRACE_DUMP_RECORD_SIZE
+		mul y, a
+		addw y, #_lin_trace_buf
+		
+		; Timestamp from the timer counter. The high byte must be read first, as
+		; that latches the low byte.
+		ld a, LIN_TRACE_TIMER
+		ld (y), a
+		ld a, LIN_TRACE_TIMER + 1
+		ld (1, y), a
+		
+		; Type from stack, then PID and status from X reg.
+		pop a
+		ld (2, y), a
+		ld a, xh
+		ld (3, y), a
+		ld a, xl
+		ld (4, y), a
+		
+		pop cc
+		ASM_RETURN
+	__endasm;
+}
+
+#else
+
+void lin_trace_record(const uint8_t type, const uint16_t pid_status) {
+	// With no timer on the host, records are timestamped with their sequence
+	// number instead.
+	lin_trace_rec_t *rec = &lin_trace_buf[lin_trace_head & (LIN_TRACE_SIZE - 1)];
+
+	rec->time = lin_trace_head;
+	rec->type = type;
+	rec->pid = (uint8_t)(pid_status >> 8);
+	rec->status = (uint8_t)pid_status;
+	lin_trace_head++;
+}
+
+#endif // __SDCC
+
+void lin_trace_dump(int (*out)(int)) {
+	// Writes every record since the previous dump, oldest first, through the
+	// given output function (e.g. ucsim_if_fout_putc), preceded by a magic
+	// string, the number of records overwritten before they could be dumped,
+	// and the number that follow. Multi-byte values are little-endian. Records
+	// may be made while the dump is in progress (those are left for the next);
+	// only if the buffer wraps all the way around during it are any garbled.
+	const uint16_t head = lin_trace_head;
+	uint16_t count = head - lin_trace_tail, lost = 0;
+	const lin_trace_rec_t *rec;
+
+	if(count > LIN_TRACE_SIZE) {
+		lost = count - LIN_TRACE_SIZE;
+		count = LIN_TRACE_SIZE;
+	}
+
+	out('L');
+	out('T');
+	out('R');
+	out('C');
+	out(lost & 0xFF);
+	out(lost >> 8);
+	out(count);
+
+	for(uint16_t i = head - count; i != head; i++) {
+		rec = &lin_trace_buf[i & (LIN_TRACE_SIZE - 1)];
+		out(rec->time & 0xFF);
+		out(rec->time >> 8);
+		out(rec->type);
+		out(rec->pid);
+		out(rec->status);
+	}
+
+	lin_trace_tail = head;
+}
+
+#endif // LIN_TRACE
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ *
+ * lin_trace.h - LIN event tracing header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_TRACE_H__
+#define LIN_TRACE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of records held in the trace buffer. Must be a power of two, and no
+// more than 128.
+#ifndef LIN_TRACE_SIZE
+#define LIN_TRACE_SIZE 32
+#endif
+
+// Address of the high byte of the free-running 16-bit counter that records
+// are timestamped from, followed by the low byte. By default, TIM1's counter.
+#ifndef LIN_TRACE_TIMER
+#define LIN_TRACE_TIMER 0x525E
+#endif
+
+#if LIN_TRACE_SIZE > 128 || (LIN_TRACE_SIZE & (LIN_TRACE_SIZE - 1)) != 0
+#error "LIN_TRACE_SIZE must be a power of two no more than 128"
+#endif
+
+// Types of event, and what the PID and status of each record are.
+#define LIN_TRACE_BREAK 0x01 // PID of previous header, status is bus event (none or timeout)
+#define LIN_TRACE_HEADER 0x02 // PID (or sync byte) received, status is bus event
+#define LIN_TRACE_RESPONSE 0x03 // PID of header, status is bus event
+#define LIN_TRACE_SLOT 0x04 // PID of next header (zero if none), status is master result of previous slot
+#define LIN_TRACE_VERIFY_OK 0x05 // PID of frame, status is bitmap of data bytes changed
+#define LIN_TRACE_VERIFY_ERROR 0x06 // PID of frame, status is zero
+#define LIN_TRACE_FORWARD 0x07 // PID received, status is destination bus or LIN_GATEWAY_DROP
+#define LIN_TRACE_USER 0x80 // First of those free for the application's own use
+
+// Sizes of the header of a dump (magic, lost count, record count) and of each
+// record in it (timestamp, type, PID, status).
+#define LIN_TRACE_DUMP_HEADER_SIZE 7
+#define LIN_TRACE_DUMP_RECORD_SIZE 5
+
+// Tracing is compiled in only when LIN_TRACE is defined; otherwise lin_trace()
+// expands to nothing (its arguments are not even evaluated), and there is no
+// buffer. The PID and status are packed together so that both arguments of
+// the record function are passed in registers.
+#ifdef LIN_TRACE
+
+typedef struct {
+	uint16_t time;
+	uint8_t type;
+	uint8_t pid;
+	uint8_t status;
+} lin_trace_rec_t;
+
+#define lin_trace(type, pid, status) lin_trace_record((type), ((uint16_t)(pid) << 8) | (uint8_t)(status))
+
+extern void lin_trace_record(const uint8_t type, const uint16_t pid_status);
+extern void lin_trace_dump(int (*out)(int));
+
+#else
+
+#define lin_trace(type, pid, status) do { } while(0)
+
+#endif // LIN_TRACE
+
+#endif // LIN_TRACE_H__
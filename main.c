@@ -28,9 +28,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
 #include "ucsim.h"
+#include "prof.h"
 #include "lin_checksum.h"
+#include "lin_burst.h"
+#include "lin_frames.h"
+#include "lin_master.h"
+#include "lin_bus.h"
+#include "lin_gateway.h"
+#include "lin_stats.h"
+#include "lin_trace.h"
 
 #define CLK_CKDIVR (*(volatile uint8_t *)(0x50C6))
 
@@ -40,15 +49,121 @@
 #define ANSI_YELLOW "\x1B[33m"
 #define ANSI_RESET "\x1B[0m"
 
+// Test vector record format, as read from the simulator's input file. The
+// flags byte gives the data length in its low nibble, plus the checksum type.
+// It is followed by the protected ID, the data bytes, and expected checksum.
+#define VECTOR_LEN_MASK 0x0F
+#define VECTOR_FLAG_CLASSIC 0x80
+
 typedef struct {
 	uint16_t pass_count;
 	uint16_t fail_count;
 } test_result_t;
 
+typedef struct {
+	uint32_t pass_count;
+	uint32_t fail_count;
+} case_result_t;
+
 static const char pass_str[] = ANSI_BOLD ANSI_GREEN "PASS" ANSI_RESET;
 static const char fail_str[] = ANSI_BOLD ANSI_RED "FAIL" ANSI_RESET;
 static const char hrule_str[] = "----------------------------------------";
 
+// When profiling, each test function is measured with its own probe, numbered
+// in the order they are run. TIM1 can't be used for both that and benchmarks.
+// In quiet mode, only the first run of a test function is measured, not the
+// second that prints its failures.
+#ifdef TEST_PROF
+
+#ifdef TEST_BENCH
+#error "TEST_PROF and TEST_BENCH can't be used together"
+#endif
+
+static uint8_t test_probe = 0;
+
+#define call_test(fn, name, r) \
+	do { \
+		prof_start(); \
+		fn(r); \
+		prof_stop(test_probe); \
+		prof_name(test_probe, name); \
+		test_probe++; \
+	} while(0)
+
+#else
+
+#define call_test(fn, name, r) fn(r)
+
+#endif // TEST_PROF
+
+// In quiet mode, nothing is printed for test cases that pass; only a summary
+// of passes and failures for each test function is output. The details of
+// cases are not even formatted, which is where the time goes. Instead, which
+// cases failed is recorded, and a test function with any failures is run a
+// second time, printing details of just those cases.
+#ifdef TEST_QUIET
+
+// Greatest number of cases per test function whose failure can be recorded.
+#define QUIET_MAX_CASES 256
+
+static uint8_t quiet_failed[QUIET_MAX_CASES / 8];
+static uint16_t quiet_case;
+static bool quiet_rerun, quiet_show;
+
+static void quiet_select_case(void) {
+	quiet_show = (quiet_rerun && quiet_case < QUIET_MAX_CASES && (quiet_failed[quiet_case >> 3] & (1 << (quiet_case & 7))));
+}
+
+static void quiet_end_case(const bool pass) {
+	if(quiet_rerun) {
+		if(quiet_show) puts(pass ? pass_str : fail_str);
+	} else if(!pass && quiet_case < QUIET_MAX_CASES) {
+		quiet_failed[quiet_case >> 3] |= (1 << (quiet_case & 7));
+	}
+	quiet_case++;
+	quiet_select_case();
+}
+
+static void quiet_run_test(void (*fn)(test_result_t *), const char *name, test_result_t *results) {
+	const test_result_t before = *results;
+	test_result_t rerun_results = { 0, 0 };
+	
+	for(uint8_t i = 0; i < sizeof(quiet_failed); i++) quiet_failed[i] = 0;
+	quiet_rerun = false;
+	quiet_case = 0;
+	quiet_select_case();
+	call_test(fn, name, results);
+	printf("%s: passed = %u, failed = %u\n", name, results->pass_count - before.pass_count, results->fail_count - before.fail_count);
+	
+	if(results->fail_count != before.fail_count) {
+		quiet_rerun = true;
+		quiet_case = 0;
+		quiet_select_case();
+		fn(&rerun_results);
+		quiet_rerun = false;
+		quiet_show = false;
+	}
+}
+
+#define print_test_name() do { } while(0)
+#define print_test_num(n) \
+	do { \
+		if(quiet_show) printf(ANSI_YELLOW "%s TEST %02u" ANSI_RESET ":\n", __func__, (n) + 1); \
+	} while(0)
+#define print_pass_fail(x) quiet_end_case(x)
+#define print_case(...) \
+	do { \
+		if(quiet_show) printf(__VA_ARGS__); \
+	} while(0)
+#define print_case_data(d, l) \
+	do { \
+		if(quiet_show) print_hex_data((d), (l)); \
+	} while(0)
+
+#define run_test(fn, r) quiet_run_test(fn, #fn, r)
+
+#else
+
 #define print_test_name() \
 	do { \
 		puts(hrule_str); \
@@ -66,6 +181,13 @@ static const char hrule_str[] = "----------------------------------------";
 		puts((x) ? pass_str : fail_str); \
 	} while(0)
 
+#define print_case(...) printf(__VA_ARGS__)
+#define print_case_data(d, l) print_hex_data((d), (l))
+
+#define run_test(fn, r) call_test(fn, #fn, r)
+
+#endif // TEST_QUIET
+
 #define count_test_result(x, r) \
 	do { \
 		if(x) { \
@@ -126,11 +248,11 @@ static void test_calculate_classic(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("length = %u\n", tests[i].data_len);
-		print_hex_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		print_case("length = %u\n", tests[i].data_len);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
 		cksum = lin_calculate_checksum_classic(&tests[i].data, tests[i].data_len);
 		pass = (cksum == tests[i].expected_cksum);
-		printf("expected = 0x%02X, checksum = 0x%02X\n", tests[i].expected_cksum, cksum);
+		print_case("expected = 0x%02X, checksum = 0x%02X\n", tests[i].expected_cksum, cksum);
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
@@ -157,11 +279,11 @@ static void test_calculate_enhanced(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("pid = 0x%02X, length = %u\n", tests[i].pid, tests[i].data_len);
-		print_hex_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		print_case("pid = 0x%02X, length = %u\n", tests[i].pid, tests[i].data_len);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
 		cksum = lin_calculate_checksum_enhanced(tests[i].pid, &tests[i].data, tests[i].data_len);
 		pass = (cksum == tests[i].expected_cksum);
-		printf("expected = 0x%02X, checksum = 0x%02X\n", tests[i].expected_cksum, cksum);
+		print_case("expected = 0x%02X, checksum = 0x%02X\n", tests[i].expected_cksum, cksum);
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
@@ -193,11 +315,11 @@ static void test_verify_classic(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("length = %u, checksum = 0x%02X\n", tests[i].data_len, tests[i].cksum);
-		print_hex_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		print_case("length = %u, checksum = 0x%02X\n", tests[i].data_len, tests[i].cksum);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
 		result = lin_verify_checksum_classic(tests[i].cksum, &tests[i].data, tests[i].data_len);
 		pass = (result == tests[i].expected_result);
-		printf("expected = %u, result = %u\n", tests[i].expected_result, result);
+		print_case("expected = %u, result = %u\n", tests[i].expected_result, result);
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
@@ -230,16 +352,219 @@ static void test_verify_enhanced(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("pid = 0x%02X, length = %u, checksum = 0x%02X\n", tests[i].pid, tests[i].data_len, tests[i].cksum);
-		print_hex_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		print_case("pid = 0x%02X, length = %u, checksum = 0x%02X\n", tests[i].pid, tests[i].data_len, tests[i].cksum);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
 		result = lin_verify_checksum_enhanced(tests[i].cksum, tests[i].pid, &tests[i].data, tests[i].data_len);
 		pass = (result == tests[i].expected_result);
-		printf("expected = %u, result = %u\n", tests[i].expected_result, result);
+		print_case("expected = %u, result = %u\n", tests[i].expected_result, result);
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
 }
 
+static void test_reseed_checksum(test_result_t *results) {
+	// Each case's checksum is for the old PID, and the expected result is the
+	// checksum of the same data for the new PID.
+	static const struct {
+		uint8_t cksum;
+		uint8_t old_pid;
+		uint8_t new_pid;
+		uint8_t expected_cksum;
+	} tests[] = {
+		{ 0xE6, 0x00, 0xBF, 0x27 }, // LIN Spec 2.2A example calculation (§ 2.8.3), classic to enhanced
+		{ 0x27, 0xBF, 0x80, 0x66 }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ 0x27, 0xBF, 0xBF, 0x27 }, // Unchanged PID
+		{ 0xB6, 0xBF, 0xC1, 0xB4 },
+		{ 0x40, 0xBF, 0x80, 0x7F }, // Data of all zeroes
+		{ 0xFF, 0x00, 0xBF, 0x40 }, // Data of all zeroes, classic to enhanced
+		{ 0x40, 0xBF, 0x80, 0x7F }, // Data of all 0xFF
+		{ 0x00, 0x00, 0xBF, 0x40 }, // Data of all 0xFF, classic to enhanced
+	};
+	uint8_t cksum;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("checksum = 0x%02X, old pid = 0x%02X, new pid = 0x%02X\n", tests[i].cksum, tests[i].old_pid, tests[i].new_pid);
+		cksum = lin_reseed_checksum(tests[i].cksum, tests[i].old_pid, tests[i].new_pid);
+		print_case("expected = 0x%02X, result = 0x%02X\n", tests[i].expected_cksum, cksum);
+		print_pass_fail(cksum == tests[i].expected_cksum);
+		count_test_result(cksum == tests[i].expected_cksum, results);
+	}
+}
+
+static void test_calculate_far(test_result_t *results) {
+	// The far functions can read from anywhere, so are tested here with data
+	// at 16-bit addresses. Access above 0xFFFF is covered by linemu.
+	static const struct {
+		bool classic;
+		uint8_t pid;
+		uint8_t data[8];
+		uint8_t data_len;
+		uint8_t expected_cksum;
+	} tests[] = {
+		{ true, 0x00, { 0x00 }, 0, 0xFF }, // Zero-length data
+		{ true, 0x00, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, 8, 0x00 },
+		{ true, 0x00, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0xE6 }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ true, 0x00, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0x76 },
+		{ false, 0xBF, { 0x00 }, 0, 0x40 }, // Zero-length data
+		{ false, 0xBF, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, 8, 0x40 },
+		{ false, 0xBF, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0x27 }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ false, 0xBF, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0xB6 },
+	};
+	lin_far_ptr_t data;
+	uint8_t cksum;
+	bool pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("%s, pid = 0x%02X, length = %u\n", (tests[i].classic ? "classic" : "enhanced"), tests[i].pid, tests[i].data_len);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		data = (uint16_t)&tests[i].data;
+		if(tests[i].classic) {
+			cksum = lin_calculate_checksum_classic_far(&data, tests[i].data_len);
+		} else {
+			cksum = lin_calculate_checksum_enhanced_far(tests[i].pid, &data, tests[i].data_len);
+		}
+		pass = (cksum == tests[i].expected_cksum);
+		print_case("expected = 0x%02X, checksum = 0x%02X\n", tests[i].expected_cksum, cksum);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_verify_far(test_result_t *results) {
+	static const struct {
+		bool classic;
+		uint8_t pid;
+		uint8_t data[8];
+		uint8_t data_len;
+		uint8_t cksum;
+		bool expected_result;
+	} tests[] = {
+		{ true, 0x00, { 0x00 }, 0, 0xFF, true }, // Zero-length data
+		{ true, 0x00, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0xE6, true }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ true, 0x00, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0x76, true },
+		{ true, 0x00, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0x55, false },
+		{ true, 0x00, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0xAA, false },
+		{ false, 0xBF, { 0x00 }, 0, 0x40, true }, // Zero-length data
+		{ false, 0xBF, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0x27, true }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ false, 0xBF, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0xB6, true },
+		{ false, 0xBF, { 0x4A, 0x55, 0x93, 0xE5 }, 4, 0x55, false },
+		{ false, 0xBF, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B }, 8, 0xAA, false },
+	};
+	lin_far_ptr_t data;
+	bool result, pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("%s, pid = 0x%02X, length = %u, checksum = 0x%02X\n", (tests[i].classic ? "classic" : "enhanced"), tests[i].pid, tests[i].data_len, tests[i].cksum);
+		print_case_data((const uint8_t *)&tests[i].data, tests[i].data_len);
+		data = (uint16_t)&tests[i].data;
+		if(tests[i].classic) {
+			result = lin_verify_checksum_classic_far(tests[i].cksum, &data, tests[i].data_len);
+		} else {
+			result = lin_verify_checksum_enhanced_far(tests[i].cksum, tests[i].pid, &data, tests[i].data_len);
+		}
+		pass = (result == tests[i].expected_result);
+		print_case("expected = %u, result = %u\n", tests[i].expected_result, result);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_verify_batch(test_result_t *results) {
+	// Each case verifies the first 'count' of these frames, so the results
+	// bitmap may be partially or entirely filled in its last byte.
+	static const uint8_t data_4[] = { 0x4A, 0x55, 0x93, 0xE5 };
+	static const uint8_t data_8[] = { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B };
+	static const uint8_t data_ff[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+	static const lin_frame_t frames[] = {
+		{ data_4, 4, 0x00, 0xE6 }, // LIN Spec 2.2A example calculation (§ 2.8.3)
+		{ data_4, 4, 0xBF, 0x27 },
+		{ data_4, 4, 0xBF, 0xE6 }, // Classic checksum given for enhanced
+		{ data_8, 8, 0x00, 0x76 },
+		{ data_8, 8, 0xBF, 0xB6 },
+		{ data_8, 8, 0xBF, 0xAA },
+		{ data_ff, 0, 0x00, 0xFF }, // Zero-length data
+		{ data_ff, 0, 0xBF, 0x40 }, // Zero-length data
+		{ data_ff, 8, 0x00, 0x00 },
+		{ data_ff, 8, 0xBF, 0x40 },
+		{ data_ff, 8, 0xBF, 0x41 },
+	};
+	static const struct {
+		uint8_t count;
+		uint8_t expected_results[2];
+		uint8_t expected_len;
+	} tests[] = {
+		{ 11, { 0xDB, 0x03 }, 2 },
+		{ 8, { 0xDB }, 1 },
+		{ 3, { 0x03 }, 1 },
+		{ 1, { 0x01 }, 1 },
+		{ 0, { 0x00 }, 0 }, // No frames, so nothing written
+	};
+	uint8_t res[3];
+	bool pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("count = %u\n", tests[i].count);
+		for(uint8_t j = 0; j < sizeof(res); j++) res[j] = 0xA5;
+		lin_verify_checksum_batch(frames, tests[i].count, res);
+		pass = true;
+		for(uint8_t j = 0; j < sizeof(res); j++) {
+			if(res[j] != (j < tests[i].expected_len ? tests[i].expected_results[j] : 0xA5)) pass = false;
+		}
+		print_case("expected = 0x%02X 0x%02X, results = 0x%02X 0x%02X\n", tests[i].expected_results[0], tests[i].expected_results[1], res[0], res[1]);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_verify_readback(test_result_t *results) {
+	static const uint8_t data_4[] = { 0x4A, 0x55, 0x93, 0xE5 };
+	static const uint8_t data_8[] = { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B };
+	static const struct {
+		uint8_t pid;
+		const uint8_t *sent;
+		uint8_t echo[9];
+		uint8_t len;
+		uint8_t expected;
+	} tests[] = {
+		{ 0x00, data_4, { 0x4A, 0x55, 0x93, 0xE5, 0xE6 }, 4, LIN_READBACK_OK },
+		{ 0xBF, data_4, { 0x4A, 0x55, 0x93, 0xE5, 0x27 }, 4, LIN_READBACK_OK },
+		{ 0xBF, data_4, { 0x4A, 0x55, 0x93, 0xE5, 0xE6 }, 4, 4 }, // Classic checksum echoed for enhanced
+		{ 0x00, data_4, { 0x4A, 0x55, 0x13, 0xE5, 0xE6 }, 4, 2 },
+		{ 0x00, data_4, { 0xCA, 0x55, 0x93, 0xE5, 0xE6 }, 4, 0 },
+		{ 0x00, data_4, { 0x4A, 0x54, 0x93, 0xE4, 0xE6 }, 4, 1 }, // First of two
+		{ 0x00, data_4, { 0x4B, 0x55, 0x93, 0xE5, 0xE5 }, 4, 0 }, // Echoed checksum agrees with wrong data
+		{ 0xBF, data_8, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5B, 0xB6 }, 8, LIN_READBACK_OK },
+		{ 0xBF, data_8, { 0xA9, 0xD3, 0x76, 0x3D, 0x4F, 0xD9, 0xD3, 0x5A, 0xB6 }, 8, 7 },
+		{ 0x00, data_8, { 0xFF }, 0, LIN_READBACK_OK }, // Zero-length data
+		{ 0xBF, data_8, { 0x40 }, 0, LIN_READBACK_OK }, // Zero-length data
+		{ 0xBF, data_8, { 0x41 }, 0, 0 }, // Zero-length data
+	};
+	uint8_t pos;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("pid = 0x%02X, len = %u\n", tests[i].pid, tests[i].len);
+		pos = lin_verify_readback(tests[i].pid, tests[i].sent, tests[i].echo, tests[i].len);
+		print_case("expected = 0x%02X, result = 0x%02X\n", tests[i].expected, pos);
+		print_pass_fail(pos == tests[i].expected);
+		count_test_result(pos == tests[i].expected, results);
+	}
+}
+
 static void test_get_protected_id(test_result_t *results) {
 	static const struct {
 		uint8_t fid;
@@ -263,10 +588,10 @@ static void test_get_protected_id(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("fid = 0x%02X\n", tests[i].fid);
+		print_case("fid = 0x%02X\n", tests[i].fid);
 		pid = lin_get_protected_id(tests[i].fid);
 		pass = (pid == tests[i].expected_pid);
-		printf("expected = 0x%02X, pid = 0x%02X\n", tests[i].expected_pid, pid);
+		print_case("expected = 0x%02X, pid = 0x%02X\n", tests[i].expected_pid, pid);
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
@@ -297,30 +622,1107 @@ static void test_verify_protected_id(test_result_t *results) {
 	
 	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
 		print_test_num(i);
-		printf("pid = 0x%02X\n", tests[i].pid);
+		print_case("pid = 0x%02X\n", tests[i].pid);
 		result = lin_verify_protected_id(tests[i].pid, &fid);
 		pass = (result == tests[i].expected_result && fid == tests[i].expected_fid);
-		printf("expected = %u / 0x%02X, result = %u / 0x%02X\n", tests[i].expected_result, tests[i].expected_fid, result, fid);
+		print_case("expected = %u / 0x%02X, result = %u / 0x%02X\n", tests[i].expected_result, tests[i].expected_fid, result, fid);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_frame_find(test_result_t *results) {
+	// A table as generated by linldf, in ascending order of frame ID. Expected
+	// index of -1 is for frames not found.
+	static const lin_frame_def_t frames[] = {
+		{ 0xC1, 1, LIN_FRAME_FLAG_PUBLISH, 0, 0, 2 }, // 0x01
+		{ 0x03, 6, 0, 1, 2, 3 }, // 0x03
+		{ 0x50, 1, LIN_FRAME_FLAG_CLASSIC, 7, 5, 1 }, // 0x10
+		{ 0x3C, 8, LIN_FRAME_FLAG_CLASSIC | LIN_FRAME_FLAG_PUBLISH, 8, 6, 1 }, // 0x3C
+	};
+	static const struct {
+		uint8_t pid;
+		int8_t expected_index;
+		uint8_t expected_cksum_pid;
+	} tests[] = {
+		{ 0xC1, 0, 0xC1 },
+		{ 0x03, 1, 0x03 },
+		{ 0x50, 2, 0x00 }, // Classic checksum
+		{ 0x3C, 3, 0x00 }, // Classic checksum
+		{ 0x41, -1, 0 }, // Bad parity of 0x01
+		{ 0x42, -1, 0 }, // Between 0x01 and 0x03
+		{ 0x80, -1, 0 }, // Before first
+		{ 0x7D, -1, 0 }, // After last
+	};
+	const lin_frame_def_t *frame;
+	bool pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("pid = 0x%02X\n", tests[i].pid);
+		frame = lin_frame_find(frames, (sizeof(frames) / sizeof(frames[0])), tests[i].pid);
+		if(tests[i].expected_index < 0) {
+			pass = (frame == NULL);
+		} else {
+			pass = (frame == &frames[tests[i].expected_index] && lin_frame_checksum_pid(frame) == tests[i].expected_cksum_pid);
+		}
+		print_case("expected = %d, index = %d\n", tests[i].expected_index, (frame != NULL ? (int)(frame - frames) : -1));
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_frame_receive(test_result_t *results) {
+	// Frame 0 (enhanced) has a signal spanning both its bytes, and frame 1 is
+	// classic. Each case receives a frame with either the right checksum for
+	// its model or a corrupted one, then checks the stored data and takes the
+	// update flags set by it.
+	static const lin_frame_def_t frames[] = {
+		{ 0xC1, 2, 0, 0, 0, 3 },
+		{ 0x50, 1, LIN_FRAME_FLAG_CLASSIC, 2, 3, 1 },
+	};
+	static const lin_signal_def_t signals[] = {
+		{ 0, 4 },
+		{ 4, 8 },
+		{ 12, 4 },
+		{ 0, 8 },
+	};
+	static uint8_t data[3] = { 0x00, 0x00, 0xFF };
+	static uint8_t frame_flags[1], signal_flags[1];
+	static const lin_frame_table_t table = { frames, signals, data, frame_flags, signal_flags, 2 };
+	static const struct {
+		uint8_t index;
+		uint8_t rx[2];
+		bool good_cksum;
+		bool expected_result;
+		uint8_t expected_data[3];
+		uint8_t expected_frame_flags;
+		uint8_t expected_signal_flags;
+	} tests[] = {
+		{ 0, { 0x01, 0x00 }, true, true, { 0x01, 0x00, 0xFF }, 0x01, 0x01 },
+		{ 0, { 0x01, 0x00 }, true, true, { 0x01, 0x00, 0xFF }, 0x00, 0x00 }, // Unchanged
+		{ 0, { 0x11, 0x00 }, false, false, { 0x01, 0x00, 0xFF }, 0x00, 0x00 },
+		{ 0, { 0x11, 0xF0 }, true, true, { 0x11, 0xF0, 0xFF }, 0x01, 0x06 },
+		{ 0, { 0x11, 0xF8 }, true, true, { 0x11, 0xF8, 0xFF }, 0x01, 0x02 }, // Only high byte of spanning signal
+		{ 1, { 0xFF }, true, true, { 0x11, 0xF8, 0xFF }, 0x00, 0x00 }, // Unchanged
+		{ 1, { 0x5A }, true, true, { 0x11, 0xF8, 0x5A }, 0x02, 0x08 },
+		{ 1, { 0x5B }, false, false, { 0x11, 0xF8, 0x5A }, 0x00, 0x00 },
+	};
+	const lin_frame_def_t *frame;
+	uint8_t cksum, fflags, sflags;
+	bool result, pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		frame = &frames[tests[i].index];
+		cksum = lin_calculate_checksum_enhanced(lin_frame_checksum_pid(frame), tests[i].rx, frame->data_len);
+		if(!tests[i].good_cksum) cksum ^= 0x01;
+		print_case("index = %u, cksum = 0x%02X\n", tests[i].index, cksum);
+		result = lin_frame_receive(&table, tests[i].index, tests[i].rx, cksum);
+		fflags = lin_frame_flags_take(&frame_flags[0]);
+		sflags = lin_frame_flags_take(&signal_flags[0]);
+		pass = (result == tests[i].expected_result && fflags == tests[i].expected_frame_flags && sflags == tests[i].expected_signal_flags);
+		for(uint8_t j = 0; j < sizeof(data); j++) {
+			if(data[j] != tests[i].expected_data[j]) pass = false;
+		}
+		print_case("expected = %u / 0x%02X 0x%02X, result = %u / 0x%02X 0x%02X\n", tests[i].expected_result,
+			tests[i].expected_frame_flags, tests[i].expected_signal_flags, result, fflags, sflags);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_master_schedule(test_result_t *results) {
+	// Frames 0-3 are published by slaves, and 4-5 by the master. The schedule
+	// is an unconditional slot, an event-triggered slot (PID 0xF0) with frames
+	// 1-3 associated, then a sporadic slot for frames 5 and 4 in that order of
+	// priority. Each case optionally requests sporadic frames, advances to the
+	// next slot, then gives the response (if the slot expects one): either
+	// with a good checksum, a corrupted one, or the checksum for the event-
+	// triggered frame's PID.
+	static const lin_frame_def_t frames[] = {
+		{ 0x50, 2, 0, 0, 0, 0 }, // 0x10
+		{ 0x11, 2, 0, 2, 0, 0 }, // 0x11
+		{ 0x92, 2, 0, 4, 0, 0 }, // 0x12
+		{ 0xD3, 2, 0, 6, 0, 0 }, // 0x13
+		{ 0x20, 1, LIN_FRAME_FLAG_PUBLISH, 8, 0, 0 }, // 0x20
+		{ 0x61, 1, LIN_FRAME_FLAG_PUBLISH, 9, 0, 0 }, // 0x21
+	};
+	static const lin_slot_t schedule[] = {
+		{ LIN_SLOT_UNCONDITIONAL, 0, 0, 0, 0, 10 },
+		{ LIN_SLOT_EVENT, 0, 0xF0, 0, 3, 10 },
+		{ LIN_SLOT_SPORADIC, 0, 0, 3, 2, 5 },
+	};
+	static const uint8_t assoc[] = { 1, 2, 3, 5, 4 };
+	static uint8_t data[10], frame_flags[1], signal_flags[1];
+	static const lin_frame_table_t table = { frames, NULL, data, frame_flags, signal_flags, 6 };
+	static const lin_master_config_t config = { &table, schedule, assoc, 3 };
+	static lin_master_t m;
+	enum { RESP_SKIP, RESP_GOOD, RESP_BAD, RESP_EVENT };
+	static const struct {
+		uint8_t request[2];
+		uint8_t expected_pid;
+		uint8_t resp;
+		uint8_t rx_len;
+		uint8_t rx[2];
+		uint8_t expected_result;
+	} tests[] = {
+		{ { 0xFF, 0xFF }, 0x50, RESP_GOOD, 2, { 0x01, 0x02 }, LIN_MASTER_RESP_OK },
+		{ { 0xFF, 0xFF }, 0xF0, RESP_EVENT, 0, { 0 }, LIN_MASTER_RESP_NONE }, // No slave has update
+		{ { 0xFF, 0xFF }, 0x00, RESP_SKIP, 0, { 0 }, 0 }, // Empty sporadic slot
+		{ { 4, 5 }, 0x50, RESP_BAD, 2, { 0x01, 0x02 }, LIN_MASTER_RESP_ERROR },
+		{ { 0xFF, 0xFF }, 0xF0, RESP_EVENT, 2, { 0xD3, 0x33 }, LIN_MASTER_RESP_OK }, // Frame 3 responds
+		{ { 0xFF, 0xFF }, 0x61, RESP_SKIP, 0, { 0 }, 0 }, // Higher priority sporadic frame
+		{ { 0xFF, 0xFF }, 0x50, RESP_GOOD, 0, { 0 }, LIN_MASTER_RESP_NONE },
+		{ { 0xFF, 0xFF }, 0xF0, RESP_BAD, 2, { 0x11, 0x13 }, LIN_MASTER_RESP_COLLISION }, // Frames 1 and 3 (0x11 & 0xD3)
+		{ { 0xFF, 0xFF }, 0x11, RESP_GOOD, 2, { 0x11, 0x11 }, LIN_MASTER_RESP_OK }, // Frame 2 not polled
+		{ { 0xFF, 0xFF }, 0xD3, RESP_GOOD, 2, { 0xD3, 0x34 }, LIN_MASTER_RESP_OK },
+		{ { 0xFF, 0xFF }, 0x20, RESP_SKIP, 0, { 0 }, 0 }, // Sporadic slot resumes
+		{ { 0xFF, 0xFF }, 0x50, RESP_GOOD, 2, { 0x01, 0x03 }, LIN_MASTER_RESP_OK },
+		{ { 0xFF, 0xFF }, 0xF0, RESP_BAD, 1, { 0x00 }, LIN_MASTER_RESP_COLLISION }, // Nothing learned from PID
+		{ { 0xFF, 0xFF }, 0x11, RESP_GOOD, 0, { 0 }, LIN_MASTER_RESP_NONE },
+		{ { 0xFF, 0xFF }, 0x92, RESP_GOOD, 2, { 0x92, 0x22 }, LIN_MASTER_RESP_OK },
+		{ { 0xFF, 0xFF }, 0xD3, RESP_GOOD, 0, { 0 }, LIN_MASTER_RESP_NONE },
+		{ { 0xFF, 0xFF }, 0x00, RESP_SKIP, 0, { 0 }, 0 },
+	};
+	static const uint8_t expected_data[] = { 0x01, 0x03, 0x11, 0x11, 0x92, 0x22, 0xD3, 0x34 };
+	uint8_t pid, cksum, result;
+	bool pass;
+	
+	print_test_name();
+	
+	lin_master_init(&m, &config);
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		for(uint8_t j = 0; j < 2; j++) {
+			if(tests[i].request[j] != 0xFF) lin_master_sporadic_request(&m, tests[i].request[j]);
+		}
+		pid = lin_master_next(&m);
+		pass = (pid == tests[i].expected_pid);
+		print_case("expected pid = 0x%02X, pid = 0x%02X\n", tests[i].expected_pid, pid);
+		if(tests[i].resp != RESP_SKIP) {
+			cksum = lin_calculate_checksum_enhanced(pid, tests[i].rx, tests[i].rx_len);
+			if(tests[i].resp == RESP_BAD) cksum ^= 0x01;
+			result = lin_master_response(&m, tests[i].rx, tests[i].rx_len, cksum);
+			pass = pass && (result == tests[i].expected_result);
+			print_case("expected = %u, result = %u\n", tests[i].expected_result, result);
+		}
 		print_pass_fail(pass);
 		count_test_result(pass, results);
 	}
+	
+	print_test_num(sizeof(tests) / sizeof(tests[0]));
+	pass = true;
+	for(uint8_t j = 0; j < sizeof(expected_data); j++) {
+		if(data[j] != expected_data[j]) pass = false;
+	}
+	print_case("stored data\n");
+	print_pass_fail(pass);
+	count_test_result(pass, results);
 }
 
+static void test_bus(test_result_t *results) {
+	// Buses 0 and 1 are slaves with different frame tables, and bus 2 is a
+	// master with a schedule of one frame received then one sent. Each bus
+	// has a fake UART in RAM. Each case is a sequence of breaks, bytes
+	// received (some with a framing error), or master slot starts, given to
+	// one bus, with the buses interleaved. Only the event from the last may be
+	// other than none; for a slot start, the PID returned and the outcome of
+	// the previous slot are checked.
+	static const lin_frame_def_t frames_a[] = {
+		{ 0x50, 2, 0, 0, 0, 0 }, // 0x10
+		{ 0x11, 2, LIN_FRAME_FLAG_PUBLISH, 2, 0, 0 }, // 0x11
+	};
+	static const lin_frame_def_t frames_b[] = {
+		{ 0x50, 1, LIN_FRAME_FLAG_CLASSIC, 0, 0, 0 }, // 0x10
+	};
+	static const lin_frame_def_t frames_m[] = {
+		{ 0x50, 2, 0, 0, 0, 0 }, // 0x10
+		{ 0x20, 1, LIN_FRAME_FLAG_PUBLISH, 2, 0, 0 }, // 0x20
+	};
+	static const lin_slot_t schedule[] = {
+		{ LIN_SLOT_UNCONDITIONAL, 0, 0, 0, 0, 10 },
+		{ LIN_SLOT_UNCONDITIONAL, 1, 0, 0, 0, 10 },
+	};
+	static uint8_t data_a[4] = { 0x00, 0x00, 0x12, 0x34 }, data_b[1], data_m[3] = { 0x00, 0x00, 0x77 };
+	static uint8_t frame_flags[3][1], signal_flags[3][1];
+	static const lin_frame_table_t tables[3] = {
+		{ frames_a, NULL, data_a, frame_flags[0], signal_flags[0], 2 },
+		{ frames_b, NULL, data_b, frame_flags[1], signal_flags[1], 1 },
+		{ frames_m, NULL, data_m, frame_flags[2], signal_flags[2], 2 },
+	};
+	static const lin_master_config_t config = { &tables[2], schedule, NULL, 2 };
+	static lin_master_t m;
+	static lin_bus_t buses[3];
+	static lin_stats_t stats[3];
+	static uint8_t uarts[3][8];
+	enum { STEP_BREAK = 0x100, STEP_FE = 0x200, STEP_SLOT = 0x300 };
+	static const struct {
+		uint8_t bus;
+		uint8_t len;
+		uint16_t steps[7];
+		uint8_t expected; // Event, or PID for a slot start
+		uint8_t expected_result;
+	} tests[] = {
+		{ 0, 3, { STEP_BREAK, 0x55, 0x50 }, LIN_BUS_EVT_NONE, 0 },
+		{ 1, 3, { STEP_BREAK, 0x55, 0x50 }, LIN_BUS_EVT_NONE, 0 },
+		{ 0, 2, { 0x01, 0x02 }, LIN_BUS_EVT_NONE, 0 },
+		{ 1, 2, { 0xAA, 0x55 }, LIN_BUS_EVT_RX_OK, 0 }, // Classic
+		{ 0, 1, { 0xAC }, LIN_BUS_EVT_RX_OK, 0 },
+		{ 0, 3, { STEP_BREAK, 0x55, 0x11 }, LIN_BUS_EVT_HEADER, 0 },
+		{ 0, 3, { 0x12, 0x34, 0xA8 }, LIN_BUS_EVT_TX_OK, 0 },
+		{ 0, 3, { STEP_BREAK, 0x55, 0x11 }, LIN_BUS_EVT_HEADER, 0 },
+		{ 0, 3, { 0x12, 0x30, 0xA8 }, LIN_BUS_EVT_TX_ERROR, 0 }, // Bit error
+		{ 1, 2, { STEP_BREAK, 0x54 }, LIN_BUS_EVT_SYNC_ERROR, 0 },
+		{ 1, 3, { STEP_BREAK, 0x55, 0x10 }, LIN_BUS_EVT_PID_ERROR, 0 }, // Bad parity of 0x10
+		{ 1, 5, { STEP_BREAK, 0x55, 0x11, 0xAA, STEP_BREAK }, LIN_BUS_EVT_NONE, 0 }, // Frame not in table ignored
+		{ 0, 5, { STEP_BREAK, 0x55, 0x50, 0x05, STEP_BREAK }, LIN_BUS_EVT_TIMEOUT, 0 },
+		{ 0, 6, { 0x55, 0x50, STEP_FE | 0x00, 0x05, 0x06, 0xA5 }, LIN_BUS_EVT_RX_ERROR, 0 },
+		{ 0, 7, { STEP_BREAK, STEP_FE | 0x00, 0x55, 0x50, 0x05, 0x06, 0xA4 }, LIN_BUS_EVT_RX_OK, 0 }, // Break with zero byte
+		{ 2, 1, { STEP_SLOT }, 0x50, LIN_MASTER_RESP_NONE },
+		{ 2, 6, { STEP_BREAK, 0x55, 0x50, 0x0A, 0x0B, 0x9A }, LIN_BUS_EVT_NONE, 0 }, // Left for next slot
+		{ 2, 1, { STEP_SLOT }, 0x20, LIN_MASTER_RESP_OK },
+		{ 2, 3, { STEP_BREAK, 0x55, 0x20 }, LIN_BUS_EVT_HEADER, 0 },
+		{ 2, 2, { 0x77, 0x68 }, LIN_BUS_EVT_TX_OK, 0 },
+		{ 2, 1, { STEP_SLOT }, 0x50, LIN_MASTER_RESP_OK },
+		{ 2, 3, { STEP_BREAK, 0x55, 0x50 }, LIN_BUS_EVT_NONE, 0 },
+		{ 2, 1, { STEP_SLOT }, 0x20, LIN_MASTER_RESP_NONE }, // No response
+	};
+	static const uint8_t expected_data_a[] = { 0x05, 0x06, 0x12, 0x34 };
+	static const uint8_t expected_data_m[] = { 0x0A, 0x0B, 0x77 };
+	static const struct {
+		uint8_t bus;
+		uint8_t fid;
+		uint16_t count[LIN_STATS_TYPES];
+	} expected_stats[] = {
+		{ 0, 0x10, { 2, 0, 1, 1 } },
+		{ 0, 0x11, { 1, 0, 0, 0 } }, // Bit error not counted
+		{ 0, LIN_STATS_TOTAL, { 3, 0, 1, 1 } },
+		{ 1, 0x10, { 1, 1, 0, 0 } },
+		{ 1, LIN_STATS_TOTAL, { 1, 1, 0, 0 } }, // Sync error not counted
+		{ 2, 0x10, { 1, 0, 0, 1 } },
+		{ 2, 0x20, { 1, 0, 0, 0 } },
+		{ 2, LIN_STATS_TOTAL, { 2, 0, 0, 1 } },
+	};
+	lin_stats_counters_t counters;
+	volatile uint8_t *uart;
+	lin_bus_t *bus;
+	uint16_t step;
+	uint8_t evt;
+	bool pass;
+	
+	print_test_name();
+	
+	lin_master_init(&m, &config);
+	for(uint8_t j = 0; j < 3; j++) {
+		lin_bus_init(&buses[j], &tables[j], (j == 2 ? &m : NULL));
+		lin_stats_init(&stats[j]);
+		buses[j].stats = &stats[j];
+	}
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("bus = %u\n", tests[i].bus);
+		bus = &buses[tests[i].bus];
+		uart = uarts[tests[i].bus];
+		pass = true;
+		for(uint8_t j = 0; j < tests[i].len; j++) {
+			step = tests[i].steps[j];
+			if(step == STEP_SLOT) {
+				evt = lin_bus_master_slot(bus);
+				pass = pass && (bus->result == tests[i].expected_result);
+				print_case("expected result = %u, result = %u\n", tests[i].expected_result, bus->result);
+			} else {
+				uart[LIN_BUS_UART_SR] = 0;
+				if(step == STEP_BREAK) {
+					uart[LIN_BUS_UART_CR4] |= LIN_BUS_UART_CR4_LBDF;
+				} else {
+					uart[LIN_BUS_UART_SR] = LIN_BUS_UART_SR_RXNE | ((step & STEP_FE) ? LIN_BUS_UART_SR_FE : 0);
+					uart[LIN_BUS_UART_DR] = (uint8_t)step;
+				}
+				evt = lin_bus_isr(bus, uart);
+				if(uart[LIN_BUS_UART_CR4] & LIN_BUS_UART_CR4_LBDF) pass = false;
+			}
+			if(evt != (j == tests[i].len - 1 ? tests[i].expected : LIN_BUS_EVT_NONE)) pass = false;
+		}
+		print_case("expected = 0x%02X, last = 0x%02X\n", tests[i].expected, evt);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+	
+	print_test_num(sizeof(tests) / sizeof(tests[0]));
+	pass = (data_b[0] == 0xAA);
+	for(uint8_t j = 0; j < sizeof(expected_data_a); j++) {
+		if(data_a[j] != expected_data_a[j]) pass = false;
+	}
+	for(uint8_t j = 0; j < sizeof(expected_data_m); j++) {
+		if(data_m[j] != expected_data_m[j]) pass = false;
+	}
+	print_case("stored data\n");
+	print_pass_fail(pass);
+	count_test_result(pass, results);
+	
+	print_test_num(sizeof(tests) / sizeof(tests[0]) + 1);
+	pass = true;
+	for(uint8_t j = 0; j < (sizeof(expected_stats) / sizeof(expected_stats[0])); j++) {
+		lin_stats_snapshot(&stats[expected_stats[j].bus], expected_stats[j].fid, &counters);
+		for(uint8_t k = 0; k < LIN_STATS_TYPES; k++) {
+			if(counters.count[k] != expected_stats[j].count[k]) pass = false;
+		}
+	}
+	print_case("statistics\n");
+	print_pass_fail(pass);
+	count_test_result(pass, results);
+}
+
+static void test_gateway(test_result_t *results) {
+	// Frame ID 0x10 is routed to 0x11 on bus 1, 0x12 to 0x20 on bus 0 with a
+	// classic checksum, 0x13 from a classic checksum to 0x21 on bus 1, and
+	// 0x14 to 0x22 on bus 2 with classic checksums on both. Each case forwards
+	// a frame record, which must be rewritten for the destination bus (or left
+	// alone if dropped) with its data pointer unchanged.
+	static lin_route_t routes[64];
+	static const struct {
+		uint8_t pid;
+		uint8_t data[3];
+		uint8_t data_len;
+		uint8_t cksum;
+		uint8_t expected_dest;
+		uint8_t expected_pid;
+		uint8_t expected_cksum;
+	} tests[] = {
+		{ 0x50, { 0x01, 0x02 }, 2, 0xAC, 1, 0x11, 0xEB },
+		{ 0x50, { 0x01, 0x02 }, 2, 0xAD, LIN_GATEWAY_DROP, 0x50, 0xAD }, // Bad checksum
+		{ 0x92, { 0x05, 0x06, 0x07 }, 3, 0x5B, 0, 0x20, 0xED }, // Enhanced to classic
+		{ 0xD3, { 0x09 }, 1, 0xF6, 1, 0x61, 0x95 }, // Classic to enhanced
+		{ 0xD3, { 0x09 }, 1, 0x23, LIN_GATEWAY_DROP, 0xD3, 0x23 }, // Enhanced checksum for classic
+		{ 0x14, { 0x09 }, 1, 0xF6, 2, 0xE2, 0xF6 }, // Classic to classic
+		{ 0x11, { 0x01, 0x02 }, 2, 0xEB, LIN_GATEWAY_DROP, 0x11, 0xEB }, // Not routed
+	};
+	lin_frame_t frame;
+	uint8_t dest;
+	bool pass;
+	
+	print_test_name();
+	
+	routes[0x10].pid = 0x11;
+	routes[0x10].dest = 1;
+	routes[0x12].pid = 0x20;
+	routes[0x12].flags = LIN_ROUTE_FLAG_DEST_CLASSIC;
+	routes[0x13].pid = 0x61;
+	routes[0x13].dest = 1;
+	routes[0x13].flags = LIN_ROUTE_FLAG_SRC_CLASSIC;
+	routes[0x14].pid = 0xE2;
+	routes[0x14].dest = 2;
+	routes[0x14].flags = LIN_ROUTE_FLAG_SRC_CLASSIC | LIN_ROUTE_FLAG_DEST_CLASSIC;
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("pid = 0x%02X, checksum = 0x%02X\n", tests[i].pid, tests[i].cksum);
+		frame.data = tests[i].data;
+		frame.data_len = tests[i].data_len;
+		frame.pid = tests[i].pid;
+		frame.cksum = tests[i].cksum;
+		dest = lin_gateway_forward(routes, &frame);
+		pass = (dest == tests[i].expected_dest && frame.pid == tests[i].expected_pid && frame.cksum == tests[i].expected_cksum &&
+			frame.data == tests[i].data && frame.data_len == tests[i].data_len);
+		print_case("expected = %u / 0x%02X 0x%02X, result = %u / 0x%02X 0x%02X\n", tests[i].expected_dest, tests[i].expected_pid,
+			tests[i].expected_cksum, dest, frame.pid, frame.cksum);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static void test_stats(test_result_t *results) {
+	// Each case updates a counter of a frame ID (given as a PID for some) the
+	// given number of times, then checks that counter for the frame ID and the
+	// global one. Counters of frame ID 0x3C start just short of saturating.
+	static lin_stats_t st;
+	static const struct {
+		uint8_t fid;
+		uint8_t type;
+		uint8_t repeat;
+		uint16_t expected;
+		uint16_t expected_total;
+	} tests[] = {
+		{ 0x10, LIN_STATS_OK, 1, 1, 1 },
+		{ 0x50, LIN_STATS_OK, 2, 3, 3 }, // PID of 0x10
+		{ 0x11, LIN_STATS_OK, 1, 1, 4 },
+		{ 0x10, LIN_STATS_PARITY, 1, 1, 1 },
+		{ 0x10, LIN_STATS_CKSUM, 3, 3, 3 },
+		{ 0x3C, LIN_STATS_TIMEOUT, 1, 0xFFFF, 1 },
+		{ 0x3C, LIN_STATS_TIMEOUT, 2, 0xFFFF, 3 }, // Saturated
+		{ 0x3C, LIN_STATS_OK, 1, 0xFFFF, 5 },
+	};
+	lin_stats_counters_t counters, total;
+	uint8_t seq;
+	bool pass;
+	
+	print_test_name();
+	
+	lin_stats_init(&st);
+	for(uint8_t k = 0; k < LIN_STATS_TYPES; k++) st.fid[0x3C].count[k] = 0xFFFE;
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("fid = 0x%02X, type = %u, repeat = %u\n", tests[i].fid, tests[i].type, tests[i].repeat);
+		seq = st.seq;
+		for(uint8_t j = 0; j < tests[i].repeat; j++) lin_stats_update(&st, tests[i].fid, tests[i].type);
+		lin_stats_snapshot(&st, tests[i].fid, &counters);
+		lin_stats_snapshot(&st, LIN_STATS_TOTAL, &total);
+		pass = (counters.count[tests[i].type] == tests[i].expected && total.count[tests[i].type] == tests[i].expected_total &&
+			(uint8_t)(st.seq - seq) == tests[i].repeat);
+		print_case("expected = %u / %u, result = %u / %u\n", tests[i].expected, tests[i].expected_total, counters.count[tests[i].type], total.count[tests[i].type]);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+#ifdef LIN_TRACE
+
+static uint8_t trace_out[LIN_TRACE_DUMP_HEADER_SIZE + (LIN_TRACE_SIZE * LIN_TRACE_DUMP_RECORD_SIZE)];
+static uint16_t trace_out_len;
+
+static int trace_capture(int c) {
+	if(trace_out_len < sizeof(trace_out)) trace_out[trace_out_len++] = c;
+	return c;
+}
+
+static void test_trace(test_result_t *results) {
+	// Whatever was traced by the tests before this one is first dumped to the
+	// simulator's output file, for decoding on the host. Each case then makes
+	// the given number of user records (with a PID of the case number and a
+	// status counting up), or calls library functions with trace points, and
+	// dumps the trace to RAM to check it. Timestamps must always increase.
+	static lin_route_t routes[64];
+	static const uint8_t gateway_data[2] = { 0x01, 0x02 };
+	static const struct {
+		bool lib;
+		uint8_t repeat;
+		uint8_t expected_count;
+		uint16_t expected_lost;
+		uint8_t expected_first_status;
+	} tests[] = {
+		{ false, 0, 0, 0, 0 },
+		{ false, 1, 1, 0, 0 },
+		{ false, 3, 3, 0, 0 },
+		{ false, LIN_TRACE_SIZE, LIN_TRACE_SIZE, 0, 0 },
+		{ false, LIN_TRACE_SIZE + 5, LIN_TRACE_SIZE, 5, 5 }, // Oldest overwritten
+		{ true, 0, 4, 0, 0 }, // Bus driver and gateway
+	};
+	static const uint8_t expected_lib[4][3] = {
+		{ LIN_TRACE_BREAK, 0x00, LIN_BUS_EVT_NONE },
+		{ LIN_TRACE_HEADER, 0x54, LIN_BUS_EVT_SYNC_ERROR },
+		{ LIN_TRACE_FORWARD, 0x50, 1 },
+		{ LIN_TRACE_FORWARD, 0x50, LIN_GATEWAY_DROP }, // Checksum already rewritten
+	};
+	lin_bus_t bus;
+	lin_frame_t frame;
+	const uint8_t *rec;
+	uint16_t lost, time, prev_time = 0;
+	uint8_t count;
+	bool pass;
+	
+	print_test_name();
+	
+	lin_trace_dump(ucsim_if_fout_putc);
+	
+	routes[0x10].pid = 0x11;
+	routes[0x10].dest = 1;
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("lib = %u, repeat = %u\n", tests[i].lib, tests[i].repeat);
+		for(uint8_t j = 0; j < tests[i].repeat; j++) lin_trace(LIN_TRACE_USER, i, j);
+		if(tests[i].lib) {
+			lin_bus_init(&bus, NULL, NULL);
+			lin_bus_break(&bus);
+			lin_bus_rx(&bus, 0x54);
+			frame.data = gateway_data;
+			frame.data_len = sizeof(gateway_data);
+			frame.pid = 0x50;
+			frame.cksum = 0xAC;
+			lin_gateway_forward(routes, &frame);
+			frame.pid = 0x50;
+			lin_gateway_forward(routes, &frame);
+		}
+		trace_out_len = 0;
+		lin_trace_dump(trace_capture);
+		lost = trace_out[4] | ((uint16_t)trace_out[5] << 8);
+		count = trace_out[6];
+		pass = (memcmp(trace_out, "LTRC", 4) == 0 && lost == tests[i].expected_lost && count == tests[i].expected_count &&
+			trace_out_len == LIN_TRACE_DUMP_HEADER_SIZE + (count * LIN_TRACE_DUMP_RECORD_SIZE));
+		for(uint8_t j = 0; pass && j < count; j++) {
+			rec = &trace_out[LIN_TRACE_DUMP_HEADER_SIZE + (j * LIN_TRACE_DUMP_RECORD_SIZE)];
+			time = rec[0] | ((uint16_t)rec[1] << 8);
+			if(j > 0 && (int16_t)(time - prev_time) <= 0) pass = false;
+			if(tests[i].lib) {
+				if(memcmp(&rec[2], expected_lib[j], 3) != 0) pass = false;
+			} else if(rec[2] != LIN_TRACE_USER || rec[3] != i || rec[4] != (uint8_t)(tests[i].expected_first_status + j)) {
+				pass = false;
+			}
+			prev_time = time;
+		}
+		print_case("expected = %u / %u, result = %u / %u\n", tests[i].expected_count, tests[i].expected_lost, count, lost);
+		if(count > 0) print_case("first = 0x%02X 0x%02X 0x%02X\n", trace_out[9], trace_out[10], trace_out[11]);
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+#endif // LIN_TRACE
+
+static void test_burst_detect(test_result_t *results) {
+	// Frame IDs 0x10 and 0x11 belong to node 0, 0x20 to node 1, and 0x3C to no
+	// node. Each step is repeated the given number of times, with no events
+	// expected until the last repetition.
+	static const struct {
+		uint8_t fid;
+		bool ok;
+		uint8_t repeat;
+		uint8_t expected_events;
+	} tests[] = {
+		{ 0x10, false, 1, 0 },
+		{ 0x11, false, 1, 0 },
+		{ 0x10, false, 1, 0 },
+		{ 0x11, false, 1, LIN_BURST_EVT_NODE_RAISE },
+		{ 0x20, false, 1, 0 },
+		{ 0x10, false, 1, 0 },
+		{ 0x10, false, 1, LIN_BURST_EVT_FID_RAISE },
+		{ 0x10, true, LIN_BURST_WINDOW - 1, LIN_BURST_EVT_FID_CLEAR | LIN_BURST_EVT_NODE_CLEAR },
+		{ 0x3C, false, 4, LIN_BURST_EVT_FID_RAISE },
+		{ 0x3C, true, LIN_BURST_WINDOW - 1, LIN_BURST_EVT_FID_CLEAR },
+		{ 0x20, true, 1, 0 },
+	};
+	static const lin_burst_config_t config = { NULL, 4, 1 };
+	static lin_burst_config_t mapped_config;
+	static uint8_t node_map[64];
+	static lin_burst_t bd;
+	uint8_t events;
+	bool pass;
+	
+	print_test_name();
+	
+	for(size_t i = 0; i < sizeof(node_map); i++) node_map[i] = LIN_BURST_NO_NODE;
+	node_map[0x10] = 0;
+	node_map[0x11] = 0;
+	node_map[0x20] = 1;
+	mapped_config = config;
+	mapped_config.node_map = node_map;
+	
+	lin_burst_init(&bd, &mapped_config);
+	
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		print_test_num(i);
+		print_case("fid = 0x%02X, ok = %u, repeat = %u\n", tests[i].fid, tests[i].ok, tests[i].repeat);
+		pass = true;
+		for(uint8_t j = 0; j < tests[i].repeat; j++) {
+			events = lin_burst_update(&bd, tests[i].fid, tests[i].ok);
+			if(j + 1 < tests[i].repeat && events != 0) pass = false;
+		}
+		pass = pass && (events == tests[i].expected_events);
+		print_case("expected = 0x%02X, events = 0x%02X, rate = %u/256\n", tests[i].expected_events, events, lin_burst_rate(&bd.fid[tests[i].fid]));
+		print_pass_fail(pass);
+		count_test_result(pass, results);
+	}
+}
+
+static bool read_vector_byte(uint8_t *b) {
+	if(!ucsim_if_fin_avail()) return false;
+	*b = ucsim_if_fin_getc();
+	return true;
+}
+
+static bool read_vector(uint8_t *flags, uint8_t *pid, uint8_t *data, uint8_t *cksum) {
+	// Returns false if the vector is malformed (length over 8) or the input
+	// ends part way through it.
+	uint8_t len;
+
+	if(!read_vector_byte(flags)) return false;
+	len = *flags & VECTOR_LEN_MASK;
+	if(len > 8) return false;
+	if(!read_vector_byte(pid)) return false;
+	for(uint8_t i = 0; i < len; i++) {
+		if(!read_vector_byte(&data[i])) return false;
+	}
+	return read_vector_byte(cksum);
+}
+
+static void test_file_vectors(test_result_t *results) {
+	// Vectors are streamed from the simulator's input file rather than being
+	// compiled in, so any number may be run. Only a summary is printed; the
+	// result of each vector is written to the output file as one bit (set on
+	// pass, LSB first), for analysis by the host tool.
+	uint8_t flags, pid, data[8], expected, cksum, len, out = 0, out_bit = 0x01;
+	uint32_t pass_count = 0, fail_count = 0;
+	bool pass, malformed = false;
+	
+	if(!ucsim_if_fin_avail()) return;
+	
+	print_test_name();
+	
+	while(ucsim_if_fin_avail()) {
+		if(!read_vector(&flags, &pid, data, &expected)) {
+			malformed = true;
+			break;
+		}
+		len = flags & VECTOR_LEN_MASK;
+		if(flags & VECTOR_FLAG_CLASSIC) {
+			cksum = lin_calculate_checksum_classic(data, len);
+			pass = (cksum == expected && lin_verify_checksum_classic(expected, data, len));
+		} else {
+			cksum = lin_calculate_checksum_enhanced(pid, data, len);
+			pass = (cksum == expected && lin_verify_checksum_enhanced(expected, pid, data, len));
+		}
+		
+		if(pass) {
+			out |= out_bit;
+			pass_count++;
+		} else {
+			fail_count++;
+		}
+		out_bit <<= 1;
+		if(out_bit == 0) {
+			ucsim_if_fout_putc(out);
+			out = 0;
+			out_bit = 0x01;
+		}
+	}
+	if(out_bit != 0x01) ucsim_if_fout_putc(out);
+	
+	printf("vectors = %lu, passed = %lu, failed = %lu\n", pass_count + fail_count, pass_count, fail_count);
+	if(malformed) printf("malformed or truncated vector after %lu\n", pass_count + fail_count);
+	pass = (fail_count == 0 && !malformed);
+	print_pass_fail(pass);
+	count_test_result(pass, results);
+}
+
+#ifdef TEST_EXHAUSTIVE
+
+// Number of randomised multi-byte payloads tested for each checksum type.
+#define RANDOM_PAYLOAD_COUNT 20000
+#define RANDOM_PAYLOAD_SEED 0xACE1
+
+static uint8_t model_checksum(const uint8_t init, const uint8_t *data, const uint8_t len) {
+	// Simple reference model: sum everything, then fold the carries back in.
+	uint16_t sum = init;
+	for(uint8_t i = 0; i < len; i++) sum += data[i];
+	while(sum > 0xFF) sum = (sum & 0xFF) + (sum >> 8);
+	return ~(uint8_t)sum;
+}
+
+static uint8_t model_protected_id(const uint8_t fid) {
+	const uint8_t p0 = ((fid >> 0) ^ (fid >> 1) ^ (fid >> 2) ^ (fid >> 4)) & 1;
+	const uint8_t p1 = ~((fid >> 1) ^ (fid >> 3) ^ (fid >> 4) ^ (fid >> 5)) & 1;
+	return (fid & 0x3F) | (p0 << 6) | (p1 << 7);
+}
+
+static uint16_t prng_next(uint16_t *state) {
+	// 16-bit xorshift, cheap enough to not dominate run time on the STM8.
+	*state ^= *state << 7;
+	*state ^= *state >> 9;
+	*state ^= *state << 8;
+	return *state;
+}
+
+static bool check_checksum(const bool classic, const uint8_t pid, const uint8_t *data, const uint8_t len) {
+	// Checks calculation against the model, and that verification accepts
+	// the correct checksum and rejects an incorrect one.
+	const uint8_t expected = model_checksum((classic ? 0 : pid), data, len);
+	
+	if(classic) {
+		return (lin_calculate_checksum_classic(data, len) == expected
+			&& lin_verify_checksum_classic(expected, data, len)
+			&& !lin_verify_checksum_classic(~expected, data, len));
+	} else {
+		return (lin_calculate_checksum_enhanced(pid, data, len) == expected
+			&& lin_verify_checksum_enhanced(expected, pid, data, len)
+			&& !lin_verify_checksum_enhanced(~expected, pid, data, len));
+	}
+}
+
+static void print_exhaustive_result(const char *name, const case_result_t *cases, test_result_t *results) {
+	const bool pass = (cases->fail_count == 0);
+	printf("%s: cases = %lu, failed = %lu\n", name, cases->pass_count + cases->fail_count, cases->fail_count);
+	print_pass_fail(pass);
+	count_test_result(pass, results);
+}
+
+static void test_exhaustive_protected_id(test_result_t *results) {
+	case_result_t cases = { 0, 0 };
+	uint8_t b = 0, fid;
+	bool pass;
+	
+	print_test_name();
+	
+	// Every byte value, both as a frame ID (of which only 64 are legal, the
+	// rest being truncated) and as a protected ID.
+	do {
+		pass = (lin_get_protected_id(b) == model_protected_id(b));
+		count_test_result(pass, &cases);
+	} while(++b != 0);
+	print_exhaustive_result("get", &cases, results);
+	
+	cases.pass_count = cases.fail_count = 0;
+	do {
+		pass = (lin_verify_protected_id(b, &fid) == (model_protected_id(b) == b) && fid == (b & 0x3F));
+		count_test_result(pass, &cases);
+	} while(++b != 0);
+	print_exhaustive_result("verify", &cases, results);
+}
+
+static void test_exhaustive_checksum(test_result_t *results) {
+	case_result_t cases = { 0, 0 };
+	uint16_t state = RANDOM_PAYLOAD_SEED, r;
+	uint8_t data[8], pid, len;
+	bool pass;
+	
+	print_test_name();
+	
+	// All single-byte payloads, classic and with every possible PID seed.
+	data[0] = 0;
+	do {
+		pass = check_checksum(true, 0, data, 1);
+		count_test_result(pass, &cases);
+		pid = 0;
+		do {
+			pass = check_checksum(false, pid, data, 1);
+			count_test_result(pass, &cases);
+		} while(++pid != 0);
+	} while(++data[0] != 0);
+	print_exhaustive_result("1 byte", &cases, results);
+	
+	// All two-byte payloads. An enhanced checksum is just a classic one with
+	// the PID as an extra leading byte, so two-byte sums of every PID and
+	// single byte were already covered above.
+	cases.pass_count = cases.fail_count = 0;
+	data[0] = 0;
+	do {
+		data[1] = 0;
+		do {
+			pass = check_checksum(true, 0, data, 2);
+			count_test_result(pass, &cases);
+		} while(++data[1] != 0);
+	} while(++data[0] != 0);
+	print_exhaustive_result("2 bytes", &cases, results);
+	
+	// Randomised payloads of 3 to 8 bytes, from a fixed seed so failures are
+	// reproducible.
+	cases.pass_count = cases.fail_count = 0;
+	for(uint16_t i = 0; i < RANDOM_PAYLOAD_COUNT; i++) {
+		r = prng_next(&state);
+		len = 3 + (r % 6);
+		pid = r >> 8;
+		for(uint8_t j = 0; j < len; j += 2) {
+			r = prng_next(&state);
+			data[j] = r;
+			data[j + 1] = r >> 8;
+		}
+		pass = check_checksum(true, 0, data, len);
+		count_test_result(pass, &cases);
+		pass = check_checksum(false, pid, data, len);
+		count_test_result(pass, &cases);
+	}
+	print_exhaustive_result("3-8 bytes", &cases, results);
+}
+
+#endif // TEST_EXHAUSTIVE
+
+#ifdef TEST_BENCH
+
+// Number of frames verified in batch benchmark.
+#define BENCH_BATCH_FRAMES 40
+
+// Number of frames forwarded in gateway benchmark, and CPU clock frequency for
+// converting cycles to frames per second.
+#define BENCH_GATEWAY_FRAMES 40
+#define BENCH_CPU_HZ 16000000UL
+
+// Greatest data length at which library functions are timed.
+#define BENCH_FN_MAX_LEN 8
+
+// Timer prescaler for timing the whole test suite. The timer is only 16-bit, so
+// cycles are counted in units of 1024 to allow for a run of up to ~67 million.
+#define BENCH_SUITE_PRESCALER_SHIFT 10
+
+static void timer_start(const uint16_t prescaler) {
+	// The update event resets the counter and loads the new prescaler value.
+	TIM1_PSCRH = (prescaler >> 8);
+	TIM1_PSCRL = (prescaler & 0xFF);
+	TIM1_EGR = TIM1_EGR_UG;
+	// The update event also sets the update flag, which is then left to show
+	// whether the counter has since overflowed.
+	TIM1_SR1 = 0;
+	TIM1_CR1 = TIM1_CR1_CEN;
+}
+
+static bool timer_overflowed(void) {
+	return (TIM1_SR1 & TIM1_SR1_UIF);
+}
+
+static uint16_t timer_stop(void) {
+	uint16_t count;
+	TIM1_CR1 = 0;
+	// High byte must be read first, which latches the low byte.
+	count = (uint16_t)TIM1_CNTRH << 8;
+	count |= TIM1_CNTRL;
+	return count;
+}
+
+static void bench_batch(void) {
+	// Compares verifying a full schedule round of 8-byte enhanced frames one
+	// at a time with doing them all in one batch call.
+	static uint8_t data[8];
+	static lin_frame_t frames[BENCH_BATCH_FRAMES];
+	static uint8_t res[(BENCH_BATCH_FRAMES + 7) / 8];
+	uint16_t overhead, single, batch;
+	
+	print_test_name();
+	
+	for(uint8_t i = 0; i < BENCH_BATCH_FRAMES; i++) {
+		frames[i].data = data;
+		frames[i].data_len = sizeof(data);
+		frames[i].pid = lin_get_protected_id(i);
+		frames[i].cksum = lin_calculate_checksum_enhanced(frames[i].pid, data, sizeof(data));
+	}
+	
+	timer_start(0);
+	overhead = timer_stop();
+	
+	timer_start(0);
+	for(uint8_t i = 0; i < BENCH_BATCH_FRAMES; i++) {
+		if(lin_verify_checksum_enhanced(frames[i].cksum, frames[i].pid, frames[i].data, frames[i].data_len)) {
+			res[i >> 3] |= (1 << (i & 7));
+		} else {
+			res[i >> 3] &= ~(1 << (i & 7));
+		}
+	}
+	single = timer_stop() - overhead;
+	
+	timer_start(0);
+	lin_verify_checksum_batch(frames, BENCH_BATCH_FRAMES, res);
+	batch = timer_stop() - overhead;
+	
+	printf("%u frames: per-frame = %u cycles, batch = %u cycles\n", BENCH_BATCH_FRAMES, single, batch);
+}
+
+static void bench_bus(void) {
+	// Times the receive interrupt handling of each byte of an 8-byte frame on
+	// two buses, each with its own context, frame table and (fake) UART, to
+	// show the cost of each handler call and that it is the same for every
+	// bus. The handler for the checksum byte includes storing the frame.
+	static const lin_frame_def_t frames[] = {
+		{ 0x50, 8, 0, 0, 0, 0 }, // 0x10
+	};
+	static uint8_t data[2][8], frame_flags[2][1];
+	static const lin_frame_table_t tables[2] = {
+		{ frames, NULL, data[0], frame_flags[0], NULL, 1 },
+		{ frames, NULL, data[1], frame_flags[1], NULL, 1 },
+	};
+	static lin_bus_t buses[2];
+	static uint8_t uarts[2][8];
+	static uint8_t rx[11] = { 0x55, 0x50, 1, 2, 3, 4, 5, 6, 7, 8 };
+	uint16_t overhead, ticks[4];
+	
+	print_test_name();
+	
+	rx[10] = lin_calculate_checksum_enhanced(0x50, &rx[2], 8);
+	
+	timer_start(0);
+	overhead = timer_stop();
+	
+	for(uint8_t b = 0; b < 2; b++) {
+		lin_bus_init(&buses[b], &tables[b], NULL);
+		
+		uarts[b][LIN_BUS_UART_CR4] = LIN_BUS_UART_CR4_LBDF;
+		timer_start(0);
+		lin_bus_isr(&buses[b], uarts[b]);
+		ticks[0] = timer_stop() - overhead;
+		
+		// Each byte is given a new value, so each one stored is a change.
+		for(uint8_t i = 0; i < sizeof(rx); i++) {
+			uarts[b][LIN_BUS_UART_SR] = LIN_BUS_UART_SR_RXNE;
+			uarts[b][LIN_BUS_UART_DR] = rx[i];
+			timer_start(0);
+			lin_bus_isr(&buses[b], uarts[b]);
+			if(i == 1) ticks[1] = timer_stop() - overhead;
+			else if(i == 2) ticks[2] = timer_stop() - overhead;
+			else ticks[3] = timer_stop() - overhead;
+		}
+		
+		printf("bus %u: break = %u, pid = %u, data = %u, checksum = %u cycles\n", b, ticks[0], ticks[1], ticks[2], ticks[3]);
+	}
+}
+
+static void bench_gateway(void) {
+	// Compares forwarding a schedule round of 8-byte enhanced frames, each to a
+	// different frame ID, by verifying, copying the data to a transmit buffer
+	// and calculating the checksum for the new PID, with doing it in place
+	// with lin_gateway_forward.
+	static uint8_t data[BENCH_GATEWAY_FRAMES][8], tx_data[BENCH_GATEWAY_FRAMES][8];
+	static lin_frame_t frames[BENCH_GATEWAY_FRAMES], tx_frames[BENCH_GATEWAY_FRAMES];
+	static lin_route_t routes[64];
+	uint16_t overhead, copy, forward;
+	
+	print_test_name();
+	
+	for(uint8_t i = 0; i < BENCH_GATEWAY_FRAMES; i++) {
+		for(uint8_t j = 0; j < 8; j++) data[i][j] = i + j;
+		frames[i].data = data[i];
+		frames[i].data_len = 8;
+		frames[i].pid = lin_get_protected_id(i);
+		frames[i].cksum = lin_calculate_checksum_enhanced(frames[i].pid, data[i], 8);
+		routes[i].pid = lin_get_protected_id(i + 1);
+	}
+	
+	timer_start(0);
+	overhead = timer_stop();
+	
+	timer_start(0);
+	for(uint8_t i = 0; i < BENCH_GATEWAY_FRAMES; i++) {
+		if(lin_verify_checksum_enhanced(frames[i].cksum, frames[i].pid, frames[i].data, frames[i].data_len)) {
+			memcpy(tx_data[i], frames[i].data, frames[i].data_len);
+			tx_frames[i].data = tx_data[i];
+			tx_frames[i].data_len = frames[i].data_len;
+			tx_frames[i].pid = routes[frames[i].pid & 0x3F].pid;
+			tx_frames[i].cksum = lin_calculate_checksum_enhanced(tx_frames[i].pid, tx_data[i], tx_frames[i].data_len);
+		}
+	}
+	copy = timer_stop() - overhead;
+	
+	timer_start(0);
+	for(uint8_t i = 0; i < BENCH_GATEWAY_FRAMES; i++) lin_gateway_forward(routes, &frames[i]);
+	forward = timer_stop() - overhead;
+	
+	printf("%u frames: copy and recalculate = %u cycles (%lu frames/s), forward = %u cycles (%lu frames/s)\n", BENCH_GATEWAY_FRAMES,
+		copy, (BENCH_CPU_HZ * BENCH_GATEWAY_FRAMES) / copy, forward, (BENCH_CPU_HZ * BENCH_GATEWAY_FRAMES) / forward);
+}
+
+#define bench_call(name, kind, val, expr) \
+	do { \
+		timer_start(0); \
+		bench_sink = (expr); \
+		ticks = timer_stop() - overhead; \
+		printf("CYCLES: %s %s = %u: %u\n", (name), (kind), (val), ticks); \
+	} while(0)
+
+static void bench_functions(void) {
+	// Times each library function, including the overhead of calling it, at a
+	// range of data lengths. The inputs must match those the WCET report tool
+	// uses for its cross-check: data of all 0xFF, PID 0x80, and a checksum
+	// (0x55) that never verifies. Protected ID functions are instead timed at a
+	// range of arguments, both in and out of range, and both valid and not.
+	static const uint8_t pid_args[] = { 0x00, 0x3F, 0x80, 0xBF, 0xFF };
+	static uint8_t data[BENCH_FN_MAX_LEN];
+	lin_far_ptr_t far_data = (uint16_t)data;
+	volatile uint8_t bench_sink;
+	uint16_t overhead, ticks;
+	uint8_t fid;
+	
+	print_test_name();
+	
+	for(uint8_t i = 0; i < BENCH_FN_MAX_LEN; i++) data[i] = 0xFF;
+	
+	timer_start(0);
+	overhead = timer_stop();
+	
+	for(uint8_t len = 0; len <= BENCH_FN_MAX_LEN; len++) {
+		bench_call("lin_calculate_checksum_classic", "len", len, lin_calculate_checksum_classic(data, len));
+		bench_call("lin_calculate_checksum_enhanced", "len", len, lin_calculate_checksum_enhanced(0x80, data, len));
+		bench_call("lin_verify_checksum_classic", "len", len, lin_verify_checksum_classic(0x55, data, len));
+		bench_call("lin_verify_checksum_enhanced", "len", len, lin_verify_checksum_enhanced(0x55, 0x80, data, len));
+		bench_call("lin_calculate_checksum_classic_far", "len", len, lin_calculate_checksum_classic_far(&far_data, len));
+		bench_call("lin_calculate_checksum_enhanced_far", "len", len, lin_calculate_checksum_enhanced_far(0x80, &far_data, len));
+		bench_call("lin_verify_checksum_classic_far", "len", len, lin_verify_checksum_classic_far(0x55, &far_data, len));
+		bench_call("lin_verify_checksum_enhanced_far", "len", len, lin_verify_checksum_enhanced_far(0x55, 0x80, &far_data, len));
+	}
+	for(uint8_t i = 0; i < sizeof(pid_args); i++) {
+		bench_call("lin_get_protected_id", "arg", pid_args[i], lin_get_protected_id(pid_args[i]));
+		bench_call("lin_verify_protected_id", "arg", pid_args[i], lin_verify_protected_id(pid_args[i], &fid));
+	}
+}
+
+#endif // TEST_BENCH
+
 void main(void) {
 	test_result_t results = { 0, 0 };
+#ifdef TEST_BENCH
+	uint16_t suite_ticks;
+	bool suite_overflow;
+#endif
 
 	CLK_CKDIVR = 0;
 
-	test_calculate_classic(&results);
-	test_calculate_enhanced(&results);
-	test_verify_classic(&results);
-	test_verify_enhanced(&results);
-	test_get_protected_id(&results);
-	test_verify_protected_id(&results);
+#if defined(LIN_TRACE) && !defined(TEST_BENCH)
+	// Trace records are timestamped from TIM1, left to count every cycle.
+	TIM1_EGR = TIM1_EGR_UG;
+	TIM1_CR1 = TIM1_CR1_CEN;
+#endif
+
+#ifdef TEST_PROF
+	prof_init();
+#endif
+
+#ifdef TEST_BENCH
+	timer_start((1 << BENCH_SUITE_PRESCALER_SHIFT) - 1);
+#endif
+
+	run_test(test_calculate_classic, &results);
+	run_test(test_calculate_enhanced, &results);
+	run_test(test_verify_classic, &results);
+	run_test(test_verify_enhanced, &results);
+	run_test(test_reseed_checksum, &results);
+	run_test(test_calculate_far, &results);
+	run_test(test_verify_far, &results);
+	run_test(test_verify_batch, &results);
+	run_test(test_verify_readback, &results);
+	run_test(test_get_protected_id, &results);
+	run_test(test_verify_protected_id, &results);
+	run_test(test_frame_find, &results);
+	run_test(test_frame_receive, &results);
+	run_test(test_master_schedule, &results);
+	run_test(test_bus, &results);
+	run_test(test_gateway, &results);
+	run_test(test_stats, &results);
+#ifdef LIN_TRACE
+	run_test(test_trace, &results);
+#endif
+	run_test(test_burst_detect, &results);
+	run_test(test_file_vectors, &results);
+#ifdef TEST_EXHAUSTIVE
+	run_test(test_exhaustive_protected_id, &results);
+	run_test(test_exhaustive_checksum, &results);
+#endif
+
+#ifdef TEST_BENCH
+	suite_ticks = timer_stop();
+	suite_overflow = timer_overflowed();
+#endif
 
 	puts(hrule_str);
 
 	printf("TOTAL RESULTS: passed = %u, failed = %u\n", results.pass_count, results.fail_count);
+
+#ifdef TEST_BENCH
+	if(suite_overflow) {
+		printf("TOTAL CYCLES: more than %lu (timer overflowed)\n", (uint32_t)UINT16_MAX << BENCH_SUITE_PRESCALER_SHIFT);
+	} else {
+		printf("TOTAL CYCLES: %lu (approx.)\n", (uint32_t)suite_ticks << BENCH_SUITE_PRESCALER_SHIFT);
+	}
+	bench_batch();
+	bench_bus();
+	bench_gateway();
+	bench_functions();
+#endif
+
+#ifdef TEST_PROF
+	prof_report();
+#endif
 	
 	ucsim_if_stop();
 }
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ *
+ * prof.c - Cycle-count profiling probes
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "prof.h"
+
+volatile uint16_t prof_ovf;
+prof_time_t prof_begin, prof_end;
+uint16_t prof_overhead;
+prof_probe_t prof_probes[PROF_PROBES];
+
+static uint32_t prof_elapsed(void) {
+	// The overflow count gives the high 16 bits of each time, so the counter's
+	// wrapping around never matters.
+	return ((((uint32_t)(uint16_t)(prof_end.ovf - prof_begin.ovf)) << 16) | prof_end.cnt) - prof_begin.cnt;
+}
+
+void prof_init(void) {
+	// TIM1 counts every cycle, from zero up to 0xFFFF, with an interrupt on
+	// each overflow. The update event generated to load the prescaler also
+	// sets the update flag, so that is cleared before the interrupt is enabled.
+	// Interrupts are then enabled globally. The least time measured between
+	// starting and immediately stopping is the cost of measurement.
+	uint32_t cycles;
+
+	memset(prof_probes, 0, sizeof(prof_probes));
+	for(uint8_t i = 0; i < PROF_PROBES; i++) prof_probes[i].min = UINT32_MAX;
+	prof_ovf = 0;
+
+	TIM1_CR1 = 0;
+	TIM1_PSCRH = 0;
+	TIM1_PSCRL = 0;
+	TIM1_EGR = TIM1_EGR_UG;
+	TIM1_SR1 = 0;
+	TIM1_IER = TIM1_IER_UIE;
+	TIM1_CR1 = TIM1_CR1_CEN;
+
+#ifdef __SDCC
+	__asm__("rim");
+#endif
+
+	prof_overhead = UINT16_MAX;
+	for(uint8_t i = 0; i < PROF_CALIBRATE_RUNS; i++) {
+		prof_start();
+		prof_latch(prof_end);
+		cycles = prof_elapsed();
+		if(cycles < prof_overhead) prof_overhead = (uint16_t)cycles;
+	}
+}
+
+void prof_record(const uint8_t id) {
+	prof_probe_t *probe;
+	uint32_t cycles;
+
+	if(id >= PROF_PROBES) return;
+
+	probe = &prof_probes[id];
+	cycles = prof_elapsed();
+	cycles = (cycles > prof_overhead ? cycles - prof_overhead : 0);
+	if(cycles < probe->min) probe->min = cycles;
+	if(cycles > probe->max) probe->max = cycles;
+	probe->sum = (cycles > UINT32_MAX - probe->sum ? UINT32_MAX : probe->sum + cycles);
+	if(probe->count != UINT16_MAX) probe->count++;
+}
+
+void prof_report(void) {
+	// Printed through the simulator interface as any other output, giving the
+	// minimum, maximum and mean cycles of every probe that has been used.
+	const prof_probe_t *probe;
+
+	printf("PROFILE: overhead = %u cycles\n", prof_overhead);
+	for(uint8_t i = 0; i < PROF_PROBES; i++) {
+		probe = &prof_probes[i];
+		if(probe->count == 0) continue;
+		printf("PROBE %02u %s: count = %u, min = %lu, max = %lu, mean = %lu\n", i, (probe->name != NULL ? probe->name : "-"),
+			probe->count, probe->min, probe->max, probe->sum / probe->count);
+	}
+}
+
+#ifdef __SDCC
+
+void prof_tim1_isr(void) __interrupt(PROF_TIM1_IRQ) {
+	TIM1_SR1 = (uint8_t)~TIM1_SR1_UIF;
+	prof_ovf++;
+}
+
+#endif // __SDCC
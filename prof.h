@@ -0,0 +1,112 @@
+/*******************************************************************************
+ *
+ * prof.h - Header for cycle-count profiling probes
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIM1_CR1 (*(volatile uint8_t *)(0x5250))
+#define TIM1_CR1_CEN 0x01
+#define TIM1_IER (*(volatile uint8_t *)(0x5254))
+#define TIM1_IER_UIE 0x01
+#define TIM1_SR1 (*(volatile uint8_t *)(0x5255))
+#define TIM1_SR1_UIF 0x01
+#define TIM1_EGR (*(volatile uint8_t *)(0x5257))
+#define TIM1_EGR_UG 0x01
+#define TIM1_CNTRH (*(volatile uint8_t *)(0x525E))
+#define TIM1_CNTRL (*(volatile uint8_t *)(0x525F))
+#define TIM1_PSCRH (*(volatile uint8_t *)(0x5260))
+#define TIM1_PSCRL (*(volatile uint8_t *)(0x5261))
+
+// Interrupt vector number of TIM1 update/overflow (on STM8S and STM8AF).
+#define PROF_TIM1_IRQ 11
+
+// Number of probes, each with its own statistics, identified by number from
+// zero. Probes with higher numbers are ignored.
+#ifndef PROF_PROBES
+#define PROF_PROBES 32
+#endif
+
+// Number of times the cost of measurement is measured, the least being taken.
+#define PROF_CALIBRATE_RUNS 8
+
+// A point in time: the 16-bit TIM1 counter, extended by a count of its
+// overflows kept by the update interrupt handler.
+typedef struct {
+	uint16_t ovf;
+	uint16_t cnt;
+} prof_time_t;
+
+typedef struct {
+	const char *name;
+	uint16_t count; // Saturating at 0xFFFF
+	uint32_t min;
+	uint32_t max;
+	uint32_t sum; // Saturating at 0xFFFFFFFF
+} prof_probe_t;
+
+extern volatile uint16_t prof_ovf;
+extern prof_time_t prof_begin, prof_end;
+extern uint16_t prof_overhead;
+extern prof_probe_t prof_probes[PROF_PROBES];
+
+// Latches the current time into a prof_time_t. The counter's high byte must be
+// read first, which latches the low byte. Should the counter overflow part way
+// through, which the overflow count changing shows, it is simply done again.
+#define prof_latch(t) \
+	do { \
+		(t).ovf = prof_ovf; \
+		(t).cnt = (uint16_t)TIM1_CNTRH << 8; \
+		(t).cnt |= TIM1_CNTRL; \
+	} while((t).ovf != prof_ovf)
+
+// Start and stop measuring the code in between, with the cycles taken counted
+// towards the statistics of the given probe. Nothing but the latching of the
+// time is done inside the measured interval, and the cost of that is taken
+// off. One measurement can be in progress at a time.
+#define prof_start() prof_latch(prof_begin)
+#define prof_stop(id) \
+	do { \
+		prof_latch(prof_end); \
+		prof_record(id); \
+	} while(0)
+
+#define prof_name(id, s) \
+	do { \
+		if((id) < PROF_PROBES) prof_probes[(id)].name = (s); \
+	} while(0)
+
+extern void prof_init(void);
+extern void prof_record(const uint8_t id);
+extern void prof_report(void);
+
+#ifdef __SDCC
+extern void prof_tim1_isr(void) __interrupt(PROF_TIM1_IRQ);
+#endif
+
+#endif // PROF_H_
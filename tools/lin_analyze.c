@@ -0,0 +1,230 @@
+/*******************************************************************************
+ *
+ * lin_analyze.c - LIN capture bus load and timing analysis
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "lincap.h"
+#include "lin_analyze.h"
+
+// Nominal frame lengths in bit times. The header is a break of at least 13
+// bits plus its delimiter, then sync and PID bytes, each of 10 bits including
+// start and stop bits. The response is the data bytes plus checksum.
+#define HEADER_BITS (13 + 1 + 10 + 10)
+#define BYTE_BITS 10
+
+/******************************************************************************/
+
+static unsigned int hist_bin(uint64_t val) {
+	unsigned int bin = 0;
+
+	while(val > 0 && bin < LIN_ANALYZE_HIST_BINS - 1) {
+		val >>= 1;
+		bin++;
+	}
+
+	return bin;
+}
+
+static void dist_add(lin_analyze_dist_t *dist, const uint64_t val) {
+	const uint32_t v = (val > UINT32_MAX ? UINT32_MAX : (uint32_t)val);
+
+	if(dist->count == 0 || v < dist->min) dist->min = v;
+	if(dist->count == 0 || v > dist->max) dist->max = v;
+	dist->count++;
+	dist->sum += v;
+	dist->hist[hist_bin(v)]++;
+}
+
+static void window_close(lin_analyze_t *an) {
+	// A partial window's load can't be known, as the capture ended part way
+	// through it, so it is only passed on, and not counted in the peak or
+	// load bands.
+	lin_analyze_window_t *win = &an->window;
+	unsigned int band = (unsigned int)((win->busy_us * LIN_ANALYZE_LOAD_BANDS) / win->length_us);
+
+	if(!win->partial) {
+		if(band >= LIN_ANALYZE_LOAD_BANDS) band = LIN_ANALYZE_LOAD_BANDS - 1;
+		an->band_windows[band]++;
+		an->band_frames[band] += win->frames;
+		an->band_errors[band] += win->errors;
+
+		if(an->window_count == 0 || win->busy_us * an->peak_window.length_us > an->peak_window.busy_us * win->length_us) {
+			an->peak_window = *win;
+		}
+		an->window_count++;
+	}
+
+	if(an->on_window != NULL) an->on_window(win, an->ctx);
+
+	win->start_us += win->length_us;
+	win->busy_us = 0;
+	win->frames = 0;
+	win->errors = 0;
+}
+
+void lin_analyze_init(lin_analyze_t *an, const uint32_t baud, const uint64_t window_us, lin_analyze_window_fn on_window, void *ctx) {
+	memset(an, 0, sizeof(*an));
+	an->baud = (baud > 0 ? baud : LINCAP_DEFAULT_BAUD);
+	an->window_us = (window_us > 0 ? window_us : LIN_ANALYZE_DEFAULT_WINDOW_US);
+	an->on_window = on_window;
+	an->ctx = ctx;
+}
+
+uint64_t lin_analyze_frame_duration(const lin_analyze_t *an, const lincap_frame_t *frame) {
+	uint64_t bits = HEADER_BITS;
+
+	if(!(frame->flags & LINCAP_FLAG_NO_RESPONSE)) bits += (uint64_t)(frame->data_len + 1) * BYTE_BITS;
+
+	return (bits * 1000000 + an->baud / 2) / an->baud;
+}
+
+uint8_t lin_analyze_frame(lin_analyze_t *an, const lincap_frame_t *frame) {
+	lin_analyze_fid_t *fs = &an->fid[frame->pid & 0x3F];
+	const uint8_t status = lincap_frame_verify(frame);
+	const uint64_t duration = lin_analyze_frame_duration(an, frame);
+	uint64_t period;
+	double delta;
+
+	if(!an->started) {
+		an->started = true;
+		an->first_time = frame->time_us;
+		an->window.start_us = frame->time_us;
+		an->window.length_us = an->window_us;
+	}
+	an->last_time = frame->time_us;
+
+	// Close off any windows this frame is beyond, including empty ones.
+	while(frame->time_us >= an->window.start_us + an->window.length_us) window_close(an);
+
+	an->frames++;
+	an->busy_us += duration;
+	an->window.frames++;
+	an->window.busy_us += duration;
+	if(status != LINCAP_STATUS_OK) {
+		an->errors++;
+		an->window.errors++;
+		fs->errors++;
+	}
+
+	if(fs->frames > 0) {
+		period = frame->time_us - fs->last_time;
+		if(fs->period_count == 0 || period < fs->period_min) fs->period_min = period;
+		if(fs->period_count == 0 || period > fs->period_max) fs->period_max = period;
+		fs->period_count++;
+		delta = (double)period - fs->period_mean;
+		fs->period_mean += delta / fs->period_count;
+		fs->period_m2 += delta * ((double)period - fs->period_mean);
+
+		if(fs->period_count > 1) {
+			dist_add(&fs->jitter, (period > fs->last_period ? period - fs->last_period : fs->last_period - period));
+		}
+		fs->last_period = period;
+	}
+	fs->last_time = frame->time_us;
+	fs->frames++;
+
+	if(frame->flags & LINCAP_FLAG_NO_RESPONSE) {
+		fs->no_response++;
+	} else {
+		dist_add(&fs->resp_delay, frame->resp_delay_us);
+	}
+
+	return status;
+}
+
+void lin_analyze_finish(lin_analyze_t *an) {
+	// The final window is only partially covered by the capture. It keeps its
+	// full length, but is marked as partial so that it doesn't count towards
+	// the peak or load bands.
+	if(an->started && an->window.frames > 0) {
+		an->window.partial = true;
+		window_close(an);
+	}
+}
+
+static void print_hist(FILE *out, const char *name, const lin_analyze_dist_t *dist) {
+	// Only non-empty bins are printed.
+	fprintf(out, "  %-10s", name);
+	for(unsigned int i = 0; i < LIN_ANALYZE_HIST_BINS; i++) {
+		if(dist->hist[i] == 0) continue;
+		if(i <= 1) {
+			fprintf(out, " %u:%u", i, dist->hist[i]);
+		} else if(i == LIN_ANALYZE_HIST_BINS - 1) {
+			fprintf(out, " >=%lu:%u", 1UL << (i - 1), dist->hist[i]);
+		} else {
+			fprintf(out, " %lu-%lu:%u", 1UL << (i - 1), (1UL << i) - 1, dist->hist[i]);
+		}
+	}
+	fputc('\n', out);
+}
+
+void lin_analyze_report(const lin_analyze_t *an, FILE *out) {
+	const uint64_t span = (an->started ? an->last_time - an->first_time : 0);
+
+	fprintf(out, "frames = %u, errors = %u, duration = %.3f s, baud = %u\n", an->frames, an->errors, span / 1e6, an->baud);
+	fprintf(out, "bus load: mean = %.1f%%", (span > 0 ? 100.0 * an->busy_us / span : 0.0));
+	if(an->window_count > 0) {
+		fprintf(out, ", peak = %.1f%% (window at %.3f s, %u errors)",
+			100.0 * an->peak_window.busy_us / an->peak_window.length_us,
+			(an->peak_window.start_us - an->first_time) / 1e6, an->peak_window.errors);
+	}
+	fputc('\n', out);
+
+	fprintf(out, "\nerrors by bus load (%.3f s windows):\n", an->window_us / 1e6);
+	fprintf(out, "  load      windows     frames     errors   error rate\n");
+	for(unsigned int i = 0; i < LIN_ANALYZE_LOAD_BANDS; i++) {
+		if(an->band_windows[i] == 0) continue;
+		fprintf(out, "  %3u-%3u%% %8u %10u %10u   %9.4f%%\n", i * 100 / LIN_ANALYZE_LOAD_BANDS,
+			(i + 1) * 100 / LIN_ANALYZE_LOAD_BANDS, an->band_windows[i], an->band_frames[i], an->band_errors[i],
+			(an->band_frames[i] > 0 ? 100.0 * an->band_errors[i] / an->band_frames[i] : 0.0));
+	}
+
+	fprintf(out, "\nper frame ID (times in microseconds):\n");
+	fprintf(out, "  fid   frames  errors noresp  period_min period_mean  period_max   stddev  jitter_max  resp_min resp_mean resp_max\n");
+	for(size_t i = 0; i < LINCAP_FID_COUNT; i++) {
+		const lin_analyze_fid_t *fs = &an->fid[i];
+		if(fs->frames == 0) continue;
+		fprintf(out, "  0x%02zX %8u %7u %6u %11llu %11.1f %11llu %8.1f %11u %9u %9.1f %8u\n",
+			i, fs->frames, fs->errors, fs->no_response,
+			(unsigned long long)fs->period_min, fs->period_mean, (unsigned long long)fs->period_max,
+			(fs->period_count > 1 ? sqrt(fs->period_m2 / (fs->period_count - 1)) : 0.0),
+			fs->jitter.max, fs->resp_delay.min,
+			(fs->resp_delay.count > 0 ? (double)fs->resp_delay.sum / fs->resp_delay.count : 0.0), fs->resp_delay.max);
+	}
+
+	fprintf(out, "\nhistograms (microseconds:count):\n");
+	for(size_t i = 0; i < LINCAP_FID_COUNT; i++) {
+		const lin_analyze_fid_t *fs = &an->fid[i];
+		if(fs->frames == 0) continue;
+		fprintf(out, "0x%02zX\n", i);
+		print_hist(out, "jitter", &fs->jitter);
+		print_hist(out, "resp delay", &fs->resp_delay);
+	}
+}
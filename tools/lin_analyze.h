@@ -0,0 +1,113 @@
+/*******************************************************************************
+ *
+ * lin_analyze.h - LIN capture bus load and timing analysis header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_ANALYZE_H_
+#define LIN_ANALYZE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "lincap.h"
+
+// Histogram bins are powers of two: bin 0 counts values of 0, bin 1 values of
+// 1, bin 2 values of 2-3, bin 3 values of 4-7, and so on, with the last bin
+// counting everything larger.
+#define LIN_ANALYZE_HIST_BINS 18
+
+// Windows are grouped into bands of bus load (0-10%, 10-20%, ..., 90%+) to
+// relate error rates to load.
+#define LIN_ANALYZE_LOAD_BANDS 10
+
+#define LIN_ANALYZE_DEFAULT_WINDOW_US 1000000
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+	uint32_t hist[LIN_ANALYZE_HIST_BINS];
+} lin_analyze_dist_t;
+
+typedef struct {
+	uint32_t frames;
+	uint32_t errors;
+	uint32_t no_response;
+	uint64_t last_time;
+	uint64_t last_period;
+	uint64_t period_count;
+	uint64_t period_min;
+	uint64_t period_max;
+	double period_mean; // Running mean and sum of squared differences, for
+	double period_m2; // standard deviation (Welford's method)
+	lin_analyze_dist_t jitter; // Period-to-period change, microseconds
+	lin_analyze_dist_t resp_delay; // Header-to-response gap, microseconds
+} lin_analyze_fid_t;
+
+typedef struct {
+	uint64_t start_us;
+	uint64_t length_us;
+	uint64_t busy_us; // Bus time occupied by frames starting in window
+	uint32_t frames;
+	uint32_t errors;
+	bool partial; // Final window, cut short by the end of the capture
+} lin_analyze_window_t;
+
+// Called as each window of time completes.
+typedef void (*lin_analyze_window_fn)(const lin_analyze_window_t *window, void *ctx);
+
+typedef struct {
+	uint32_t baud;
+	uint64_t window_us;
+	lin_analyze_window_fn on_window;
+	void *ctx;
+
+	bool started;
+	uint64_t first_time;
+	uint64_t last_time;
+	uint64_t busy_us;
+	uint32_t frames;
+	uint32_t errors;
+
+	lin_analyze_window_t window;
+	uint32_t window_count;
+	lin_analyze_window_t peak_window;
+	uint32_t band_windows[LIN_ANALYZE_LOAD_BANDS];
+	uint32_t band_frames[LIN_ANALYZE_LOAD_BANDS];
+	uint32_t band_errors[LIN_ANALYZE_LOAD_BANDS];
+
+	lin_analyze_fid_t fid[LINCAP_FID_COUNT];
+} lin_analyze_t;
+
+/******************************************************************************/
+
+extern void lin_analyze_init(lin_analyze_t *an, const uint32_t baud, const uint64_t window_us, lin_analyze_window_fn on_window, void *ctx);
+extern uint8_t lin_analyze_frame(lin_analyze_t *an, const lincap_frame_t *frame);
+extern void lin_analyze_finish(lin_analyze_t *an);
+extern uint64_t lin_analyze_frame_duration(const lin_analyze_t *an, const lincap_frame_t *frame);
+extern void lin_analyze_report(const lin_analyze_t *an, FILE *out);
+
+#endif // LIN_ANALYZE_H_
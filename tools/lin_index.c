@@ -0,0 +1,455 @@
+/*******************************************************************************
+ *
+ * lin_index.c - LIN capture frame ID and time index
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lincap.h"
+#include "lin_index.h"
+
+#define LIN_INDEX_HEADER_SIZE 32
+
+// Number of records room is first made for when building an index from a
+// capture of unknown length.
+#define LIN_INDEX_GROW_RECORDS 4096
+
+typedef struct {
+	lincap_reader_t *cap;
+	lin_index_stats_t *stats;
+	uint32_t last_block;
+} lin_index_cursor_t;
+
+/******************************************************************************/
+
+static bool lin_index_alloc(lin_index_t *idx) {
+	idx->block_time = malloc((idx->block_count > 0 ? idx->block_count : 1) * sizeof(uint64_t));
+	idx->postings = malloc((idx->record_count > 0 ? idx->record_count : 1) * sizeof(uint32_t));
+	idx->fail_bitmap = calloc((idx->record_count / 8) + 1, 1);
+
+	if(idx->block_time == NULL || idx->postings == NULL || idx->fail_bitmap == NULL) {
+		fputs("out of memory\n", stderr);
+		lin_index_free(idx);
+		return false;
+	}
+
+	return true;
+}
+
+static void lin_index_fill_starts(lin_index_t *idx) {
+	uint32_t start = 0;
+
+	for(size_t i = 0; i < LINCAP_FID_COUNT; i++) {
+		idx->posting_start[i] = start;
+		start += idx->posting_count[i];
+	}
+}
+
+static long lin_index_file_size(const char *path) {
+	FILE *file = fopen(path, "rb");
+	long size = -1;
+
+	if(file != NULL) {
+		if(fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+		fclose(file);
+	}
+
+	return size;
+}
+
+static bool lin_index_grow(lin_index_t *idx, uint8_t **fids, uint32_t *capacity) {
+	// Doubles the room for records, for a capture of unknown length (i.e. read
+	// from standard input). New fail bitmap bytes must start clear.
+	const size_t old_bitmap = (*capacity / 8) + 1;
+	uint32_t new_capacity, blocks;
+	void *p;
+
+	if(*capacity > UINT32_MAX / 2) return false;
+	new_capacity = *capacity * 2;
+	blocks = (new_capacity + idx->block_records - 1) / idx->block_records;
+
+	if((p = realloc(*fids, new_capacity)) == NULL) return false;
+	*fids = p;
+	if((p = realloc(idx->block_time, blocks * sizeof(uint64_t))) == NULL) return false;
+	idx->block_time = p;
+	if((p = realloc(idx->postings, new_capacity * sizeof(uint32_t))) == NULL) return false;
+	idx->postings = p;
+	if((p = realloc(idx->fail_bitmap, (new_capacity / 8) + 1)) == NULL) return false;
+	idx->fail_bitmap = p;
+	memset(idx->fail_bitmap + old_bitmap, 0, ((new_capacity / 8) + 1) - old_bitmap);
+
+	*capacity = new_capacity;
+
+	return true;
+}
+
+bool lin_index_build(lin_index_t *idx, const char *capture_path, const uint32_t block_records) {
+	lincap_reader_t cap;
+	lincap_frame_t frame;
+	uint32_t fill[LINCAP_FID_COUNT];
+	uint8_t *fids;
+	uint64_t prev_time = 0;
+	uint32_t rec, capacity;
+	bool known, ok = true;
+	long size;
+
+	memset(idx, 0, sizeof(*idx));
+
+	if(block_records == 0) return false;
+	if(!lincap_open(&cap, capture_path)) return false;
+
+	// The number of records is known in advance unless reading from standard
+	// input, in which case room is made for more as they arrive.
+	known = (cap.record_count != UINT32_MAX);
+	capacity = (known ? cap.record_count : LIN_INDEX_GROW_RECORDS);
+
+	idx->record_count = capacity;
+	idx->block_records = block_records;
+	idx->block_count = (capacity + block_records - 1) / block_records;
+
+	// Frame IDs are held temporarily so the postings can be laid out grouped
+	// by ID with a counting sort, without a second pass over the capture.
+	fids = malloc(capacity > 0 ? capacity : 1);
+	if(fids == NULL || !lin_index_alloc(idx)) {
+		free(fids);
+		lincap_close(&cap);
+		return false;
+	}
+
+	for(rec = 0; lincap_read(&cap, &frame); rec++) {
+		if(frame.time_us < prev_time) {
+			fprintf(stderr, "%s: record %u is out of time order\n", capture_path, rec);
+			ok = false;
+			break;
+		}
+		prev_time = frame.time_us;
+
+		if(rec == capacity && !lin_index_grow(idx, &fids, &capacity)) {
+			fputs("out of memory\n", stderr);
+			ok = false;
+			break;
+		}
+
+		if(rec % block_records == 0) idx->block_time[rec / block_records] = frame.time_us;
+		if(lincap_frame_verify(&frame) != LINCAP_STATUS_OK) idx->fail_bitmap[rec >> 3] |= (uint8_t)(1 << (rec & 7));
+
+		fids[rec] = frame.pid & 0x3F;
+		idx->posting_count[fids[rec]]++;
+	}
+
+	lincap_close(&cap);
+
+	if(!ok || (known && rec != idx->record_count)) {
+		free(fids);
+		lin_index_free(idx);
+		return false;
+	}
+
+	idx->record_count = rec;
+	idx->block_count = (rec + block_records - 1) / block_records;
+	// The size of the file as it is, including any trailing partial record, so
+	// that it isn't taken to be stale straight away. Standard input has no
+	// size, so only whole records can be counted.
+	if(known) {
+		if((size = lin_index_file_size(capture_path)) < 0) {
+			perror(capture_path);
+			free(fids);
+			lin_index_free(idx);
+			return false;
+		}
+		idx->capture_size = (uint64_t)size;
+	} else {
+		idx->capture_size = (uint64_t)LINCAP_HEADER_SIZE + (uint64_t)rec * LINCAP_RECORD_SIZE;
+	}
+
+	lin_index_fill_starts(idx);
+	memcpy(fill, idx->posting_start, sizeof(fill));
+	for(rec = 0; rec < idx->record_count; rec++) {
+		idx->postings[fill[fids[rec]]++] = rec;
+	}
+
+	free(fids);
+
+	return true;
+}
+
+bool lin_index_save(const lin_index_t *idx, const char *index_path) {
+	uint8_t buf[LIN_INDEX_HEADER_SIZE];
+	FILE *file;
+	bool ok = true;
+
+	file = fopen(index_path, "wb");
+	if(file == NULL) {
+		perror(index_path);
+		return false;
+	}
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, LIN_INDEX_MAGIC, 4);
+	lincap_put_u16(buf + 4, LIN_INDEX_VERSION);
+	lincap_put_u32(buf + 8, idx->record_count);
+	lincap_put_u32(buf + 12, idx->block_records);
+	lincap_put_u32(buf + 16, idx->block_count);
+	lincap_put_u64(buf + 24, idx->capture_size);
+	ok = ok && (fwrite(buf, LIN_INDEX_HEADER_SIZE, 1, file) == 1);
+
+	for(size_t i = 0; ok && i < LINCAP_FID_COUNT; i++) {
+		lincap_put_u32(buf, idx->posting_count[i]);
+		ok = (fwrite(buf, 4, 1, file) == 1);
+	}
+	for(uint32_t i = 0; ok && i < idx->block_count; i++) {
+		lincap_put_u64(buf, idx->block_time[i]);
+		ok = (fwrite(buf, 8, 1, file) == 1);
+	}
+	for(uint32_t i = 0; ok && i < idx->record_count; i++) {
+		lincap_put_u32(buf, idx->postings[i]);
+		ok = (fwrite(buf, 4, 1, file) == 1);
+	}
+	if(ok && idx->record_count > 0) {
+		ok = (fwrite(idx->fail_bitmap, (idx->record_count + 7) / 8, 1, file) == 1);
+	}
+
+	ok = (fclose(file) == 0) && ok;
+	if(!ok) perror(index_path);
+
+	return ok;
+}
+
+bool lin_index_load(lin_index_t *idx, const char *index_path) {
+	uint8_t buf[LIN_INDEX_HEADER_SIZE];
+	FILE *file;
+	uint64_t posting_total = 0, expected_size;
+	long size;
+	bool ok, bad_posting = false;
+
+	memset(idx, 0, sizeof(*idx));
+
+	file = fopen(index_path, "rb");
+	if(file == NULL) {
+		perror(index_path);
+		return false;
+	}
+
+	ok = (fread(buf, LIN_INDEX_HEADER_SIZE, 1, file) == 1)
+		&& (memcmp(buf, LIN_INDEX_MAGIC, 4) == 0)
+		&& (lincap_get_u16(buf + 4) == LIN_INDEX_VERSION);
+	if(!ok) {
+		fprintf(stderr, "%s: not a LIN capture index file\n", index_path);
+		fclose(file);
+		return false;
+	}
+
+	idx->record_count = lincap_get_u32(buf + 8);
+	idx->block_records = lincap_get_u32(buf + 12);
+	idx->block_count = lincap_get_u32(buf + 16);
+	idx->capture_size = lincap_get_u64(buf + 24);
+
+	for(size_t i = 0; ok && i < LINCAP_FID_COUNT; i++) {
+		ok = (fread(buf, 4, 1, file) == 1);
+		idx->posting_count[i] = lincap_get_u32(buf);
+		posting_total += idx->posting_count[i];
+	}
+
+	// Everything the sizes of the tables depend on is checked against each
+	// other and against the size of the file before anything is allocated,
+	// so a corrupt index can neither cause a huge allocation nor be read
+	// beyond its tables.
+	expected_size = LIN_INDEX_HEADER_SIZE + (LINCAP_FID_COUNT * 4) + ((uint64_t)idx->block_count * 8) +
+		((uint64_t)idx->record_count * 4) + ((uint64_t)idx->record_count + 7) / 8;
+	if(ok && (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+		fseek(file, LIN_INDEX_HEADER_SIZE + (LINCAP_FID_COUNT * 4), SEEK_SET) != 0)) {
+		perror(index_path);
+		fclose(file);
+		return false;
+	}
+	if(!ok || idx->block_records == 0 || posting_total != idx->record_count ||
+		idx->block_count != ((uint64_t)idx->record_count + idx->block_records - 1) / idx->block_records ||
+		(uint64_t)size != expected_size) {
+		fprintf(stderr, "%s: corrupt index file\n", index_path);
+		fclose(file);
+		return false;
+	}
+
+	if(!lin_index_alloc(idx)) {
+		fclose(file);
+		return false;
+	}
+
+	for(uint32_t i = 0; ok && i < idx->block_count; i++) {
+		ok = (fread(buf, 8, 1, file) == 1);
+		idx->block_time[i] = lincap_get_u64(buf);
+	}
+	for(uint32_t i = 0; ok && i < idx->record_count; i++) {
+		ok = (fread(buf, 4, 1, file) == 1);
+		idx->postings[i] = lincap_get_u32(buf);
+		if(idx->postings[i] >= idx->record_count) bad_posting = true;
+	}
+	if(ok && idx->record_count > 0) {
+		ok = (fread(idx->fail_bitmap, (idx->record_count + 7) / 8, 1, file) == 1);
+	}
+
+	fclose(file);
+
+	if(!ok || bad_posting) {
+		fprintf(stderr, "%s: %s index file\n", index_path, (ok ? "corrupt" : "truncated"));
+		lin_index_free(idx);
+		return false;
+	}
+
+	lin_index_fill_starts(idx);
+
+	return true;
+}
+
+void lin_index_free(lin_index_t *idx) {
+	free(idx->block_time);
+	free(idx->postings);
+	free(idx->fail_bitmap);
+	memset(idx, 0, sizeof(*idx));
+}
+
+bool lin_index_is_stale(const lin_index_t *idx, const char *capture_path) {
+	long size = lin_index_file_size(capture_path);
+	return (size < 0 || (uint64_t)size != idx->capture_size);
+}
+
+static bool lin_index_read_record(lin_index_cursor_t *cur, const uint32_t block_records, const uint32_t record, lincap_frame_t *frame) {
+	uint32_t block = record / block_records;
+
+	if(block != cur->last_block) {
+		cur->stats->blocks_read++;
+		cur->last_block = block;
+	}
+
+	return lincap_seek(cur->cap, record) && lincap_read(cur->cap, frame);
+}
+
+static bool lin_index_time_bound(const lin_index_t *idx, lin_index_cursor_t *cur, const uint64_t time, uint32_t *record) {
+	// Finds the first record at or after the given time. The sparse time index
+	// narrows the search to a single block, which is then scanned.
+	lincap_frame_t frame;
+	uint32_t lo = 0, hi = idx->block_count, mid, rec, end;
+
+	if(idx->record_count == 0 || time <= idx->block_time[0]) {
+		*record = 0;
+		return true;
+	}
+
+	// Find last block starting before the given time.
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if(idx->block_time[mid] < time) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	rec = lo * idx->block_records;
+	end = rec + idx->block_records;
+	if(end > idx->record_count) end = idx->record_count;
+
+	for(; rec < end; rec++) {
+		if(!lin_index_read_record(cur, idx->block_records, rec, &frame)) return false;
+		if(frame.time_us >= time) break;
+	}
+
+	*record = rec;
+
+	return true;
+}
+
+static uint32_t lin_index_posting_bound(const uint32_t *postings, const uint32_t count, const uint32_t record) {
+	uint32_t lo = 0, hi = count, mid;
+
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(postings[mid] < record) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static bool lin_index_emit(const lin_index_t *idx, lin_index_cursor_t *cur, const uint32_t record, lin_index_match_fn match, void *ctx) {
+	lincap_frame_t frame;
+
+	cur->stats->matches++;
+
+	// Without a callback, only a count is wanted, so the capture need not be
+	// touched at all.
+	if(match == NULL) return true;
+	if(!lin_index_read_record(cur, idx->block_records, record, &frame)) return false;
+
+	return match(record, &frame, ctx);
+}
+
+bool lin_index_query(const lin_index_t *idx, lincap_reader_t *cap, const lin_index_query_t *query, lin_index_match_fn match, void *ctx, lin_index_stats_t *stats) {
+	lin_index_cursor_t cur = { cap, stats, UINT32_MAX };
+	uint32_t first, last, rec;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if(!lin_index_time_bound(idx, &cur, query->time_from, &first)) return false;
+	if(query->time_to == UINT64_MAX) {
+		last = idx->record_count;
+	} else if(!lin_index_time_bound(idx, &cur, query->time_to, &last)) {
+		return false;
+	}
+
+	if(query->fid == LIN_INDEX_ANY_FID) {
+		for(rec = first; rec < last; rec++) {
+			if(query->failed_only) {
+				// Skip over whole bytes of the bitmap with no failures.
+				if((rec & 7) == 0 && idx->fail_bitmap[rec >> 3] == 0) {
+					rec += 7;
+					continue;
+				}
+				if(!lin_index_record_failed(idx, rec)) continue;
+			}
+			stats->candidates++;
+			if(!lin_index_emit(idx, &cur, rec, match, ctx)) break;
+		}
+	} else {
+		const uint32_t *postings = idx->postings + idx->posting_start[query->fid & 0x3F];
+		const uint32_t count = idx->posting_count[query->fid & 0x3F];
+		uint32_t begin = lin_index_posting_bound(postings, count, first);
+		uint32_t end = lin_index_posting_bound(postings, count, last);
+
+		for(uint32_t i = begin; i < end; i++) {
+			stats->candidates++;
+			if(query->failed_only && !lin_index_record_failed(idx, postings[i])) continue;
+			if(!lin_index_emit(idx, &cur, postings[i], match, ctx)) break;
+		}
+	}
+
+	return true;
+}
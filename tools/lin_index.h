@@ -0,0 +1,83 @@
+/*******************************************************************************
+ *
+ * lin_index.h - LIN capture frame ID and time index header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_INDEX_H_
+#define LIN_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lincap.h"
+
+#define LIN_INDEX_MAGIC "LIDX"
+#define LIN_INDEX_VERSION 1
+#define LIN_INDEX_DEFAULT_BLOCK 256
+
+// Use as query frame ID to match frames of any ID.
+#define LIN_INDEX_ANY_FID -1
+
+typedef struct {
+	uint32_t record_count;
+	uint32_t block_records; // Records per time index block
+	uint32_t block_count;
+	uint64_t capture_size; // Size of capture file index was built from
+	uint32_t posting_count[LINCAP_FID_COUNT];
+	uint32_t posting_start[LINCAP_FID_COUNT];
+	uint64_t *block_time; // Time of first record in each block
+	uint32_t *postings; // Record numbers, grouped by frame ID
+	uint8_t *fail_bitmap; // One bit per record, set on parity/checksum error
+} lin_index_t;
+
+typedef struct {
+	int fid; // Frame ID, or LIN_INDEX_ANY_FID
+	uint64_t time_from; // Inclusive
+	uint64_t time_to; // Exclusive
+	bool failed_only;
+} lin_index_query_t;
+
+typedef struct {
+	uint32_t candidates; // Records considered from postings
+	uint32_t matches;
+	uint32_t blocks_read; // Distinct capture blocks touched
+} lin_index_stats_t;
+
+// Called for each matching frame. Return false to stop the query.
+typedef bool (*lin_index_match_fn)(const uint32_t record, const lincap_frame_t *frame, void *ctx);
+
+/******************************************************************************/
+
+extern bool lin_index_build(lin_index_t *idx, const char *capture_path, const uint32_t block_records);
+extern bool lin_index_save(const lin_index_t *idx, const char *index_path);
+extern bool lin_index_load(lin_index_t *idx, const char *index_path);
+extern void lin_index_free(lin_index_t *idx);
+extern bool lin_index_is_stale(const lin_index_t *idx, const char *capture_path);
+extern bool lin_index_query(const lin_index_t *idx, lincap_reader_t *cap, const lin_index_query_t *query, lin_index_match_fn match, void *ctx, lin_index_stats_t *stats);
+
+static inline bool lin_index_record_failed(const lin_index_t *idx, const uint32_t record) {
+	return (idx->fail_bitmap[record >> 3] >> (record & 7)) & 1;
+}
+
+#endif // LIN_INDEX_H_
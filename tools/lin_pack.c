@@ -0,0 +1,317 @@
+/*******************************************************************************
+ *
+ * lin_pack.c - Compressed LIN capture container
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lin_checksum.h"
+#include "lincap.h"
+#include "lin_pack.h"
+
+// Each frame is encoded as a control byte, followed by only those fields that
+// could not be predicted from the state kept for its frame ID:
+//
+//   [pid] [timing] [payload] [checksum]
+//
+// Time is predicted as the previous frame's time plus the gap that preceded
+// this frame ID last time, and response delay as that of this frame ID last
+// time. Small errors in both (typically scheduling jitter) are packed together
+// into a single byte of two signed nibbles; otherwise, each is given as a
+// zig-zag varint, followed by the flags if they have changed.
+//
+// The payload is either the same as the last for the frame ID, a previous
+// payload from the frame ID's dictionary, a delta from the last payload (a
+// bitmask of changed bytes followed by their new values), or a literal.
+#define CTRL_MODE_MASK 0x03
+#define CTRL_MODE_SAME 0x00
+#define CTRL_MODE_DICT 0x01
+#define CTRL_MODE_DELTA 0x02
+#define CTRL_MODE_LITERAL 0x03
+#define CTRL_DICT_SHIFT 2
+#define CTRL_DICT_MASK 0x0C
+#define CTRL_CKSUM_OK 0x10 // Checksum is that calculated from the frame
+#define CTRL_PID_OK 0x20 // PID is that which followed the previous PID last time
+#define CTRL_TIMING_MASK 0xC0
+#define CTRL_TIMING_EXACT 0x00 // Time and response delay as predicted
+#define CTRL_TIMING_NIBBLES 0x40 // Small errors packed into one byte
+#define CTRL_TIMING_FULL 0x80 // Errors as varints, flags unchanged
+#define CTRL_TIMING_FULL_FLAGS 0xC0 // Errors as varints, then flags
+
+/******************************************************************************/
+
+static inline uint8_t *put_varint(uint8_t *ptr, uint64_t val) {
+	while(val >= 0x80) {
+		*ptr++ = (uint8_t)(val | 0x80);
+		val >>= 7;
+	}
+	*ptr++ = (uint8_t)val;
+	return ptr;
+}
+
+static inline const uint8_t *get_varint(const uint8_t *ptr, const uint8_t *end, uint64_t *val) {
+	uint64_t result = 0;
+	unsigned int shift = 0;
+
+	while(ptr < end && shift < 64) {
+		result |= (uint64_t)(*ptr & 0x7F) << shift;
+		if(!(*ptr++ & 0x80)) {
+			*val = result;
+			return ptr;
+		}
+		shift += 7;
+	}
+
+	return NULL;
+}
+
+static inline uint64_t zigzag_encode(const int64_t val) {
+	return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+static inline int64_t zigzag_decode(const uint64_t val) {
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static inline bool payload_equal(const lin_pack_payload_t *a, const lin_pack_payload_t *b) {
+	return (a->len == b->len && memcmp(a->data, b->data, a->len) == 0);
+}
+
+static inline uint8_t expected_cksum(const lincap_frame_t *frame) {
+	if(frame->flags & LINCAP_FLAG_NO_RESPONSE) return 0;
+	if(frame->flags & LINCAP_FLAG_CLASSIC) return lin_calculate_checksum_classic(frame->data, frame->data_len);
+	return lin_calculate_checksum_enhanced(frame->pid, frame->data, frame->data_len);
+}
+
+static inline void payload_push(lin_pack_fid_state_t *fs, const lin_pack_payload_t *payload) {
+	fs->dict[fs->dict_next] = fs->last;
+	fs->dict_next = (fs->dict_next + 1) % LIN_PACK_DICT_SIZE;
+	fs->last = *payload;
+}
+
+void lin_pack_init(lin_pack_state_t *st) {
+	memset(st, 0, sizeof(*st));
+}
+
+void lin_pack_encode_header(uint8_t *buf, const uint32_t baud, const uint32_t record_count) {
+	memcpy(buf, LIN_PACK_MAGIC, 4);
+	lincap_put_u16(buf + 4, LIN_PACK_VERSION);
+	lincap_put_u16(buf + 6, 0);
+	lincap_put_u32(buf + 8, baud);
+	lincap_put_u32(buf + 12, record_count);
+}
+
+bool lin_pack_decode_header(const uint8_t *buf, uint32_t *baud, uint32_t *record_count) {
+	if(memcmp(buf, LIN_PACK_MAGIC, 4) != 0) return false;
+	if(lincap_get_u16(buf + 4) != LIN_PACK_VERSION) return false;
+	*baud = lincap_get_u32(buf + 8);
+	*record_count = lincap_get_u32(buf + 12);
+	return true;
+}
+
+size_t lin_pack_encode(lin_pack_state_t *st, const lincap_frame_t *frame, uint8_t *out) {
+	lin_pack_fid_state_t *fs = &st->fid[frame->pid & 0x3F];
+	lin_pack_fid_state_t *prev = &st->fid[st->prev_pid & 0x3F];
+	lin_pack_payload_t payload;
+	uint8_t *ptr = out + 1;
+	uint8_t ctrl = 0, mask = 0, changed = 0;
+	int64_t time_err;
+	int32_t resp_err;
+
+	if(prev->next_pid == frame->pid) {
+		ctrl |= CTRL_PID_OK;
+	} else {
+		*ptr++ = frame->pid;
+	}
+	prev->next_pid = frame->pid;
+	st->prev_pid = frame->pid;
+
+	time_err = (int64_t)(frame->time_us - (st->prev_time + fs->last_gap));
+	resp_err = (int32_t)frame->resp_delay_us - fs->last_resp_delay;
+	fs->last_gap = frame->time_us - st->prev_time;
+	st->prev_time = frame->time_us;
+	fs->last_resp_delay = frame->resp_delay_us;
+
+	if(frame->flags != fs->last_flags) {
+		ctrl |= CTRL_TIMING_FULL_FLAGS;
+		ptr = put_varint(ptr, zigzag_encode(time_err));
+		ptr = put_varint(ptr, zigzag_encode(resp_err));
+		*ptr++ = frame->flags;
+		fs->last_flags = frame->flags;
+	} else if(time_err == 0 && resp_err == 0) {
+		ctrl |= CTRL_TIMING_EXACT;
+	} else if(time_err >= -8 && time_err <= 7 && resp_err >= -8 && resp_err <= 7) {
+		ctrl |= CTRL_TIMING_NIBBLES;
+		*ptr++ = (uint8_t)(((time_err & 0xF) << 4) | (resp_err & 0xF));
+	} else {
+		ctrl |= CTRL_TIMING_FULL;
+		ptr = put_varint(ptr, zigzag_encode(time_err));
+		ptr = put_varint(ptr, zigzag_encode(resp_err));
+	}
+
+	memset(&payload, 0, sizeof(payload));
+	payload.len = frame->data_len;
+	memcpy(payload.data, frame->data, frame->data_len);
+
+	if(payload_equal(&payload, &fs->last)) {
+		ctrl |= CTRL_MODE_SAME;
+	} else {
+		uint8_t i;
+
+		for(i = 0; i < LIN_PACK_DICT_SIZE; i++) {
+			if(payload_equal(&payload, &fs->dict[i])) break;
+		}
+
+		if(i < LIN_PACK_DICT_SIZE) {
+			ctrl |= CTRL_MODE_DICT | (uint8_t)(i << CTRL_DICT_SHIFT);
+		} else {
+			if(payload.len == fs->last.len) {
+				for(i = 0; i < payload.len; i++) {
+					if(payload.data[i] != fs->last.data[i]) {
+						mask |= (uint8_t)(1 << i);
+						changed++;
+					}
+				}
+			}
+
+			if(mask != 0 && changed < payload.len) {
+				ctrl |= CTRL_MODE_DELTA;
+				*ptr++ = mask;
+				for(i = 0; i < payload.len; i++) {
+					if(mask & (1 << i)) *ptr++ = payload.data[i];
+				}
+			} else {
+				ctrl |= CTRL_MODE_LITERAL;
+				*ptr++ = payload.len;
+				memcpy(ptr, payload.data, payload.len);
+				ptr += payload.len;
+			}
+		}
+
+		payload_push(fs, &payload);
+	}
+
+	if(frame->cksum == expected_cksum(frame)) {
+		ctrl |= CTRL_CKSUM_OK;
+	} else {
+		*ptr++ = frame->cksum;
+	}
+
+	out[0] = ctrl;
+
+	return (size_t)(ptr - out);
+}
+
+size_t lin_pack_decode(lin_pack_state_t *st, const uint8_t *in, const size_t len, lincap_frame_t *frame) {
+	const uint8_t *ptr = in, *end = in + len;
+	lin_pack_fid_state_t *fs, *prev;
+	lin_pack_payload_t payload;
+	uint64_t val;
+	uint8_t ctrl;
+
+	if(ptr >= end) return 0;
+	ctrl = *ptr++;
+
+	prev = &st->fid[st->prev_pid & 0x3F];
+	if(ctrl & CTRL_PID_OK) {
+		frame->pid = prev->next_pid;
+	} else {
+		if(ptr >= end) return 0;
+		frame->pid = *ptr++;
+	}
+	prev->next_pid = frame->pid;
+	st->prev_pid = frame->pid;
+	fs = &st->fid[frame->pid & 0x3F];
+
+	frame->time_us = st->prev_time + fs->last_gap;
+	frame->resp_delay_us = fs->last_resp_delay;
+
+	switch(ctrl & CTRL_TIMING_MASK) {
+		case CTRL_TIMING_EXACT:
+			break;
+		case CTRL_TIMING_NIBBLES:
+			if(ptr >= end) return 0;
+			frame->time_us += (uint64_t)(int64_t)(((int8_t)(*ptr & 0xF0)) >> 4);
+			frame->resp_delay_us = (uint16_t)(frame->resp_delay_us + (((int8_t)(*ptr << 4)) >> 4));
+			ptr++;
+			break;
+		case CTRL_TIMING_FULL:
+		case CTRL_TIMING_FULL_FLAGS:
+			if((ptr = get_varint(ptr, end, &val)) == NULL) return 0;
+			frame->time_us += (uint64_t)zigzag_decode(val);
+			if((ptr = get_varint(ptr, end, &val)) == NULL) return 0;
+			frame->resp_delay_us = (uint16_t)(frame->resp_delay_us + zigzag_decode(val));
+			if((ctrl & CTRL_TIMING_MASK) == CTRL_TIMING_FULL_FLAGS) {
+				if(ptr >= end) return 0;
+				fs->last_flags = *ptr++;
+			}
+			break;
+	}
+	fs->last_gap = frame->time_us - st->prev_time;
+	st->prev_time = frame->time_us;
+	fs->last_resp_delay = frame->resp_delay_us;
+	frame->flags = fs->last_flags;
+
+	switch(ctrl & CTRL_MODE_MASK) {
+		case CTRL_MODE_SAME:
+			payload = fs->last;
+			break;
+		case CTRL_MODE_DICT:
+			payload = fs->dict[(ctrl & CTRL_DICT_MASK) >> CTRL_DICT_SHIFT];
+			payload_push(fs, &payload);
+			break;
+		case CTRL_MODE_DELTA:
+			if(ptr >= end) return 0;
+			payload = fs->last;
+			for(uint8_t i = 0, mask = *ptr++; i < payload.len; i++) {
+				if(mask & (1 << i)) {
+					if(ptr >= end) return 0;
+					payload.data[i] = *ptr++;
+				}
+			}
+			payload_push(fs, &payload);
+			break;
+		case CTRL_MODE_LITERAL:
+			if(ptr >= end || *ptr > LINCAP_DATA_MAX || (size_t)(end - ptr) < 1u + *ptr) return 0;
+			memset(&payload, 0, sizeof(payload));
+			payload.len = *ptr++;
+			memcpy(payload.data, ptr, payload.len);
+			ptr += payload.len;
+			payload_push(fs, &payload);
+			break;
+	}
+	frame->data_len = payload.len;
+	memcpy(frame->data, payload.data, LINCAP_DATA_MAX);
+
+	if(ctrl & CTRL_CKSUM_OK) {
+		frame->cksum = expected_cksum(frame);
+	} else {
+		if(ptr >= end) return 0;
+		frame->cksum = *ptr++;
+	}
+
+	return (size_t)(ptr - in);
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *
+ * lin_pack.h - Compressed LIN capture container header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_PACK_H_
+#define LIN_PACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lincap.h"
+
+#define LIN_PACK_MAGIC "LPAK"
+#define LIN_PACK_VERSION 1
+#define LIN_PACK_HEADER_SIZE 16
+
+// Number of previous distinct payloads remembered per frame ID.
+#define LIN_PACK_DICT_SIZE 4
+
+// Largest possible encoding of a single frame: control, PID, two 64-bit
+// varints, flags, literal length, data and checksum.
+#define LIN_PACK_TOKEN_MAX (1 + 1 + 10 + 10 + 1 + 1 + LINCAP_DATA_MAX + 1)
+
+typedef struct {
+	uint8_t len;
+	uint8_t data[LINCAP_DATA_MAX];
+} lin_pack_payload_t;
+
+typedef struct {
+	uint64_t last_gap; // Time since previous frame, of any ID
+	uint16_t last_resp_delay;
+	uint8_t last_flags;
+	uint8_t next_pid; // PID that followed this one last time
+	uint8_t dict_next;
+	lin_pack_payload_t last;
+	lin_pack_payload_t dict[LIN_PACK_DICT_SIZE];
+} lin_pack_fid_state_t;
+
+// Encoder and decoder share this state, which must evolve identically on both
+// sides.
+typedef struct {
+	uint64_t prev_time;
+	uint8_t prev_pid;
+	lin_pack_fid_state_t fid[LINCAP_FID_COUNT];
+} lin_pack_state_t;
+
+/******************************************************************************/
+
+extern void lin_pack_init(lin_pack_state_t *st);
+extern size_t lin_pack_encode(lin_pack_state_t *st, const lincap_frame_t *frame, uint8_t *out);
+extern size_t lin_pack_decode(lin_pack_state_t *st, const uint8_t *in, const size_t len, lincap_frame_t *frame);
+
+extern void lin_pack_encode_header(uint8_t *buf, const uint32_t baud, const uint32_t record_count);
+extern bool lin_pack_decode_header(const uint8_t *buf, uint32_t *baud, uint32_t *record_count);
+
+#endif // LIN_PACK_H_
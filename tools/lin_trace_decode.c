@@ -0,0 +1,193 @@
+/*******************************************************************************
+ *
+ * lin_trace_decode.c - LIN event trace decoding
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "lin_bus.h"
+#include "lin_master.h"
+#include "lin_gateway.h"
+#include "lin_trace.h"
+#include "lin_trace_decode.h"
+
+static const char *event_names[] = {
+	[LIN_TRACE_BREAK] = "BREAK",
+	[LIN_TRACE_HEADER] = "HEADER",
+	[LIN_TRACE_RESPONSE] = "RESPONSE",
+	[LIN_TRACE_SLOT] = "SLOT",
+	[LIN_TRACE_VERIFY_OK] = "VERIFY_OK",
+	[LIN_TRACE_VERIFY_ERROR] = "VERIFY_ERROR",
+	[LIN_TRACE_FORWARD] = "FORWARD",
+};
+
+static const char *bus_event_names[] = {
+	[LIN_BUS_EVT_NONE] = "none",
+	[LIN_BUS_EVT_HEADER] = "header",
+	[LIN_BUS_EVT_RX_OK] = "rx ok",
+	[LIN_BUS_EVT_RX_ERROR] = "rx error",
+	[LIN_BUS_EVT_TX_OK] = "tx ok",
+	[LIN_BUS_EVT_TX_ERROR] = "tx error",
+	[LIN_BUS_EVT_TIMEOUT] = "timeout",
+	[LIN_BUS_EVT_SYNC_ERROR] = "sync error",
+	[LIN_BUS_EVT_PID_ERROR] = "pid error",
+};
+
+static const char *master_result_names[] = {
+	[LIN_MASTER_RESP_OK] = "ok",
+	[LIN_MASTER_RESP_NONE] = "none",
+	[LIN_MASTER_RESP_ERROR] = "error",
+	[LIN_MASTER_RESP_COLLISION] = "collision",
+};
+
+#define NAME_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/******************************************************************************/
+
+static bool read_bytes(FILE *in, uint8_t *buf, const size_t len) {
+	return (fread(buf, 1, len, in) == len);
+}
+
+static bool find_dump(FILE *in) {
+	// Dumps may be mixed in with anything else the program wrote to the same
+	// file, so each is found by its magic string.
+	static const char magic[4] = { 'L', 'T', 'R', 'C' };
+	size_t matched = 0;
+	int c;
+
+	while(matched < sizeof(magic) && (c = getc(in)) != EOF) {
+		if(c == magic[matched]) {
+			matched++;
+		} else {
+			matched = (c == magic[0] ? 1 : 0);
+		}
+	}
+
+	return (matched == sizeof(magic));
+}
+
+void lin_trace_decode_init(lin_trace_decoder_t *dec, FILE *in) {
+	dec->in = in;
+	dec->dumps = 0;
+	dec->records = 0;
+	dec->lost_total = 0;
+	dec->remaining = 0;
+	dec->first = true;
+	dec->prev_ticks = 0;
+	dec->time = 0;
+}
+
+bool lin_trace_decode_dump(lin_trace_decoder_t *dec, uint16_t *lost, uint8_t *count) {
+	// Finds the next dump, skipping anything left of the current one, and
+	// returns its lost and record counts. Returns false when there are no more.
+	uint8_t header[LIN_TRACE_DUMP_HEADER_SIZE - 4];
+
+	if(!find_dump(dec->in) || !read_bytes(dec->in, header, sizeof(header))) return false;
+
+	*lost = header[0] | ((uint16_t)header[1] << 8);
+	*count = header[2];
+	dec->dumps++;
+	dec->lost_total += *lost;
+	dec->remaining = *count;
+
+	return true;
+}
+
+bool lin_trace_decode_event(lin_trace_decoder_t *dec, lin_trace_event_t *event) {
+	// The timer is only 16 bits, so the time of each record is accumulated
+	// from the difference to the one before, starting from zero at the first
+	// record of the first dump. Any interval of 65536 ticks or more (which
+	// includes where records were lost) is therefore short by a multiple of
+	// that. Returns false at the end of the dump, or if it is truncated.
+	uint8_t rec[LIN_TRACE_DUMP_RECORD_SIZE];
+
+	if(dec->remaining == 0) return false;
+	if(!read_bytes(dec->in, rec, sizeof(rec))) {
+		dec->remaining = 0;
+		return false;
+	}
+	dec->remaining--;
+
+	event->ticks = rec[0] | ((uint16_t)rec[1] << 8);
+	event->delta = (dec->first ? 0 : (uint16_t)(event->ticks - dec->prev_ticks));
+	dec->time += event->delta;
+	event->time = dec->time;
+	event->type = rec[2];
+	event->pid = rec[3];
+	event->status = rec[4];
+	dec->prev_ticks = event->ticks;
+	dec->first = false;
+	dec->records++;
+
+	return true;
+}
+
+void lin_trace_format_type(char *buf, const size_t size, const uint8_t type) {
+	if(type >= LIN_TRACE_USER) {
+		snprintf(buf, size, "USER+%u", type - LIN_TRACE_USER);
+	} else if(type < NAME_COUNT(event_names) && event_names[type] != NULL) {
+		snprintf(buf, size, "%s", event_names[type]);
+	} else {
+		snprintf(buf, size, "0x%02X", type);
+	}
+}
+
+void lin_trace_format_status(char *buf, const size_t size, const uint8_t type, const uint8_t status) {
+	// The meaning of the status depends on the type of event. Any value not
+	// known for the type is given as a number.
+	const char *name = NULL;
+
+	switch(type) {
+		case LIN_TRACE_BREAK:
+		case LIN_TRACE_HEADER:
+		case LIN_TRACE_RESPONSE:
+			if(status < NAME_COUNT(bus_event_names)) name = bus_event_names[status];
+			break;
+		case LIN_TRACE_SLOT:
+			if(status < NAME_COUNT(master_result_names)) name = master_result_names[status];
+			break;
+		case LIN_TRACE_VERIFY_OK:
+			snprintf(buf, size, "changed 0x%02X", status);
+			return;
+		case LIN_TRACE_VERIFY_ERROR:
+			name = "checksum";
+			break;
+		case LIN_TRACE_FORWARD:
+			if(status == LIN_GATEWAY_DROP) {
+				name = "drop";
+			} else {
+				snprintf(buf, size, "bus %u", status);
+				return;
+			}
+			break;
+	}
+
+	if(name != NULL) {
+		snprintf(buf, size, "%s", name);
+	} else {
+		snprintf(buf, size, "0x%02X", status);
+	}
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ *
+ * lin_trace_decode.h - LIN event trace decoding header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LIN_TRACE_DECODE_H_
+#define LIN_TRACE_DECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct {
+	FILE *in;
+	uint32_t dumps;
+	uint32_t records;
+	uint32_t lost_total;
+	uint8_t remaining; // Records left in the current dump
+	bool first;
+	uint16_t prev_ticks;
+	uint64_t time;
+} lin_trace_decoder_t;
+
+typedef struct {
+	uint16_t ticks; // Timestamp as recorded
+	uint16_t delta; // Ticks since the previous record (zero for the first)
+	uint64_t time; // Ticks since the first record of the first dump
+	uint8_t type;
+	uint8_t pid;
+	uint8_t status;
+} lin_trace_event_t;
+
+/******************************************************************************/
+
+extern void lin_trace_decode_init(lin_trace_decoder_t *dec, FILE *in);
+extern bool lin_trace_decode_dump(lin_trace_decoder_t *dec, uint16_t *lost, uint8_t *count);
+extern bool lin_trace_decode_event(lin_trace_decoder_t *dec, lin_trace_event_t *event);
+extern void lin_trace_format_type(char *buf, const size_t size, const uint8_t type);
+extern void lin_trace_format_status(char *buf, const size_t size, const uint8_t type, const uint8_t status);
+
+#endif // LIN_TRACE_DECODE_H_
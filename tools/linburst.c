@@ -0,0 +1,125 @@
+/*******************************************************************************
+ *
+ * linburst.c - LIN capture checksum error burst detection tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lin_checksum.h"
+#include "lin_burst.h"
+#include "lincap.h"
+
+static const char usage_str[] =
+	"Usage: linburst [-r <raise>] [-c <clear>] [-n <fid>:<node>]... <capture>\n"
+	"\n"
+	"  -r  Failures in window at which a burst is raised (default 4)\n"
+	"  -c  Failures in window at which a burst is cleared (default 1)\n"
+	"  -n  Assign frame ID to node (0-7), for per-node detection\n"
+	"\n"
+	"A capture of \"-\" reads from standard input.\n";
+
+/******************************************************************************/
+
+static void print_event(const uint64_t time, const char *kind, const unsigned int id, const bool raise, const lin_burst_window_t *w) {
+	printf("%llu %s %s 0x%02X rate = %.1f%% (%u/%u)\n", (unsigned long long)time, (raise ? "RAISE" : "CLEAR"), kind, id,
+		100.0 * w->fail_count / LIN_BURST_WINDOW, w->fail_count, LIN_BURST_WINDOW);
+}
+
+int main(int argc, char *argv[]) {
+	static lin_burst_t bd;
+	static uint8_t node_map[LINCAP_FID_COUNT];
+	lin_burst_config_t config = { NULL, 4, 1 };
+	lincap_reader_t cap;
+	lincap_frame_t frame;
+	unsigned long fid, node, val;
+	uint32_t raised = 0;
+	uint8_t events, status;
+	char *end;
+	int opt;
+
+	memset(node_map, LIN_BURST_NO_NODE, sizeof(node_map));
+
+	while((opt = getopt(argc, argv, "r:c:n:")) != -1) {
+		switch(opt) {
+			case 'r':
+			case 'c':
+				val = strtoul(optarg, &end, 0);
+				if(*end != '\0' || val > LIN_BURST_WINDOW) {
+					fputs(usage_str, stderr);
+					return EXIT_FAILURE;
+				}
+				*(opt == 'r' ? &config.raise_threshold : &config.clear_threshold) = (uint8_t)val;
+				break;
+			case 'n':
+				fid = strtoul(optarg, &end, 0);
+				if(*end != ':' || fid >= LINCAP_FID_COUNT || (node = strtoul(end + 1, &end, 0)) >= LIN_BURST_NODES || *end != '\0') {
+					fputs(usage_str, stderr);
+					return EXIT_FAILURE;
+				}
+				node_map[fid] = (uint8_t)node;
+				config.node_map = node_map;
+				break;
+			default:
+				fputs(usage_str, stderr);
+				return EXIT_FAILURE;
+		}
+	}
+	if(optind != argc - 1 || config.clear_threshold >= config.raise_threshold) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	if(!lincap_open(&cap, argv[optind])) return EXIT_FAILURE;
+
+	lin_burst_init(&bd, &config);
+
+	while(lincap_read(&cap, &frame)) {
+		// Frames with no response carry no checksum to judge, and frames whose
+		// PID parity fails cannot be trusted to be attributed to the right ID.
+		status = lincap_frame_verify(&frame);
+		if((frame.flags & LINCAP_FLAG_NO_RESPONSE) || (status & LINCAP_STATUS_PARITY_ERR)) continue;
+
+		fid = frame.pid & 0x3F;
+		events = lin_burst_update(&bd, (uint8_t)fid, status == LINCAP_STATUS_OK);
+
+		if(events & (LIN_BURST_EVT_FID_RAISE | LIN_BURST_EVT_FID_CLEAR)) {
+			print_event(frame.time_us, "fid", (unsigned int)fid, (events & LIN_BURST_EVT_FID_RAISE), &bd.fid[fid]);
+		}
+		if(events & (LIN_BURST_EVT_NODE_RAISE | LIN_BURST_EVT_NODE_CLEAR)) {
+			print_event(frame.time_us, "node", node_map[fid], (events & LIN_BURST_EVT_NODE_RAISE), &bd.node[node_map[fid]]);
+		}
+		if(events & (LIN_BURST_EVT_FID_RAISE | LIN_BURST_EVT_NODE_RAISE)) raised++;
+	}
+
+	fprintf(stderr, "%u bursts raised\n", raised);
+
+	lincap_close(&cap);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+/*******************************************************************************
+ *
+ * lincap.c - LIN bus capture file format
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lin_checksum.h"
+#include "lincap.h"
+
+// Size of the stdio buffer given to capture files. Large sequential reads and
+// writes are far cheaper than many small ones.
+#define LINCAP_IO_BUF_SIZE (1024 * 1024)
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/******************************************************************************/
+
+void lincap_put_u16(uint8_t *buf, const uint16_t val) {
+	buf[0] = (uint8_t)val;
+	buf[1] = (uint8_t)(val >> 8);
+}
+
+void lincap_put_u32(uint8_t *buf, const uint32_t val) {
+	lincap_put_u16(buf, (uint16_t)val);
+	lincap_put_u16(buf + 2, (uint16_t)(val >> 16));
+}
+
+void lincap_put_u64(uint8_t *buf, const uint64_t val) {
+	lincap_put_u32(buf, (uint32_t)val);
+	lincap_put_u32(buf + 4, (uint32_t)(val >> 32));
+}
+
+uint16_t lincap_get_u16(const uint8_t *buf) {
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+uint32_t lincap_get_u32(const uint8_t *buf) {
+	return lincap_get_u16(buf) | ((uint32_t)lincap_get_u16(buf + 2) << 16);
+}
+
+uint64_t lincap_get_u64(const uint8_t *buf) {
+	return lincap_get_u32(buf) | ((uint64_t)lincap_get_u32(buf + 4) << 32);
+}
+
+void lincap_encode_header(uint8_t *buf, const uint32_t baud) {
+	memcpy(buf, LINCAP_MAGIC, 4);
+	lincap_put_u16(buf + 4, LINCAP_VERSION);
+	lincap_put_u16(buf + 6, LINCAP_RECORD_SIZE);
+	lincap_put_u32(buf + 8, baud);
+	lincap_put_u32(buf + 12, 0);
+}
+
+bool lincap_decode_header(const uint8_t *buf, uint32_t *baud) {
+	if(memcmp(buf, LINCAP_MAGIC, 4) != 0) return false;
+	if(lincap_get_u16(buf + 4) != LINCAP_VERSION) return false;
+	if(lincap_get_u16(buf + 6) != LINCAP_RECORD_SIZE) return false;
+	*baud = lincap_get_u32(buf + 8);
+	return true;
+}
+
+void lincap_encode_frame(uint8_t *buf, const lincap_frame_t *frame) {
+	lincap_put_u64(buf, frame->time_us);
+	lincap_put_u16(buf + 8, frame->resp_delay_us);
+	buf[10] = frame->pid;
+	buf[11] = frame->data_len;
+	memcpy(buf + 12, frame->data, LINCAP_DATA_MAX);
+	buf[20] = frame->cksum;
+	buf[21] = frame->flags;
+	lincap_put_u16(buf + 22, 0);
+}
+
+void lincap_decode_frame(const uint8_t *buf, lincap_frame_t *frame) {
+	frame->time_us = lincap_get_u64(buf);
+	frame->resp_delay_us = lincap_get_u16(buf + 8);
+	frame->pid = buf[10];
+	frame->data_len = (buf[11] <= LINCAP_DATA_MAX ? buf[11] : LINCAP_DATA_MAX);
+	memcpy(frame->data, buf + 12, LINCAP_DATA_MAX);
+	frame->cksum = buf[20];
+	frame->flags = buf[21];
+}
+
+bool lincap_open(lincap_reader_t *rd, const char *path) {
+	// A path of "-" reads from standard input. The number of records is then
+	// unknown, and seeking is not possible.
+	const bool is_stdin = (strcmp(path, "-") == 0);
+	uint8_t hdr[LINCAP_HEADER_SIZE];
+	long size;
+
+	memset(rd, 0, sizeof(*rd));
+
+	rd->file = (is_stdin ? stdin : fopen(path, "rb"));
+	if(rd->file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	// Standard input outlives the reader, so must not be given a buffer that
+	// will be freed.
+	rd->buf = (is_stdin ? NULL : malloc(LINCAP_IO_BUF_SIZE));
+	setvbuf(rd->file, rd->buf, _IOFBF, LINCAP_IO_BUF_SIZE);
+
+	if(fread(hdr, sizeof(hdr), 1, rd->file) != 1 || !lincap_decode_header(hdr, &rd->baud)) {
+		fprintf(stderr, "%s: not a LIN capture file\n", path);
+		lincap_close(rd);
+		return false;
+	}
+
+	if(is_stdin) {
+		rd->record_count = UINT32_MAX;
+		return true;
+	}
+
+	if(fseek(rd->file, 0, SEEK_END) != 0 || (size = ftell(rd->file)) < 0) {
+		perror(path);
+		lincap_close(rd);
+		return false;
+	}
+	rd->record_count = (uint32_t)((size - LINCAP_HEADER_SIZE) / LINCAP_RECORD_SIZE);
+	rd->position = UINT32_MAX;
+
+	return lincap_seek(rd, 0);
+}
+
+bool lincap_read(lincap_reader_t *rd, lincap_frame_t *frame) {
+	uint8_t rec[LINCAP_RECORD_SIZE];
+
+	if(rd->position >= rd->record_count) return false;
+	if(fread(rec, sizeof(rec), 1, rd->file) != 1) return false;
+	rd->position++;
+	lincap_decode_frame(rec, frame);
+
+	return true;
+}
+
+bool lincap_seek(lincap_reader_t *rd, const uint32_t record) {
+	// Avoid seeking when already in position, as that discards the stdio buffer.
+	if(record == rd->position) return true;
+	if(fseek(rd->file, LINCAP_HEADER_SIZE + (long)record * LINCAP_RECORD_SIZE, SEEK_SET) != 0) return false;
+	rd->position = record;
+	return true;
+}
+
+void lincap_close(lincap_reader_t *rd) {
+	if(rd->file != NULL && rd->file != stdin) fclose(rd->file);
+	free(rd->buf);
+	memset(rd, 0, sizeof(*rd));
+}
+
+bool lincap_create(lincap_writer_t *wr, const char *path, const uint32_t baud) {
+	uint8_t hdr[LINCAP_HEADER_SIZE];
+
+	memset(wr, 0, sizeof(*wr));
+
+	wr->file = (path != NULL ? fopen(path, "wb") : stdout);
+	if(wr->file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	wr->buf = (wr->file != stdout ? malloc(LINCAP_IO_BUF_SIZE) : NULL);
+	setvbuf(wr->file, wr->buf, _IOFBF, LINCAP_IO_BUF_SIZE);
+
+	lincap_encode_header(hdr, baud);
+	if(fwrite(hdr, sizeof(hdr), 1, wr->file) != 1) {
+		perror(path);
+		lincap_finish(wr);
+		return false;
+	}
+
+	return true;
+}
+
+bool lincap_write(lincap_writer_t *wr, const lincap_frame_t *frame) {
+	uint8_t rec[LINCAP_RECORD_SIZE];
+
+	lincap_encode_frame(rec, frame);
+	if(fwrite(rec, sizeof(rec), 1, wr->file) != 1) return false;
+	wr->record_count++;
+
+	return true;
+}
+
+bool lincap_finish(lincap_writer_t *wr) {
+	bool ok = (fflush(wr->file) == 0);
+
+	if(wr->file != stdout) ok = (fclose(wr->file) == 0) && ok;
+	free(wr->buf);
+	memset(wr, 0, sizeof(*wr));
+
+	return ok;
+}
+
+uint8_t lincap_frame_verify(const lincap_frame_t *frame) {
+	uint8_t status = LINCAP_STATUS_OK;
+	uint8_t fid;
+	bool ok;
+
+	if(!lin_verify_protected_id(frame->pid, &fid)) status |= LINCAP_STATUS_PARITY_ERR;
+
+	if(!(frame->flags & LINCAP_FLAG_NO_RESPONSE)) {
+		if(frame->flags & LINCAP_FLAG_CLASSIC) {
+			ok = lin_verify_checksum_classic(frame->cksum, frame->data, frame->data_len);
+		} else {
+			ok = lin_verify_checksum_enhanced(frame->cksum, frame->pid, frame->data, frame->data_len);
+		}
+		if(!ok) status |= LINCAP_STATUS_CHECKSUM_ERR;
+	}
+
+	return status;
+}
+
+static char *lincap_format_hex(char *buf, const uint8_t val) {
+	*buf++ = hex_digits[val >> 4];
+	*buf++ = hex_digits[val & 0xF];
+	return buf;
+}
+
+static char *lincap_format_dec(char *buf, uint64_t val) {
+	char tmp[20];
+	size_t len = 0;
+
+	do {
+		tmp[len++] = (char)('0' + (val % 10));
+		val /= 10;
+	} while(val > 0);
+	while(len > 0) *buf++ = tmp[--len];
+
+	return buf;
+}
+
+size_t lincap_format_frame(char *buf, const lincap_frame_t *frame, const uint8_t status) {
+	// Hand-rolled rather than using printf() because this sits on the hot path
+	// of the streaming tools. Output format is:
+	// <time_us> <pid> <len> [<data>...] <cksum> <status>
+	char *ptr = buf;
+	const char *status_str;
+
+	ptr = lincap_format_dec(ptr, frame->time_us);
+	*ptr++ = ' ';
+	ptr = lincap_format_hex(ptr, frame->pid);
+	*ptr++ = ' ';
+	*ptr++ = (char)('0' + frame->data_len);
+	for(uint8_t i = 0; i < frame->data_len; i++) {
+		*ptr++ = ' ';
+		ptr = lincap_format_hex(ptr, frame->data[i]);
+	}
+	*ptr++ = ' ';
+	if(frame->flags & LINCAP_FLAG_NO_RESPONSE) {
+		*ptr++ = '-';
+		*ptr++ = '-';
+	} else {
+		ptr = lincap_format_hex(ptr, frame->cksum);
+	}
+	*ptr++ = ' ';
+
+	switch(status & (LINCAP_STATUS_PARITY_ERR | LINCAP_STATUS_CHECKSUM_ERR)) {
+		case LINCAP_STATUS_PARITY_ERR: status_str = "ERR_PARITY"; break;
+		case LINCAP_STATUS_CHECKSUM_ERR: status_str = "ERR_CHECKSUM"; break;
+		case LINCAP_STATUS_PARITY_ERR | LINCAP_STATUS_CHECKSUM_ERR: status_str = "ERR_PARITY_CHECKSUM"; break;
+		default: status_str = (frame->flags & LINCAP_FLAG_NO_RESPONSE ? "NO_RESPONSE" : "OK"); break;
+	}
+	while(*status_str != '\0') *ptr++ = *status_str++;
+	*ptr++ = '\n';
+	*ptr = '\0';
+
+	return (size_t)(ptr - buf);
+}
@@ -0,0 +1,110 @@
+/*******************************************************************************
+ *
+ * lincap.h - LIN bus capture file format header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef LINCAP_H_
+#define LINCAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// A capture file consists of a fixed-size header followed by any number of
+// fixed-size frame records, all little-endian. Records must be in ascending
+// time order. See README.md for a full description of the layout.
+#define LINCAP_MAGIC "LCAP"
+#define LINCAP_VERSION 1
+#define LINCAP_HEADER_SIZE 16
+#define LINCAP_RECORD_SIZE 24
+
+#define LINCAP_DATA_MAX 8
+#define LINCAP_FID_COUNT 64
+#define LINCAP_DEFAULT_BAUD 19200
+
+// Maximum length of a line produced by lincap_format_frame(), including the
+// newline and terminating null.
+#define LINCAP_FORMAT_MAX 96
+
+// Frame record flags.
+#define LINCAP_FLAG_CLASSIC 0x01 // Frame uses classic checksum
+#define LINCAP_FLAG_NO_RESPONSE 0x02 // Header only, no response was received
+
+// Verification status bits, as returned by lincap_frame_verify().
+#define LINCAP_STATUS_OK 0x00
+#define LINCAP_STATUS_PARITY_ERR 0x01
+#define LINCAP_STATUS_CHECKSUM_ERR 0x02
+
+typedef struct {
+	uint64_t time_us; // Start of frame header (break)
+	uint16_t resp_delay_us; // From end of header to start of response
+	uint8_t pid;
+	uint8_t data_len;
+	uint8_t data[LINCAP_DATA_MAX];
+	uint8_t cksum;
+	uint8_t flags;
+} lincap_frame_t;
+
+typedef struct {
+	FILE *file;
+	char *buf;
+	uint32_t baud;
+	uint32_t record_count;
+	uint32_t position;
+} lincap_reader_t;
+
+typedef struct {
+	FILE *file;
+	char *buf;
+	uint32_t record_count;
+} lincap_writer_t;
+
+/******************************************************************************/
+
+extern bool lincap_open(lincap_reader_t *rd, const char *path);
+extern bool lincap_read(lincap_reader_t *rd, lincap_frame_t *frame);
+extern bool lincap_seek(lincap_reader_t *rd, const uint32_t record);
+extern void lincap_close(lincap_reader_t *rd);
+
+extern bool lincap_create(lincap_writer_t *wr, const char *path, const uint32_t baud);
+extern bool lincap_write(lincap_writer_t *wr, const lincap_frame_t *frame);
+extern bool lincap_finish(lincap_writer_t *wr);
+
+extern void lincap_encode_header(uint8_t *buf, const uint32_t baud);
+extern bool lincap_decode_header(const uint8_t *buf, uint32_t *baud);
+extern void lincap_encode_frame(uint8_t *buf, const lincap_frame_t *frame);
+extern void lincap_decode_frame(const uint8_t *buf, lincap_frame_t *frame);
+
+extern uint8_t lincap_frame_verify(const lincap_frame_t *frame);
+extern size_t lincap_format_frame(char *buf, const lincap_frame_t *frame, const uint8_t status);
+
+extern void lincap_put_u16(uint8_t *buf, const uint16_t val);
+extern void lincap_put_u32(uint8_t *buf, const uint32_t val);
+extern void lincap_put_u64(uint8_t *buf, const uint64_t val);
+extern uint16_t lincap_get_u16(const uint8_t *buf);
+extern uint32_t lincap_get_u32(const uint8_t *buf);
+extern uint64_t lincap_get_u64(const uint8_t *buf);
+
+#endif // LINCAP_H_
@@ -0,0 +1,641 @@
+/*******************************************************************************
+ *
+ * linemu.c - Emulated verification of compiled LIN checksum library
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "stm8emu.h"
+
+// RAM locations of function arguments passed by reference.
+#define DATA_ADDR 0x0100
+#define FID_OUT_ADDR 0x00F0
+#define FAR_PTR_ADDR 0x00E0
+#define RESULTS_ADDR 0x00D0
+#define FRAMES_ADDR 0x0200
+#define FRAME_DATA_ADDR 0x0300
+#define STORED_ADDR 0x0400
+
+// Size of a lin_frame_t struct as compiled for the STM8, and the greatest
+// number of frames in a batch (as for a full schedule round).
+#define FRAME_SIZE 5
+#define MAX_BATCH_FRAMES 40
+
+// Flash location of data for far functions, straddling a 64K boundary and well
+// beyond the end of the test program's code.
+#define FAR_DATA_ADDR 0x1FFFC
+
+#define MAX_STEPS_PER_CALL 10000
+
+// Number of case indexes claimed by a thread at a time.
+#define CHUNK_SIZE 4096
+
+#define MAX_REPORTED_FAILURES 10
+
+typedef enum {
+	FN_CLASSIC,
+	FN_ENHANCED,
+	FN_VERIFY_CLASSIC,
+	FN_VERIFY_ENHANCED,
+	FN_GET_PID,
+	FN_VERIFY_PID,
+	FN_CLASSIC_FAR,
+	FN_ENHANCED_FAR,
+	FN_VERIFY_CLASSIC_FAR,
+	FN_VERIFY_ENHANCED_FAR,
+	FN_VERIFY_BATCH,
+	FN_VERIFY_COMPARE,
+	FN_VERIFY_READBACK,
+	FN_COUNT
+} fn_t;
+
+static const char *fn_names[FN_COUNT] = {
+	"lin_calculate_checksum_classic",
+	"lin_calculate_checksum_enhanced",
+	"lin_verify_checksum_classic",
+	"lin_verify_checksum_enhanced",
+	"lin_get_protected_id",
+	"lin_verify_protected_id",
+	"lin_calculate_checksum_classic_far",
+	"lin_calculate_checksum_enhanced_far",
+	"lin_verify_checksum_classic_far",
+	"lin_verify_checksum_enhanced_far",
+	"lin_verify_checksum_batch",
+	"lin_verify_checksum_compare",
+	"lin_verify_readback",
+};
+
+typedef enum {
+	SUITE_PID,
+	SUITE_CLASSIC,
+	SUITE_ENHANCED,
+	SUITE_ENHANCED_2,
+	SUITE_RANDOM,
+	SUITE_BATCH,
+	SUITE_COMPARE,
+	SUITE_READBACK,
+	SUITE_COUNT
+} suite_t;
+
+static const char *suite_names[SUITE_COUNT] = {
+	"protected IDs (all bytes)",
+	"classic (all payloads of 0-2 bytes)",
+	"enhanced (all PIDs, all payloads of 0-1 bytes)",
+	"enhanced (all PIDs, all payloads of 2 bytes)",
+	"random (3-8 bytes, classic and enhanced)",
+	"batches (1-40 frames of 0-8 bytes)",
+	"compare with stored copy (0-8 bytes)",
+	"transmit readback (0-8 bytes)",
+};
+
+typedef struct {
+	// Set up before threads are started, then read-only.
+	const stm8emu_t *image;
+	uint32_t fn_addr[FN_COUNT];
+	bool large;
+	uint64_t suite_cases[SUITE_COUNT];
+	uint64_t seed;
+
+	// Shared between threads, protected by mutex.
+	pthread_mutex_t lock;
+	suite_t next_suite;
+	uint64_t next_index;
+	uint64_t suite_failures[SUITE_COUNT];
+	uint64_t steps;
+	unsigned int reported;
+} harness_t;
+
+typedef struct {
+	uint8_t cksum;
+	uint8_t pid;
+	uint8_t len;
+	uint8_t data[8];
+	bool classic;
+} case_t;
+
+static const char usage_str[] =
+	"Usage: linemu [-m <model>] [-j <threads>] [-n <count>] [-s <seed>] [-x] <image.ihx> [<image.map>]\n"
+	"\n"
+	"  -m  Memory model the image was compiled for, 'medium' (default) or 'large'\n"
+	"  -j  Number of threads (default is number of processors)\n"
+	"  -n  Number of random 3-8 byte payloads (default 1000000)\n"
+	"  -s  Seed for random payloads (default 1)\n"
+	"  -x  Also test every 2-byte payload with every PID (16.7 million cases)\n"
+	"\n"
+	"The map file defaults to the image path with a .map extension.\n";
+
+/******************************************************************************/
+
+static uint8_t reference_checksum(const uint8_t init, const uint8_t *data, const uint8_t len) {
+	// Independent of the library: sum everything, then fold the carries in.
+	uint32_t sum = init;
+	for(uint8_t i = 0; i < len; i++) sum += data[i];
+	while(sum > 0xFF) sum = (sum & 0xFF) + (sum >> 8);
+	return (uint8_t)~sum;
+}
+
+static uint8_t reference_pid(const uint8_t fid) {
+	const uint8_t p0 = ((fid >> 0) ^ (fid >> 1) ^ (fid >> 2) ^ (fid >> 4)) & 1;
+	const uint8_t p1 = ~((fid >> 1) ^ (fid >> 3) ^ (fid >> 4) ^ (fid >> 5)) & 1;
+	return (uint8_t)((fid & 0x3F) | (p0 << 6) | (p1 << 7));
+}
+
+static uint64_t splitmix64(uint64_t x) {
+	// Random payloads are a pure function of case index, so results don't
+	// depend on how cases are divided between threads.
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/******************************************************************************/
+
+static const char *call(const harness_t *h, stm8emu_t *emu, const fn_t fn, const uint8_t a, const uint16_t x, const uint8_t *stack_args, const uint8_t stack_len, uint8_t *ret) {
+	// Returns NULL on success, otherwise a description of what went wrong.
+	const stm8emu_status_t status = stm8emu_call(emu, h->fn_addr[fn], h->large, a, x, stack_args, stack_len, MAX_STEPS_PER_CALL);
+	*ret = emu->a;
+	return (status == STM8EMU_OK ? NULL : stm8emu_status_str(status));
+}
+
+static bool check(harness_t *h, const fn_t fn, const case_t *tc, const char *err, const bool ok, const stm8emu_t *emu) {
+	// Reports the first few failures in detail. Returns whether passed.
+	if(err == NULL && ok) return true;
+
+	pthread_mutex_lock(&h->lock);
+	if(h->reported < MAX_REPORTED_FAILURES) {
+		h->reported++;
+		printf("FAIL: %s: pid = 0x%02X, len = %u, data =", fn_names[fn], tc->pid, tc->len);
+		for(uint8_t i = 0; i < tc->len; i++) printf(" %02X", tc->data[i]);
+		if(err != NULL) printf(" (%s; pc = 0x%06X, sp = 0x%04X)", err, emu->fault_pc, emu->sp);
+		putchar('\n');
+	}
+	pthread_mutex_unlock(&h->lock);
+
+	return false;
+}
+
+static bool run_checksum_fns(harness_t *h, stm8emu_t *emu, const case_t *tc, const fn_t first, const uint16_t data_arg) {
+	// Calls one set of checksum functions, near or far, starting at the given
+	// classic calculation function. Calculation must match the reference
+	// model, and verification must accept its result and reject another value.
+	const uint8_t expected = reference_checksum((tc->classic ? 0 : tc->pid), tc->data, tc->len);
+	const uint8_t wrong = expected + 1;
+	const fn_t classic = first, enhanced = first + (FN_ENHANCED - FN_CLASSIC);
+	const fn_t verify_classic = first + (FN_VERIFY_CLASSIC - FN_CLASSIC), verify_enhanced = first + (FN_VERIFY_ENHANCED - FN_CLASSIC);
+	uint8_t stack[4], ret;
+	const char *err;
+	bool pass = true;
+
+	if(tc->classic) {
+		// (data, len): X, A
+		err = call(h, emu, classic, tc->len, data_arg, NULL, 0, &ret);
+		pass &= check(h, classic, tc, err, ret == expected, emu);
+
+		// (cksum, data, len): A, X, stack
+		stack[0] = tc->len;
+		err = call(h, emu, verify_classic, expected, data_arg, stack, 1, &ret);
+		pass &= check(h, verify_classic, tc, err, ret == 1, emu);
+		err = call(h, emu, verify_classic, wrong, data_arg, stack, 1, &ret);
+		pass &= check(h, verify_classic, tc, err, ret == 0, emu);
+	} else {
+		// (pid, data, len): A, X, stack
+		stack[0] = tc->len;
+		err = call(h, emu, enhanced, tc->pid, data_arg, stack, 1, &ret);
+		pass &= check(h, enhanced, tc, err, ret == expected, emu);
+
+		// (cksum, pid, data, len): A, stack, stack, stack
+		stack[0] = tc->pid;
+		stack[1] = data_arg >> 8;
+		stack[2] = data_arg & 0xFF;
+		stack[3] = tc->len;
+		err = call(h, emu, verify_enhanced, expected, 0, stack, 4, &ret);
+		pass &= check(h, verify_enhanced, tc, err, ret == 1, emu);
+		err = call(h, emu, verify_enhanced, wrong, 0, stack, 4, &ret);
+		pass &= check(h, verify_enhanced, tc, err, ret == 0, emu);
+	}
+
+	return pass;
+}
+
+static bool run_checksum_case(harness_t *h, stm8emu_t *emu, const case_t *tc) {
+	// Far functions are given a pointer to a 32-bit big-endian address.
+	bool pass;
+
+	memcpy(&emu->mem[DATA_ADDR], tc->data, tc->len);
+	pass = run_checksum_fns(h, emu, tc, FN_CLASSIC, DATA_ADDR);
+
+	memcpy(&emu->mem[FAR_DATA_ADDR], tc->data, tc->len);
+	emu->mem[FAR_PTR_ADDR + 0] = 0;
+	emu->mem[FAR_PTR_ADDR + 1] = (uint8_t)(FAR_DATA_ADDR >> 16);
+	emu->mem[FAR_PTR_ADDR + 2] = (uint8_t)(FAR_DATA_ADDR >> 8);
+	emu->mem[FAR_PTR_ADDR + 3] = (uint8_t)FAR_DATA_ADDR;
+	pass &= run_checksum_fns(h, emu, tc, FN_CLASSIC_FAR, FAR_PTR_ADDR);
+
+	return pass;
+}
+
+static bool run_pid_case(harness_t *h, stm8emu_t *emu, const uint8_t b) {
+	const case_t tc = { 0, b, 0, { 0 }, false };
+	const char *err;
+	bool pass = true;
+	uint8_t ret;
+
+	// (fid): A
+	err = call(h, emu, FN_GET_PID, b, 0, NULL, 0, &ret);
+	pass &= check(h, FN_GET_PID, &tc, err, ret == reference_pid(b), emu);
+
+	// (pid, fid_out): A, X
+	emu->mem[FID_OUT_ADDR] = ~(b & 0x3F);
+	err = call(h, emu, FN_VERIFY_PID, b, FID_OUT_ADDR, NULL, 0, &ret);
+	pass &= check(h, FN_VERIFY_PID, &tc, err, ret == (reference_pid(b) == b) && emu->mem[FID_OUT_ADDR] == (b & 0x3F), emu);
+
+	return pass;
+}
+
+static bool run_batch_case(harness_t *h, stm8emu_t *emu, const uint64_t index) {
+	// A random batch of frames, each either classic (PID of zero) or enhanced,
+	// with about half given a wrong checksum. The results bitmap must have the
+	// right bit for every frame, and nothing beyond it may be written.
+	case_t frames[MAX_BATCH_FRAMES];
+	uint8_t expected[(MAX_BATCH_FRAMES + 7) / 8 + 1] = { 0 };
+	uint8_t stack[2], ret, *rec, count;
+	const size_t results_len = sizeof(expected) - 1;
+	const char *err;
+	uint64_t r = splitmix64(h->seed ^ (index * 0x100000001B3ULL) ^ 0xBA7C4ULL);
+
+	count = (uint8_t)(1 + (r % MAX_BATCH_FRAMES));
+	for(uint8_t i = 0; i < count; i++) {
+		r = splitmix64(r);
+		frames[i].len = (uint8_t)(r % 9);
+		frames[i].classic = ((r >> 4) & 7) == 0;
+		frames[i].pid = (frames[i].classic ? 0 : (uint8_t)(r >> 8));
+		r = splitmix64(r);
+		memcpy(frames[i].data, &r, sizeof(frames[i].data));
+		frames[i].cksum = reference_checksum(frames[i].pid, frames[i].data, frames[i].len);
+		r = splitmix64(r);
+		if(r & 1) {
+			frames[i].cksum += (uint8_t)(1 + ((r >> 1) % 255));
+		} else {
+			expected[i >> 3] |= (uint8_t)(1 << (i & 7));
+		}
+
+		// Struct fields: data pointer (big-endian), length, PID, checksum.
+		rec = &emu->mem[FRAMES_ADDR + i * FRAME_SIZE];
+		rec[0] = (uint8_t)((FRAME_DATA_ADDR + i * 8) >> 8);
+		rec[1] = (uint8_t)(FRAME_DATA_ADDR + i * 8);
+		rec[2] = frames[i].len;
+		rec[3] = frames[i].pid;
+		rec[4] = frames[i].cksum;
+		memcpy(&emu->mem[FRAME_DATA_ADDR + i * 8], frames[i].data, sizeof(frames[i].data));
+	}
+	memset(&emu->mem[RESULTS_ADDR], 0xA5, results_len);
+	for(size_t i = (count + 7) / 8; i < results_len; i++) expected[i] = 0xA5;
+
+	// (frames, count, results): X, A, stack
+	stack[0] = RESULTS_ADDR >> 8;
+	stack[1] = RESULTS_ADDR & 0xFF;
+	err = call(h, emu, FN_VERIFY_BATCH, count, FRAMES_ADDR, stack, 2, &ret);
+
+	// Report against the first frame whose result is wrong.
+	for(uint8_t i = 0; i < count; i++) {
+		if(err != NULL || ((emu->mem[RESULTS_ADDR + (i >> 3)] ^ expected[i >> 3]) & (1 << (i & 7)))) {
+			return check(h, FN_VERIFY_BATCH, &frames[i], err, false, emu);
+		}
+	}
+	return check(h, FN_VERIFY_BATCH, &frames[0], NULL, memcmp(&emu->mem[RESULTS_ADDR], expected, results_len) == 0, emu);
+}
+
+static bool run_compare_case(harness_t *h, stm8emu_t *emu, const uint64_t index) {
+	// A random frame, classic or enhanced, half with a wrong checksum, and a
+	// stored copy of its data with about a quarter of the bytes different.
+	// Only the changed bitmap may be written, and it must be written whether
+	// or not the checksum is verified.
+	case_t tc;
+	uint8_t stored[8], stack[4], ret, *rec, expected_changed = 0;
+	bool expected_ok;
+	const char *err;
+	uint64_t r = splitmix64(h->seed ^ (index * 0x100000001B3ULL) ^ 0xC0A3ULL);
+
+	tc.len = (uint8_t)(r % 9);
+	tc.classic = ((r >> 4) & 3) == 0;
+	tc.pid = (tc.classic ? 0 : (uint8_t)(r >> 8));
+	r = splitmix64(r);
+	memcpy(tc.data, &r, sizeof(tc.data));
+	memcpy(stored, tc.data, sizeof(stored));
+	r = splitmix64(r);
+	for(uint8_t i = 0; i < tc.len; i++) {
+		if(((r >> (i * 4)) & 3) == 0) {
+			stored[i] ^= (uint8_t)(1 << ((r >> (i * 4 + 2)) & 7)) | (uint8_t)(r >> 40);
+			expected_changed |= (uint8_t)(stored[i] != tc.data[i]) << i;
+		}
+	}
+	tc.cksum = reference_checksum(tc.pid, tc.data, tc.len);
+	r = splitmix64(r);
+	expected_ok = !(r & 1);
+	if(!expected_ok) tc.cksum += (uint8_t)(1 + ((r >> 1) % 255));
+
+	rec = &emu->mem[FRAMES_ADDR];
+	rec[0] = (uint8_t)(FRAME_DATA_ADDR >> 8);
+	rec[1] = (uint8_t)FRAME_DATA_ADDR;
+	rec[2] = tc.len;
+	rec[3] = tc.pid;
+	rec[4] = tc.cksum;
+	memcpy(&emu->mem[FRAME_DATA_ADDR], tc.data, sizeof(tc.data));
+	memcpy(&emu->mem[STORED_ADDR], stored, sizeof(stored));
+	memset(&emu->mem[RESULTS_ADDR], 0xA5, 2);
+
+	// (frame, stored, changed): X, stack, stack
+	stack[0] = STORED_ADDR >> 8;
+	stack[1] = STORED_ADDR & 0xFF;
+	stack[2] = RESULTS_ADDR >> 8;
+	stack[3] = RESULTS_ADDR & 0xFF;
+	err = call(h, emu, FN_VERIFY_COMPARE, 0, FRAMES_ADDR, stack, 4, &ret);
+
+	return check(h, FN_VERIFY_COMPARE, &tc, err, ret == expected_ok && emu->mem[RESULTS_ADDR] == expected_changed &&
+		emu->mem[RESULTS_ADDR + 1] == 0xA5 && memcmp(&emu->mem[STORED_ADDR], stored, sizeof(stored)) == 0, emu);
+}
+
+static bool run_readback_case(harness_t *h, stm8emu_t *emu, const uint64_t index) {
+	// A random frame, classic or enhanced, and its echo (data then checksum),
+	// with a bit error in about half, and sometimes in a second byte after the
+	// first. The first position in error must be returned.
+	case_t tc;
+	uint8_t echo[9], stack[3], ret, expected = 0xFF, pos;
+	const char *err;
+	uint64_t r = splitmix64(h->seed ^ (index * 0x100000001B3ULL) ^ 0xEC40ULL);
+
+	tc.len = (uint8_t)(r % 9);
+	tc.classic = ((r >> 4) & 3) == 0;
+	tc.pid = (tc.classic ? 0 : (uint8_t)(r >> 8));
+	r = splitmix64(r);
+	memcpy(tc.data, &r, sizeof(tc.data));
+	tc.cksum = reference_checksum(tc.pid, tc.data, tc.len);
+	memcpy(echo, tc.data, tc.len);
+	echo[tc.len] = tc.cksum;
+	r = splitmix64(r);
+	if(r & 1) {
+		expected = pos = (uint8_t)((r >> 1) % (tc.len + 1));
+		echo[pos] ^= (uint8_t)(1 << ((r >> 8) & 7));
+		if((r >> 11) & 1) {
+			pos += (uint8_t)((r >> 12) % (tc.len + 1 - pos));
+			echo[pos] ^= (uint8_t)(1 << ((r >> 16) & 7));
+			if(echo[expected] == (expected < tc.len ? tc.data[expected] : tc.cksum)) expected = 0xFF;
+		}
+	}
+
+	memcpy(&emu->mem[DATA_ADDR], tc.data, sizeof(tc.data));
+	memcpy(&emu->mem[STORED_ADDR], echo, sizeof(echo));
+
+	// (pid, sent, echo, len): A, X, stack, stack
+	stack[0] = STORED_ADDR >> 8;
+	stack[1] = STORED_ADDR & 0xFF;
+	stack[2] = tc.len;
+	err = call(h, emu, FN_VERIFY_READBACK, tc.pid, DATA_ADDR, stack, 3, &ret);
+
+	return check(h, FN_VERIFY_READBACK, &tc, err, ret == expected, emu);
+}
+
+static bool run_case(harness_t *h, stm8emu_t *emu, const suite_t suite, const uint64_t index) {
+	case_t tc = { 0, 0, 0, { 0 }, false };
+	uint64_t r;
+
+	switch(suite) {
+		case SUITE_PID:
+			return run_pid_case(h, emu, (uint8_t)index);
+		case SUITE_CLASSIC:
+			// Index 0 is the empty payload, 1-256 single bytes, then pairs.
+			tc.classic = true;
+			tc.len = (index == 0 ? 0 : (index <= 256 ? 1 : 2));
+			if(tc.len == 1) tc.data[0] = (uint8_t)(index - 1);
+			if(tc.len == 2) {
+				tc.data[0] = (uint8_t)((index - 257) >> 8);
+				tc.data[1] = (uint8_t)(index - 257);
+			}
+			break;
+		case SUITE_ENHANCED:
+			// 257 cases per PID: empty payload then single bytes.
+			tc.pid = (uint8_t)(index / 257);
+			tc.len = (index % 257 == 0 ? 0 : 1);
+			tc.data[0] = (uint8_t)(index % 257 - 1);
+			break;
+		case SUITE_ENHANCED_2:
+			tc.pid = (uint8_t)(index >> 16);
+			tc.len = 2;
+			tc.data[0] = (uint8_t)(index >> 8);
+			tc.data[1] = (uint8_t)index;
+			break;
+		case SUITE_RANDOM:
+			r = splitmix64(h->seed ^ (index * 0x100000001B3ULL));
+			tc.classic = r & 1;
+			tc.len = (uint8_t)(3 + ((r >> 1) % 6));
+			tc.pid = (uint8_t)(r >> 8);
+			r = splitmix64(r);
+			memcpy(tc.data, &r, sizeof(tc.data));
+			break;
+		case SUITE_BATCH:
+			return run_batch_case(h, emu, index);
+		case SUITE_COMPARE:
+			return run_compare_case(h, emu, index);
+		case SUITE_READBACK:
+			return run_readback_case(h, emu, index);
+		default:
+			return true;
+	}
+
+	return run_checksum_case(h, emu, &tc);
+}
+
+static bool claim_chunk(harness_t *h, suite_t *suite, uint64_t *start, uint64_t *end) {
+	bool claimed = false;
+
+	pthread_mutex_lock(&h->lock);
+	while(h->next_suite < SUITE_COUNT && h->next_index >= h->suite_cases[h->next_suite]) {
+		h->next_suite++;
+		h->next_index = 0;
+	}
+	if(h->next_suite < SUITE_COUNT) {
+		*suite = h->next_suite;
+		*start = h->next_index;
+		*end = h->next_index + CHUNK_SIZE;
+		if(*end > h->suite_cases[*suite]) *end = h->suite_cases[*suite];
+		h->next_index = *end;
+		claimed = true;
+	}
+	pthread_mutex_unlock(&h->lock);
+
+	return claimed;
+}
+
+static void *worker(void *arg) {
+	harness_t *h = arg;
+	stm8emu_t *emu;
+	uint64_t start, end, failures;
+	suite_t suite;
+
+	// Each thread runs its own copy of the emulated machine.
+	if((emu = malloc(sizeof(*emu))) == NULL) {
+		fputs("Error: out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(emu, h->image, sizeof(*emu));
+	emu->steps = 0;
+
+	while(claim_chunk(h, &suite, &start, &end)) {
+		failures = 0;
+		for(uint64_t i = start; i < end; i++) {
+			if(!run_case(h, emu, suite, i)) failures++;
+		}
+		if(failures > 0) {
+			pthread_mutex_lock(&h->lock);
+			h->suite_failures[suite] += failures;
+			pthread_mutex_unlock(&h->lock);
+		}
+	}
+
+	pthread_mutex_lock(&h->lock);
+	h->steps += emu->steps;
+	pthread_mutex_unlock(&h->lock);
+
+	free(emu);
+
+	return NULL;
+}
+
+int main(int argc, char *argv[]) {
+	static harness_t h;
+	stm8emu_t *image;
+	stm8emu_symtab_t symtab;
+	unsigned long threads = 0, count = 1000000, seed = 1;
+	pthread_t *tids;
+	struct timespec t0, t1;
+	uint64_t total_cases = 0, total_failures = 0;
+	char map_path[1024], *end, *dot;
+	bool extended = false;
+	double secs;
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:j:n:s:x")) != -1) {
+		switch(opt) {
+			case 'm':
+				if(strcmp(optarg, "large") == 0) h.large = true;
+				else if(strcmp(optarg, "medium") != 0) goto usage;
+				break;
+			case 'j':
+				threads = strtoul(optarg, &end, 0);
+				if(*end != '\0' || threads == 0) goto usage;
+				break;
+			case 'n':
+				count = strtoul(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 's':
+				seed = strtoul(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 'x':
+				extended = true;
+				break;
+			default:
+				goto usage;
+		}
+	}
+	if(optind != argc - 1 && optind != argc - 2) goto usage;
+
+	if(optind == argc - 2) {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind + 1]);
+	} else {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind]);
+		if((dot = strrchr(map_path, '.')) != NULL && strchr(dot, '/') == NULL) *dot = '\0';
+		strncat(map_path, ".map", sizeof(map_path) - strlen(map_path) - 1);
+	}
+
+	if(threads == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (n > 0 ? (unsigned long)n : 1);
+	}
+
+	if((image = calloc(1, sizeof(*image))) == NULL || (tids = calloc(threads, sizeof(*tids))) == NULL) {
+		fputs("Error: out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if(!stm8emu_load_ihx(image, argv[optind])) return EXIT_FAILURE;
+	if(!stm8emu_load_map(&symtab, map_path)) return EXIT_FAILURE;
+	for(size_t i = 0; i < FN_COUNT; i++) {
+		if(!stm8emu_symbol_addr(&symtab, fn_names[i], &h.fn_addr[i])) {
+			fprintf(stderr, "Error: symbol for %s not found in %s\n", fn_names[i], map_path);
+			return EXIT_FAILURE;
+		}
+	}
+	stm8emu_free_map(&symtab);
+
+	h.image = image;
+	h.seed = seed;
+	h.suite_cases[SUITE_PID] = 256;
+	h.suite_cases[SUITE_CLASSIC] = 1 + 256 + 65536;
+	h.suite_cases[SUITE_ENHANCED] = 256 * 257;
+	h.suite_cases[SUITE_ENHANCED_2] = (extended ? 256 * 65536 : 0);
+	h.suite_cases[SUITE_RANDOM] = count;
+	h.suite_cases[SUITE_BATCH] = 100000;
+	h.suite_cases[SUITE_COMPARE] = 1000000;
+	h.suite_cases[SUITE_READBACK] = 1000000;
+	pthread_mutex_init(&h.lock, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(unsigned long i = 0; i < threads; i++) {
+		if(pthread_create(&tids[i], NULL, worker, &h) != 0) {
+			fputs("Error: failed to create thread\n", stderr);
+			return EXIT_FAILURE;
+		}
+	}
+	for(unsigned long i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	for(size_t i = 0; i < SUITE_COUNT; i++) {
+		if(h.suite_cases[i] == 0) continue;
+		printf("%-48s cases = %10llu, failed = %llu\n", suite_names[i], (unsigned long long)h.suite_cases[i], (unsigned long long)h.suite_failures[i]);
+		total_cases += h.suite_cases[i];
+		total_failures += h.suite_failures[i];
+	}
+	printf("TOTAL: cases = %llu, failed = %llu\n", (unsigned long long)total_cases, (unsigned long long)total_failures);
+	printf("%.2f s, %lu threads, %.1f M instructions/s\n", secs, threads, h.steps / secs / 1e6);
+
+	pthread_mutex_destroy(&h.lock);
+	free(tids);
+	free(image);
+
+	return (total_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+usage:
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
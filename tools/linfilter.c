@@ -0,0 +1,453 @@
+/*******************************************************************************
+ *
+ * linfilter.c - Streaming LIN frame checksum filter
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "lin_checksum.h"
+#include "lincap.h"
+
+// All buffers are static; nothing is allocated per frame. Input is read in
+// large chunks, and output is accumulated and written once per chunk (or when
+// full), so that a burst of frames costs a single read and write, while a
+// lone frame is still passed on as soon as it arrives.
+#define IN_BUF_SIZE (64 * 1024)
+#define OUT_BUF_SIZE (64 * 1024)
+#define LINE_MAX_LEN 256
+
+#define FID_DIAG_MASTER_REQ 0x3C
+#define FID_DIAG_SLAVE_RESP 0x3D
+
+typedef struct {
+	bool binary_in;
+	bool binary_out;
+	bool generate;
+	bool all_classic;
+	bool errors_only;
+	bool unbuffered;
+} options_t;
+
+typedef struct {
+	uint32_t frames;
+	uint32_t errors;
+	uint32_t bad_lines;
+} counters_t;
+
+static const char usage_str[] =
+	"Usage: linfilter [-b] [-w] [-g] [-C] [-e] [-u] < input > output\n"
+	"       linfilter -T <frames>\n"
+	"\n"
+	"  -b  Input is binary capture data rather than hex text\n"
+	"  -w  Output binary capture data rather than annotated text\n"
+	"  -g  Generate mode: input gives frame ID and data, PID and checksum are\n"
+	"      calculated\n"
+	"  -C  Use classic checksums for all frames (default is enhanced, except for\n"
+	"      diagnostic frames 0x3C and 0x3D)\n"
+	"  -e  Only output frames that fail verification\n"
+	"  -u  Flush output after every frame\n"
+	"  -T  Benchmark throughput and latency with given number of frames\n"
+	"\n"
+	"Hex input lines are: [<time_us>:] <pid> [<data>...] <checksum>\n"
+	"or, in generate mode: [<time_us>:] <fid> [<data>...]\n";
+
+static uint8_t in_buf[IN_BUF_SIZE + LINE_MAX_LEN];
+static uint8_t out_buf[OUT_BUF_SIZE];
+static size_t out_len = 0;
+static bool out_discard = false;
+
+static options_t opts;
+static counters_t counters;
+static struct timespec start_time;
+
+/******************************************************************************/
+
+static uint64_t elapsed_ns(const struct timespec *since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - since->tv_sec) * 1000000000ULL + (uint64_t)now.tv_nsec - (uint64_t)since->tv_nsec;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t len) {
+	ssize_t n;
+
+	while(len > 0) {
+		n = write(fd, buf, len);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+
+	return true;
+}
+
+static bool out_flush(void) {
+	bool ok = (out_discard || write_all(STDOUT_FILENO, out_buf, out_len));
+	out_len = 0;
+	return ok;
+}
+
+static bool out_reserve(const size_t len) {
+	return (out_len + len <= OUT_BUF_SIZE || out_flush());
+}
+
+static inline bool frame_is_classic(const uint8_t pid) {
+	const uint8_t fid = pid & 0x3F;
+	return opts.all_classic || fid == FID_DIAG_MASTER_REQ || fid == FID_DIAG_SLAVE_RESP;
+}
+
+static bool emit_frame(lincap_frame_t *frame) {
+	uint8_t status;
+
+	if(frame_is_classic(frame->pid)) frame->flags |= LINCAP_FLAG_CLASSIC;
+
+	if(opts.generate) {
+		frame->pid = lin_get_protected_id(frame->pid);
+		if(frame->flags & LINCAP_FLAG_CLASSIC) {
+			frame->cksum = lin_calculate_checksum_classic(frame->data, frame->data_len);
+		} else {
+			frame->cksum = lin_calculate_checksum_enhanced(frame->pid, frame->data, frame->data_len);
+		}
+	}
+
+	status = lincap_frame_verify(frame);
+
+	counters.frames++;
+	if(status != LINCAP_STATUS_OK) counters.errors++;
+	if(opts.errors_only && status == LINCAP_STATUS_OK) return true;
+
+	if(opts.binary_out) {
+		if(!out_reserve(LINCAP_RECORD_SIZE)) return false;
+		lincap_encode_frame(out_buf + out_len, frame);
+		out_len += LINCAP_RECORD_SIZE;
+	} else {
+		if(!out_reserve(LINCAP_FORMAT_MAX)) return false;
+		out_len += lincap_format_frame((char *)out_buf + out_len, frame, status);
+	}
+
+	return (!opts.unbuffered || out_flush());
+}
+
+static inline int hex_value(const uint8_t c) {
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+static bool parse_line(const uint8_t *ptr, const uint8_t *end, lincap_frame_t *frame, bool *empty) {
+	// Parses a line of hex bytes in place. Returns false on a syntax error.
+	uint8_t bytes[LINCAP_DATA_MAX + 2];
+	size_t count = 0;
+	bool have_time = false;
+	uint64_t time = 0;
+	int hi, lo;
+
+	*empty = true;
+
+	while(ptr < end) {
+		while(ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) ptr++;
+		if(ptr >= end || *ptr == '#') break;
+		*empty = false;
+
+		// Leading decimal timestamp, terminated by a colon.
+		if(count == 0 && !have_time) {
+			const uint8_t *p = ptr;
+			uint64_t val = 0;
+			while(p < end && *p >= '0' && *p <= '9') val = val * 10 + (uint64_t)(*p++ - '0');
+			if(p < end && *p == ':' && p > ptr) {
+				time = val;
+				have_time = true;
+				ptr = p + 1;
+				continue;
+			}
+		}
+
+		if(count >= sizeof(bytes)) return false;
+		if((hi = hex_value(*ptr++)) < 0) return false;
+		if(ptr < end && (lo = hex_value(*ptr)) >= 0) {
+			bytes[count++] = (uint8_t)((hi << 4) | lo);
+			ptr++;
+		} else {
+			bytes[count++] = (uint8_t)hi;
+		}
+		if(ptr < end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r') return false;
+	}
+
+	if(*empty) return true;
+	if(count == 0) return false;
+
+	memset(frame, 0, sizeof(*frame));
+	frame->time_us = (have_time ? time : elapsed_ns(&start_time) / 1000);
+	frame->pid = bytes[0];
+
+	if(opts.generate) {
+		if(count - 1 > LINCAP_DATA_MAX) return false;
+		frame->data_len = (uint8_t)(count - 1);
+		memcpy(frame->data, bytes + 1, frame->data_len);
+	} else if(count == 1) {
+		frame->flags = LINCAP_FLAG_NO_RESPONSE;
+	} else {
+		frame->data_len = (uint8_t)(count - 2);
+		memcpy(frame->data, bytes + 1, frame->data_len);
+		frame->cksum = bytes[count - 1];
+	}
+
+	return true;
+}
+
+static bool process_text(const uint8_t *buf, const size_t len, size_t *consumed) {
+	// Handles every complete line in the buffer, and reports how much of it was
+	// consumed, so that any trailing partial line can be carried over.
+	const uint8_t *ptr = buf, *end = buf + len, *eol;
+	lincap_frame_t frame;
+	bool empty;
+
+	while(ptr < end && (eol = memchr(ptr, '\n', (size_t)(end - ptr))) != NULL) {
+		if(!parse_line(ptr, eol, &frame, &empty)) {
+			counters.bad_lines++;
+		} else if(!empty && !emit_frame(&frame)) {
+			return false;
+		}
+		ptr = eol + 1;
+	}
+
+	*consumed = (size_t)(ptr - buf);
+
+	return true;
+}
+
+static bool process_binary(const uint8_t *buf, const size_t len, size_t *consumed) {
+	lincap_frame_t frame;
+	size_t pos = 0;
+
+	for(; pos + LINCAP_RECORD_SIZE <= len; pos += LINCAP_RECORD_SIZE) {
+		lincap_decode_frame(buf + pos, &frame);
+		if(!emit_frame(&frame)) return false;
+	}
+
+	*consumed = pos;
+
+	return true;
+}
+
+static int run_filter(void) {
+	size_t fill = 0, consumed;
+	bool header_done = !opts.binary_in;
+	uint32_t baud = LINCAP_DEFAULT_BAUD;
+	ssize_t n;
+
+	// Binary output carries the baud rate of binary input through, so its
+	// header waits for that of the input.
+	if(opts.binary_out && header_done) {
+		lincap_encode_header(out_buf, baud);
+		out_len = LINCAP_HEADER_SIZE;
+	}
+
+	for(;;) {
+		// Before potentially blocking on input, pass on everything processed
+		// so far.
+		if(out_len > 0 && !out_flush()) return EXIT_FAILURE;
+
+		n = read(STDIN_FILENO, in_buf + fill, IN_BUF_SIZE - fill);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			perror("read");
+			return EXIT_FAILURE;
+		}
+		if(n == 0) break;
+		fill += (size_t)n;
+
+		if(!header_done) {
+			if(fill < LINCAP_HEADER_SIZE) continue;
+			if(!lincap_decode_header(in_buf, &baud)) {
+				fputs("input is not LIN capture data\n", stderr);
+				return EXIT_FAILURE;
+			}
+			memmove(in_buf, in_buf + LINCAP_HEADER_SIZE, fill - LINCAP_HEADER_SIZE);
+			fill -= LINCAP_HEADER_SIZE;
+			header_done = true;
+			if(opts.binary_out) {
+				lincap_encode_header(out_buf, baud);
+				out_len = LINCAP_HEADER_SIZE;
+			}
+		}
+
+		if(!(opts.binary_in ? process_binary(in_buf, fill, &consumed) : process_text(in_buf, fill, &consumed))) {
+			perror("write");
+			return EXIT_FAILURE;
+		}
+
+		// A line longer than the whole buffer is junk; discard it.
+		if(consumed == 0 && fill == IN_BUF_SIZE) {
+			counters.bad_lines++;
+			consumed = fill;
+		}
+		memmove(in_buf, in_buf + consumed, fill - consumed);
+		fill -= consumed;
+	}
+
+	// Handle an unterminated final line.
+	if(!opts.binary_in && fill > 0) {
+		in_buf[fill++] = '\n';
+		if(!process_text(in_buf, fill, &consumed)) return EXIT_FAILURE;
+	}
+
+	if(!out_flush()) {
+		perror("write");
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "frames = %u, errors = %u, bad lines = %u\n", counters.frames, counters.errors, counters.bad_lines);
+
+	return EXIT_SUCCESS;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int run_benchmark(const uint32_t frame_count) {
+	// Throughput is measured over a buffer of synthetic hex frames processed in
+	// IN_BUF_SIZE chunks, exactly as from stdin. Latency is measured per frame,
+	// with each one processed and flushed to its own output buffer on its own.
+	enum { LATENCY_SAMPLES = 10000 };
+	static uint64_t latency[LATENCY_SAMPLES];
+	const size_t line_max = 48;
+	uint8_t *text = malloc((size_t)frame_count * line_max);
+	size_t text_len = 0, pos, chunk, consumed;
+	struct timespec t0;
+	uint64_t ns, sum = 0;
+	uint32_t seed = 1, samples;
+	lincap_frame_t frame;
+	uint8_t status;
+
+	if(text == NULL) {
+		fputs("out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	for(uint32_t i = 0; i < frame_count; i++) {
+		memset(&frame, 0, sizeof(frame));
+		seed = seed * 1103515245 + 12345;
+		frame.pid = lin_get_protected_id((uint8_t)(seed >> 16));
+		frame.data_len = 8;
+		for(uint8_t j = 0; j < frame.data_len; j++) {
+			seed = seed * 1103515245 + 12345;
+			frame.data[j] = (uint8_t)(seed >> 16);
+		}
+		frame.cksum = lin_calculate_checksum_enhanced(frame.pid, frame.data, frame.data_len);
+		frame.time_us = (uint64_t)i * 10000;
+		text_len += (size_t)sprintf((char *)text + text_len, "%llu: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X\n",
+			(unsigned long long)frame.time_us, frame.pid, frame.data[0], frame.data[1], frame.data[2], frame.data[3],
+			frame.data[4], frame.data[5], frame.data[6], frame.data[7], frame.cksum);
+	}
+
+	// Output is discarded rather than written, so only the filter's own work
+	// is measured.
+	out_discard = true;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(pos = 0; pos < text_len; pos += consumed) {
+		chunk = (text_len - pos < IN_BUF_SIZE ? text_len - pos : IN_BUF_SIZE);
+		process_text(text + pos, chunk, &consumed);
+		out_flush();
+	}
+	ns = elapsed_ns(&t0);
+
+	printf("throughput: %u frames, %zu bytes in %.3f ms = %.0f frames/s, %.1f MB/s\n",
+		counters.frames, text_len, ns / 1e6, counters.frames / (ns / 1e9), text_len / (ns / 1e3));
+
+	samples = (frame_count < LATENCY_SAMPLES ? frame_count : LATENCY_SAMPLES);
+	for(pos = 0, consumed = 0; pos < samples; pos++) {
+		const uint8_t *line = text + consumed;
+		const uint8_t *eol = memchr(line, '\n', text_len - consumed);
+		bool empty;
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		parse_line(line, eol, &frame, &empty);
+		status = lincap_frame_verify(&frame);
+		out_len = lincap_format_frame((char *)out_buf, &frame, status);
+		latency[pos] = elapsed_ns(&t0);
+
+		sum += latency[pos];
+		consumed = (size_t)(eol + 1 - text);
+	}
+	qsort(latency, samples, sizeof(latency[0]), compare_u64);
+
+	if(samples > 0) {
+		printf("latency: %u frames, min = %llu ns, mean = %llu ns, p99 = %llu ns, max = %llu ns\n",
+			samples, (unsigned long long)latency[0], (unsigned long long)(sum / samples),
+			(unsigned long long)latency[(samples * 99) / 100], (unsigned long long)latency[samples - 1]);
+	}
+
+	free(text);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long bench_frames = 0;
+	char *end;
+	int opt;
+
+	while((opt = getopt(argc, argv, "bwgCeuT:")) != -1) {
+		switch(opt) {
+			case 'b': opts.binary_in = true; break;
+			case 'w': opts.binary_out = true; break;
+			case 'g': opts.generate = true; break;
+			case 'C': opts.all_classic = true; break;
+			case 'e': opts.errors_only = true; break;
+			case 'u': opts.unbuffered = true; break;
+			case 'T':
+				bench_frames = strtoul(optarg, &end, 0);
+				if(*end != '\0' || bench_frames == 0 || bench_frames > 10000000) {
+					fputs(usage_str, stderr);
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				fputs(usage_str, stderr);
+				return EXIT_FAILURE;
+		}
+	}
+	if(optind != argc || (opts.generate && opts.binary_in)) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	return (bench_frames > 0 ? run_benchmark((uint32_t)bench_frames) : run_filter());
+}
@@ -0,0 +1,508 @@
+/*******************************************************************************
+ *
+ * linfuzz.c - Coverage-guided differential fuzzer for compiled LIN library
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "lin_checksum.h"
+#include "stm8emu.h"
+
+// An input is a PID, a checksum (to be verified), an offset from DATA_ADDR at
+// which to place the data (so that page boundaries get crossed), then 0 to 255
+// bytes of data.
+#define INPUT_HEAD 3
+#define INPUT_MAX (INPUT_HEAD + 255)
+
+// RAM locations of function arguments passed by reference.
+#define DATA_ADDR 0x0100
+#define FID_OUT_ADDR 0x00F0
+
+#define MAX_STEPS_PER_CALL 10000
+#define MAX_CORPUS 65536
+#define MAX_REPORTED_DIVERGENCES 10
+#define MAX_STACKED_MUTATIONS 8
+
+typedef enum {
+	FN_CLASSIC,
+	FN_ENHANCED,
+	FN_VERIFY_CLASSIC,
+	FN_VERIFY_ENHANCED,
+	FN_GET_PID,
+	FN_VERIFY_PID,
+	FN_COUNT
+} fn_t;
+
+static const char *fn_names[FN_COUNT] = {
+	"lin_calculate_checksum_classic",
+	"lin_calculate_checksum_enhanced",
+	"lin_verify_checksum_classic",
+	"lin_verify_checksum_enhanced",
+	"lin_get_protected_id",
+	"lin_verify_protected_id",
+};
+
+typedef struct {
+	size_t len;
+	uint8_t buf[INPUT_MAX];
+} input_t;
+
+typedef struct {
+	stm8emu_t *emu;
+	uint32_t fn_addr[FN_COUNT];
+	bool large;
+	const char *corpus_dir;
+	uint64_t rng;
+
+	// Coverage of the current execution, and all coverage seen so far. The
+	// latter holds one bit per edge per hit count bucket.
+	uint8_t trace[STM8EMU_COV_SIZE];
+	uint8_t seen[STM8EMU_COV_SIZE];
+	unsigned int edges;
+
+	input_t *corpus;
+	size_t corpus_count;
+
+	uint64_t execs;
+	uint64_t divergences;
+} fuzzer_t;
+
+static const char usage_str[] =
+	"Usage: linfuzz [-m <model>] [-c <corpus>] [-n <execs>] [-t <seconds>] [-s <seed>] <image.ihx> [<image.map>]\n"
+	"\n"
+	"  -m  Memory model the image was compiled for, 'medium' (default) or 'large'\n"
+	"  -c  Directory in which to load and save the corpus and divergent inputs\n"
+	"  -n  Stop after this many executions\n"
+	"  -t  Stop after this many seconds (default 60, 0 for no limit)\n"
+	"  -s  Seed for mutations (default is time)\n"
+	"\n"
+	"The map file defaults to the image path with a .map extension.\n";
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/******************************************************************************/
+
+static uint64_t rand64(fuzzer_t *fz) {
+	// xorshift64*
+	fz->rng ^= fz->rng >> 12;
+	fz->rng ^= fz->rng << 25;
+	fz->rng ^= fz->rng >> 27;
+	return fz->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t rand_below(fuzzer_t *fz, const uint32_t n) {
+	return (uint32_t)((rand64(fz) >> 32) % n);
+}
+
+static uint64_t input_hash(const input_t *in) {
+	// FNV-1a, to give saved inputs a name unique to their content.
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for(size_t i = 0; i < in->len; i++) h = (h ^ in->buf[i]) * 0x100000001B3ULL;
+	return h;
+}
+
+static void on_signal(int sig) {
+	(void)sig;
+	stop_requested = 1;
+}
+
+/******************************************************************************/
+
+static bool save_input(const fuzzer_t *fz, const char *prefix, const input_t *in) {
+	char path[1024];
+	FILE *file;
+
+	if(fz->corpus_dir == NULL) return true;
+
+	snprintf(path, sizeof(path), "%s/%s%016llx", fz->corpus_dir, prefix, (unsigned long long)input_hash(in));
+	if((file = fopen(path, "wb")) == NULL || fwrite(in->buf, 1, in->len, file) != in->len || fclose(file) != 0) {
+		perror(path);
+		return false;
+	}
+
+	return true;
+}
+
+static void print_input(const input_t *in) {
+	printf("pid = 0x%02X, cksum = 0x%02X, addr = 0x%04X, len = %u, data =", in->buf[0], in->buf[1],
+		DATA_ADDR + in->buf[2], (unsigned int)(in->len - INPUT_HEAD));
+	for(size_t i = INPUT_HEAD; i < in->len; i++) printf(" %02X", in->buf[i]);
+	putchar('\n');
+}
+
+static bool call(fuzzer_t *fz, const input_t *in, const fn_t fn, const uint8_t a, const uint16_t x, const uint8_t *stack_args, const uint8_t stack_len, const uint8_t expected) {
+	// Calls the compiled function and compares what it returns against the C
+	// reference, reporting the first few divergences. Returns whether same.
+	const stm8emu_status_t status = stm8emu_call(fz->emu, fz->fn_addr[fn], fz->large, a, x, stack_args, stack_len, MAX_STEPS_PER_CALL);
+
+	if(status == STM8EMU_OK && fz->emu->a == expected) return true;
+
+	if(fz->divergences < MAX_REPORTED_DIVERGENCES) {
+		printf("DIVERGENCE: %s: ", fn_names[fn]);
+		if(status != STM8EMU_OK) {
+			printf("%s (pc = 0x%06X, sp = 0x%04X)\n", stm8emu_status_str(status), fz->emu->fault_pc, fz->emu->sp);
+		} else {
+			printf("expected 0x%02X, got 0x%02X\n", expected, fz->emu->a);
+		}
+		printf("  ");
+		print_input(in);
+	}
+
+	return false;
+}
+
+static bool execute(fuzzer_t *fz, const input_t *in) {
+	// Runs every library function on the input, in the emulator and natively,
+	// recording coverage of the former. Returns whether all agreed.
+	const uint8_t pid = in->buf[0];
+	const uint8_t cksum = in->buf[1];
+	const uint16_t addr = DATA_ADDR + in->buf[2];
+	const uint8_t *data = &in->buf[INPUT_HEAD];
+	const uint8_t len = (uint8_t)(in->len - INPUT_HEAD);
+	uint8_t stack[4], fid_out;
+	bool same = true;
+
+	memset(fz->trace, 0, sizeof(fz->trace));
+	memcpy(&fz->emu->mem[addr], data, len);
+
+	// (data, len): X, A
+	same &= call(fz, in, FN_CLASSIC, len, addr, NULL, 0, lin_calculate_checksum_classic(data, len));
+
+	// (pid, data, len): A, X, stack
+	stack[0] = len;
+	same &= call(fz, in, FN_ENHANCED, pid, addr, stack, 1, lin_calculate_checksum_enhanced(pid, data, len));
+
+	// (cksum, data, len): A, X, stack
+	same &= call(fz, in, FN_VERIFY_CLASSIC, cksum, addr, stack, 1, lin_verify_checksum_classic(cksum, data, len));
+
+	// (cksum, pid, data, len): A, stack, stack, stack
+	stack[0] = pid;
+	stack[1] = addr >> 8;
+	stack[2] = addr & 0xFF;
+	stack[3] = len;
+	same &= call(fz, in, FN_VERIFY_ENHANCED, cksum, 0, stack, 4, lin_verify_checksum_enhanced(cksum, pid, data, len));
+
+	// (fid): A
+	same &= call(fz, in, FN_GET_PID, pid, 0, NULL, 0, lin_get_protected_id(pid));
+
+	// (pid, fid_out): A, X
+	fz->emu->mem[FID_OUT_ADDR] = ~pid;
+	same &= call(fz, in, FN_VERIFY_PID, pid, FID_OUT_ADDR, NULL, 0, lin_verify_protected_id(pid, &fid_out));
+	if(fz->emu->mem[FID_OUT_ADDR] != fid_out) {
+		if(fz->divergences < MAX_REPORTED_DIVERGENCES) {
+			printf("DIVERGENCE: %s: expected fid_out 0x%02X, got 0x%02X\n  ", fn_names[FN_VERIFY_PID], fid_out, fz->emu->mem[FID_OUT_ADDR]);
+			print_input(in);
+		}
+		same = false;
+	}
+
+	fz->execs++;
+	if(!same) fz->divergences++;
+
+	return same;
+}
+
+static uint8_t hit_bucket(const uint8_t count) {
+	// Hit counts are grouped so that, for example, each length of loop up to
+	// a few iterations counts as new coverage, but longer ones only when they
+	// reach the next power of two.
+	if(count == 0) return 0;
+	if(count <= 3) return 1 << (count - 1);
+	if(count <= 7) return 0x08;
+	if(count <= 15) return 0x10;
+	if(count <= 31) return 0x20;
+	if(count <= 127) return 0x40;
+	return 0x80;
+}
+
+static bool merge_coverage(fuzzer_t *fz) {
+	// Returns whether the last execution reached any new edge or hit count.
+	bool new_coverage = false;
+	uint8_t bucket;
+
+	for(size_t i = 0; i < STM8EMU_COV_SIZE; i++) {
+		if(fz->trace[i] == 0) continue;
+		bucket = hit_bucket(fz->trace[i]);
+		if(bucket & ~fz->seen[i]) {
+			if(fz->seen[i] == 0) fz->edges++;
+			fz->seen[i] |= bucket;
+			new_coverage = true;
+		}
+	}
+
+	return new_coverage;
+}
+
+static void add_to_corpus(fuzzer_t *fz, const input_t *in) {
+	if(fz->corpus_count >= MAX_CORPUS) return;
+	fz->corpus[fz->corpus_count++] = *in;
+}
+
+static void run_and_keep(fuzzer_t *fz, const input_t *in, const bool save) {
+	// Inputs reaching new coverage join the corpus, and the divergent ones
+	// that were reported are saved separately so they can be reproduced.
+	const bool same = execute(fz, in);
+
+	if(merge_coverage(fz)) {
+		add_to_corpus(fz, in);
+		if(save) save_input(fz, "id-", in);
+	}
+	if(!same && save && fz->divergences <= MAX_REPORTED_DIVERGENCES) save_input(fz, "div-", in);
+}
+
+/******************************************************************************/
+
+static void mutate(fuzzer_t *fz, input_t *in) {
+	static const uint8_t interesting[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+	const unsigned int count = 1 + rand_below(fz, MAX_STACKED_MUTATIONS);
+	const input_t *other;
+	size_t pos, n;
+
+	for(unsigned int i = 0; i < count; i++) {
+		pos = rand_below(fz, (uint32_t)in->len);
+
+		switch(rand_below(fz, 9)) {
+			case 0:
+				in->buf[pos] ^= 1 << rand_below(fz, 8);
+				break;
+			case 1:
+				in->buf[pos] = (uint8_t)rand64(fz);
+				break;
+			case 2:
+				in->buf[pos] = interesting[rand_below(fz, sizeof(interesting))];
+				break;
+			case 3:
+				in->buf[pos] += (uint8_t)(rand_below(fz, 35) - 17);
+				break;
+			case 4:
+				// Insert a byte of data.
+				if(in->len >= INPUT_MAX) break;
+				if(pos < INPUT_HEAD) pos = INPUT_HEAD;
+				memmove(&in->buf[pos + 1], &in->buf[pos], in->len - pos);
+				in->buf[pos] = (uint8_t)rand64(fz);
+				in->len++;
+				break;
+			case 5:
+				// Delete a byte of data.
+				if(in->len <= INPUT_HEAD || pos < INPUT_HEAD) break;
+				memmove(&in->buf[pos], &in->buf[pos + 1], in->len - pos - 1);
+				in->len--;
+				break;
+			case 6:
+				// Append a run of one value, such as to make long frames of all
+				// 0xFF bytes where carries are most frequent.
+				n = 1 + rand_below(fz, 32);
+				if(in->len + n > INPUT_MAX) n = INPUT_MAX - in->len;
+				memset(&in->buf[in->len], interesting[rand_below(fz, sizeof(interesting))], n);
+				in->len += n;
+				break;
+			case 7:
+				// Splice data from another corpus entry.
+				other = &fz->corpus[rand_below(fz, (uint32_t)fz->corpus_count)];
+				if(other->len <= INPUT_HEAD) break;
+				n = INPUT_HEAD + rand_below(fz, (uint32_t)(other->len - INPUT_HEAD));
+				if(pos < INPUT_HEAD) pos = INPUT_HEAD;
+				if(pos + (other->len - n) > INPUT_MAX) break;
+				memcpy(&in->buf[pos], &other->buf[n], other->len - n);
+				in->len = pos + (other->len - n);
+				break;
+			case 8:
+				// Make the checksum correct (as either type) so verification
+				// succeeds, which random values rarely do.
+				in->buf[1] = (rand_below(fz, 2)
+					? lin_calculate_checksum_classic(&in->buf[INPUT_HEAD], (uint8_t)(in->len - INPUT_HEAD))
+					: lin_calculate_checksum_enhanced(in->buf[0], &in->buf[INPUT_HEAD], (uint8_t)(in->len - INPUT_HEAD)));
+				break;
+		}
+	}
+}
+
+static size_t load_corpus(fuzzer_t *fz) {
+	// Previously saved inputs (including divergent ones, so they are checked
+	// again) are run first. Returns how many were loaded.
+	char path[1024];
+	struct dirent *ent;
+	struct stat st;
+	input_t in;
+	size_t loaded = 0;
+	FILE *file;
+	DIR *dir;
+
+	if((dir = opendir(fz->corpus_dir)) == NULL) {
+		if(mkdir(fz->corpus_dir, 0777) != 0) perror(fz->corpus_dir);
+		return 0;
+	}
+
+	while((ent = readdir(dir)) != NULL) {
+		snprintf(path, sizeof(path), "%s/%s", fz->corpus_dir, ent->d_name);
+		if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+		if(st.st_size < INPUT_HEAD || st.st_size > INPUT_MAX) continue;
+		if((file = fopen(path, "rb")) == NULL) continue;
+		in.len = fread(in.buf, 1, sizeof(in.buf), file);
+		fclose(file);
+		if(in.len < INPUT_HEAD) continue;
+
+		run_and_keep(fz, &in, false);
+		loaded++;
+	}
+
+	closedir(dir);
+
+	return loaded;
+}
+
+static void seed_corpus(fuzzer_t *fz) {
+	// Frames of each LIN data length, all zeroes and all ones.
+	input_t in;
+
+	for(uint8_t len = 0; len <= 8; len++) {
+		for(uint8_t fill = 0; fill < 2; fill++) {
+			in.len = INPUT_HEAD + len;
+			in.buf[0] = 0x3C;
+			in.buf[1] = 0x00;
+			in.buf[2] = 0x00;
+			memset(&in.buf[INPUT_HEAD], (fill ? 0xFF : 0x00), len);
+			run_and_keep(fz, &in, true);
+		}
+	}
+}
+
+static void print_stats(const fuzzer_t *fz, const double secs, const char *prefix) {
+	printf("%s%.0f s: execs = %llu (%.0f/s), corpus = %zu, edges = %u, divergences = %llu\n", prefix, secs,
+		(unsigned long long)fz->execs, (secs > 0 ? fz->execs / secs : 0.0), fz->corpus_count, fz->edges,
+		(unsigned long long)fz->divergences);
+	fflush(stdout);
+}
+
+static double elapsed(const struct timespec *t0) {
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+	static fuzzer_t fz;
+	stm8emu_symtab_t symtab;
+	unsigned long long max_execs = 0, seed = 0;
+	unsigned long max_secs = 60;
+	struct timespec t0;
+	double secs, next_report = 1.0;
+	char map_path[1024], *end, *dot;
+	input_t in;
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:c:n:t:s:")) != -1) {
+		switch(opt) {
+			case 'm':
+				if(strcmp(optarg, "large") == 0) fz.large = true;
+				else if(strcmp(optarg, "medium") != 0) goto usage;
+				break;
+			case 'c':
+				fz.corpus_dir = optarg;
+				break;
+			case 'n':
+				max_execs = strtoull(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 't':
+				max_secs = strtoul(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 's':
+				seed = strtoull(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			default:
+				goto usage;
+		}
+	}
+	if(optind != argc - 1 && optind != argc - 2) goto usage;
+
+	if(optind == argc - 2) {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind + 1]);
+	} else {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind]);
+		if((dot = strrchr(map_path, '.')) != NULL && strchr(dot, '/') == NULL) *dot = '\0';
+		strncat(map_path, ".map", sizeof(map_path) - strlen(map_path) - 1);
+	}
+
+	if((fz.emu = calloc(1, sizeof(*fz.emu))) == NULL || (fz.corpus = calloc(MAX_CORPUS, sizeof(*fz.corpus))) == NULL) {
+		fputs("Error: out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if(!stm8emu_load_ihx(fz.emu, argv[optind])) return EXIT_FAILURE;
+	if(!stm8emu_load_map(&symtab, map_path)) return EXIT_FAILURE;
+	for(size_t i = 0; i < FN_COUNT; i++) {
+		if(!stm8emu_symbol_addr(&symtab, fn_names[i], &fz.fn_addr[i])) {
+			fprintf(stderr, "Error: symbol for %s not found in %s\n", fn_names[i], map_path);
+			return EXIT_FAILURE;
+		}
+	}
+	stm8emu_free_map(&symtab);
+
+	fz.emu->coverage = fz.trace;
+	fz.rng = (seed != 0 ? seed : (unsigned long long)time(NULL));
+	signal(SIGINT, on_signal);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	if(fz.corpus_dir != NULL) printf("loaded %zu inputs from %s\n", load_corpus(&fz), fz.corpus_dir);
+	seed_corpus(&fz);
+
+	while(!stop_requested && (max_execs == 0 || fz.execs < max_execs)) {
+		in = fz.corpus[rand_below(&fz, (uint32_t)fz.corpus_count)];
+		mutate(&fz, &in);
+		run_and_keep(&fz, &in, true);
+
+		// Checking the clock every execution would be noticeably slow.
+		if((fz.execs & 0x3FF) == 0) {
+			secs = elapsed(&t0);
+			if(max_secs > 0 && secs >= max_secs) break;
+			if(secs >= next_report) {
+				print_stats(&fz, secs, "");
+				next_report = secs + 1.0;
+			}
+		}
+	}
+
+	print_stats(&fz, elapsed(&t0), "DONE: ");
+
+	free(fz.corpus);
+	free(fz.emu);
+
+	return (fz.divergences == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+usage:
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,194 @@
+/*******************************************************************************
+ *
+ * linidx.c - LIN capture index builder and query tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lincap.h"
+#include "lin_index.h"
+
+static const char usage_str[] =
+	"Usage: linidx build [-b <block_records>] <capture> [<index>]\n"
+	"       linidx query [-i <fid>] [-f <from_us>] [-t <to_us>] [-e] [-c] [-v] <capture> [<index>]\n"
+	"\n"
+	"  -b  Number of records per time index block (default 256)\n"
+	"  -i  Only frames with given frame ID (0-63)\n"
+	"  -f  Only frames at or after given time (microseconds)\n"
+	"  -t  Only frames before given time (microseconds)\n"
+	"  -e  Only frames that failed parity or checksum verification\n"
+	"  -c  Only output count of matching frames\n"
+	"  -v  Output query statistics to stderr\n"
+	"\n"
+	"Index file defaults to <capture>.idx. A capture of \"-\" reads from standard\n"
+	"input when building, in which case the index file must be given.\n";
+
+/******************************************************************************/
+
+static bool print_match(const uint32_t record, const lincap_frame_t *frame, void *ctx) {
+	char line[LINCAP_FORMAT_MAX];
+
+	(void)record;
+	(void)ctx;
+
+	lincap_format_frame(line, frame, lincap_frame_verify(frame));
+	return (fputs(line, stdout) >= 0);
+}
+
+static char *default_index_path(const char *capture_path) {
+	char *path = malloc(strlen(capture_path) + 5);
+	if(path != NULL) {
+		strcpy(path, capture_path);
+		strcat(path, ".idx");
+	}
+	return path;
+}
+
+static bool parse_uint(const char *str, unsigned long long max, unsigned long long *val) {
+	char *end;
+	*val = strtoull(str, &end, 0);
+	return (*str != '\0' && *end == '\0' && *val <= max);
+}
+
+static int cmd_build(int argc, char *argv[]) {
+	unsigned long long block = LIN_INDEX_DEFAULT_BLOCK;
+	lin_index_t idx;
+	char *index_path;
+	int i;
+
+	for(i = 0; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+		if(strcmp(argv[i], "-b") == 0 && i + 1 < argc && parse_uint(argv[i + 1], UINT32_MAX, &block) && block > 0) {
+			i++;
+		} else {
+			fputs(usage_str, stderr);
+			return EXIT_FAILURE;
+		}
+	}
+	// An index built from standard input can't go next to the capture, so
+	// must be given a path.
+	if(argc - i < 1 || argc - i > 2 || (argc - i == 1 && strcmp(argv[i], "-") == 0)) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	index_path = (argc - i == 2 ? strdup(argv[i + 1]) : default_index_path(argv[i]));
+	if(index_path == NULL) return EXIT_FAILURE;
+
+	if(!lin_index_build(&idx, argv[i], (uint32_t)block) || !lin_index_save(&idx, index_path)) {
+		free(index_path);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%s: indexed %u records in %u blocks\n", index_path, idx.record_count, idx.block_count);
+
+	lin_index_free(&idx);
+	free(index_path);
+
+	return EXIT_SUCCESS;
+}
+
+static int cmd_query(int argc, char *argv[]) {
+	lin_index_query_t query = { LIN_INDEX_ANY_FID, 0, UINT64_MAX, false };
+	lin_index_stats_t stats;
+	lin_index_t idx;
+	lincap_reader_t cap;
+	unsigned long long val;
+	bool count_only = false, verbose = false, ok;
+	char *index_path;
+	int i;
+
+	for(i = 0; i < argc && argv[i][0] == '-'; i++) {
+		if(strcmp(argv[i], "-i") == 0 && i + 1 < argc && parse_uint(argv[i + 1], LINCAP_FID_COUNT - 1, &val)) {
+			query.fid = (int)val;
+			i++;
+		} else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc && parse_uint(argv[i + 1], UINT64_MAX, &val)) {
+			query.time_from = val;
+			i++;
+		} else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc && parse_uint(argv[i + 1], UINT64_MAX, &val)) {
+			query.time_to = val;
+			i++;
+		} else if(strcmp(argv[i], "-e") == 0) {
+			query.failed_only = true;
+		} else if(strcmp(argv[i], "-c") == 0) {
+			count_only = true;
+		} else if(strcmp(argv[i], "-v") == 0) {
+			verbose = true;
+		} else {
+			fputs(usage_str, stderr);
+			return EXIT_FAILURE;
+		}
+	}
+	// An index built from standard input can't go next to the capture, so
+	// must be given a path.
+	if(argc - i < 1 || argc - i > 2 || (argc - i == 1 && strcmp(argv[i], "-") == 0)) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	index_path = (argc - i == 2 ? strdup(argv[i + 1]) : default_index_path(argv[i]));
+	if(index_path == NULL) return EXIT_FAILURE;
+
+	ok = lin_index_load(&idx, index_path);
+	free(index_path);
+	if(!ok) return EXIT_FAILURE;
+
+	if(lin_index_is_stale(&idx, argv[i])) {
+		fprintf(stderr, "%s: index is out of date, rebuild it\n", argv[i]);
+		lin_index_free(&idx);
+		return EXIT_FAILURE;
+	}
+
+	if(!lincap_open(&cap, argv[i])) {
+		lin_index_free(&idx);
+		return EXIT_FAILURE;
+	}
+
+	ok = lin_index_query(&idx, &cap, &query, (count_only ? NULL : print_match), NULL, &stats);
+
+	if(count_only) printf("%u\n", stats.matches);
+	if(verbose) {
+		fprintf(stderr, "candidates = %u, matches = %u, blocks read = %u of %u\n",
+			stats.candidates, stats.matches, stats.blocks_read, idx.block_count);
+	}
+
+	lincap_close(&cap);
+	lin_index_free(&idx);
+
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+	if(argc >= 2 && strcmp(argv[1], "build") == 0) {
+		return cmd_build(argc - 2, argv + 2);
+	} else if(argc >= 2 && strcmp(argv[1], "query") == 0) {
+		return cmd_query(argc - 2, argv + 2);
+	}
+
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
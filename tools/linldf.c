@@ -0,0 +1,948 @@
+/*******************************************************************************
+ *
+ * linldf.c - LIN description file to frame table compiler
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "lin_checksum.h"
+
+#define NAME_MAX_LEN 64
+#define MAX_NODES 64
+#define MAX_SIGNALS 1024
+#define MAX_FRAMES 64
+#define MAX_FRAME_SIGNALS 64
+#define MAX_SUBSCRIBERS 16
+
+// Frame IDs of the diagnostic frames, which always use the classic checksum.
+#define FID_MASTER_REQ 0x3C
+#define FID_SLAVE_RESP 0x3D
+
+typedef enum {
+	TOK_EOF,
+	TOK_IDENT,
+	TOK_NUMBER,
+	TOK_STRING,
+	TOK_PUNCT,
+} tok_type_t;
+
+typedef struct {
+	tok_type_t type;
+	char text[NAME_MAX_LEN];
+	unsigned int line;
+} token_t;
+
+typedef struct {
+	const char *path;
+	const char *src;
+	size_t pos;
+	unsigned int line;
+	token_t tok; // Current (look-ahead) token
+} lexer_t;
+
+typedef struct {
+	char name[NAME_MAX_LEN];
+	bool classic; // LIN 1.x node
+} node_t;
+
+typedef struct {
+	char name[NAME_MAX_LEN];
+	uint8_t size;
+	bool array; // Byte array, otherwise scalar
+	uint8_t init[8]; // Initial value, little-endian
+	int publisher; // Node index, or -1 for any (diagnostic)
+	int subscribers[MAX_SUBSCRIBERS];
+	unsigned int subscriber_count;
+} signal_t;
+
+typedef struct {
+	char name[NAME_MAX_LEN];
+	uint8_t id;
+	uint8_t len;
+	int publisher;
+	struct {
+		int signal;
+		uint8_t offset;
+	} signals[MAX_FRAME_SIGNALS];
+	unsigned int signal_count;
+} frame_t;
+
+typedef struct {
+	char protocol_version[NAME_MAX_LEN];
+	node_t nodes[MAX_NODES];
+	unsigned int node_count;
+	signal_t signals[MAX_SIGNALS];
+	unsigned int signal_count;
+	frame_t frames[MAX_FRAMES];
+	unsigned int frame_count;
+} ldf_t;
+
+static const char usage_str[] =
+	"Usage: linldf -n <node> [-p <prefix>] [-o <output>] [-d] [-c] <ldf>\n"
+	"\n"
+	"  -n  Node to generate tables for\n"
+	"  -p  Prefix of generated identifiers (default \"ldf\")\n"
+	"  -o  Output path, without extension, of generated .c and .h files\n"
+	"      (default is the prefix)\n"
+	"  -d  Include diagnostic frames (master request and slave response)\n"
+	"  -c  Pack functions also calculate and return the frame's checksum\n";
+
+/******************************************************************************/
+
+static void fatal(const lexer_t *lex, const char *fmt, ...) {
+	va_list args;
+
+	fprintf(stderr, "Error: %s:%u: ", lex->path, lex->tok.line);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+
+	exit(EXIT_FAILURE);
+}
+
+static void next(lexer_t *lex) {
+	// Reads the next token into the look-ahead, skipping whitespace and both
+	// styles of comment.
+	const char *s = lex->src;
+	size_t start, len;
+
+	for(;;) {
+		while(isspace((unsigned char)s[lex->pos])) {
+			if(s[lex->pos] == '\n') lex->line++;
+			lex->pos++;
+		}
+		if(s[lex->pos] == '/' && s[lex->pos + 1] == '/') {
+			while(s[lex->pos] != '\0' && s[lex->pos] != '\n') lex->pos++;
+		} else if(s[lex->pos] == '/' && s[lex->pos + 1] == '*') {
+			lex->pos += 2;
+			while(s[lex->pos] != '\0' && !(s[lex->pos] == '*' && s[lex->pos + 1] == '/')) {
+				if(s[lex->pos] == '\n') lex->line++;
+				lex->pos++;
+			}
+			if(s[lex->pos] != '\0') lex->pos += 2;
+		} else {
+			break;
+		}
+	}
+
+	lex->tok.line = lex->line;
+	start = lex->pos;
+
+	if(s[start] == '\0') {
+		lex->tok.type = TOK_EOF;
+		lex->tok.text[0] = '\0';
+		return;
+	} else if(isalpha((unsigned char)s[start]) || s[start] == '_') {
+		lex->tok.type = TOK_IDENT;
+		while(isalnum((unsigned char)s[lex->pos]) || s[lex->pos] == '_') lex->pos++;
+	} else if(isdigit((unsigned char)s[start]) || (s[start] == '-' && isdigit((unsigned char)s[start + 1]))) {
+		// Includes hex and decimal fractions (e.g. 19.2), which are only
+		// ever skipped over.
+		lex->tok.type = TOK_NUMBER;
+		lex->pos++;
+		while(isalnum((unsigned char)s[lex->pos]) || s[lex->pos] == '.') lex->pos++;
+	} else if(s[start] == '"') {
+		lex->tok.type = TOK_STRING;
+		lex->pos++;
+		start++;
+		while(s[lex->pos] != '\0' && s[lex->pos] != '"' && s[lex->pos] != '\n') lex->pos++;
+		if(s[lex->pos] != '"') fatal(lex, "unterminated string");
+		len = lex->pos - start;
+		lex->pos++;
+		if(len >= NAME_MAX_LEN) fatal(lex, "string too long");
+		memcpy(lex->tok.text, &s[start], len);
+		lex->tok.text[len] = '\0';
+		return;
+	} else {
+		lex->tok.type = TOK_PUNCT;
+		lex->pos++;
+	}
+
+	len = lex->pos - start;
+	if(len >= NAME_MAX_LEN) fatal(lex, "token too long");
+	memcpy(lex->tok.text, &s[start], len);
+	lex->tok.text[len] = '\0';
+}
+
+static bool is_punct(const lexer_t *lex, const char c) {
+	return (lex->tok.type == TOK_PUNCT && lex->tok.text[0] == c);
+}
+
+static void expect_punct(lexer_t *lex, const char c) {
+	if(!is_punct(lex, c)) fatal(lex, "expected '%c' but found '%s'", c, lex->tok.text);
+	next(lex);
+}
+
+static void expect_ident(lexer_t *lex, char *name) {
+	if(lex->tok.type != TOK_IDENT) fatal(lex, "expected name but found '%s'", lex->tok.text);
+	strcpy(name, lex->tok.text);
+	next(lex);
+}
+
+static unsigned long expect_number(lexer_t *lex, const unsigned long max) {
+	unsigned long val;
+	char *end;
+
+	if(lex->tok.type != TOK_NUMBER) fatal(lex, "expected number but found '%s'", lex->tok.text);
+	val = strtoul(lex->tok.text, &end, 0);
+	if(*end != '\0' || val > max) fatal(lex, "invalid number '%s'", lex->tok.text);
+	next(lex);
+
+	return val;
+}
+
+static void skip_statement(lexer_t *lex) {
+	// Skips up to and including the next semicolon or balanced braces at the
+	// current level, whichever comes first.
+	unsigned int depth = 0;
+
+	while(lex->tok.type != TOK_EOF) {
+		if(is_punct(lex, '{')) {
+			depth++;
+		} else if(is_punct(lex, '}')) {
+			if(depth == 0) return;
+			if(--depth == 0) {
+				next(lex);
+				if(is_punct(lex, ';')) next(lex);
+				return;
+			}
+		} else if(is_punct(lex, ';') && depth == 0) {
+			next(lex);
+			return;
+		}
+		next(lex);
+	}
+}
+
+/******************************************************************************/
+
+static int find_node(const ldf_t *ldf, const char *name) {
+	for(unsigned int i = 0; i < ldf->node_count; i++) {
+		if(strcmp(ldf->nodes[i].name, name) == 0) return (int)i;
+	}
+	return -1;
+}
+
+static int find_signal(const ldf_t *ldf, const char *name) {
+	for(unsigned int i = 0; i < ldf->signal_count; i++) {
+		if(strcmp(ldf->signals[i].name, name) == 0) return (int)i;
+	}
+	return -1;
+}
+
+static int expect_node(lexer_t *lex, const ldf_t *ldf) {
+	char name[NAME_MAX_LEN];
+	int node;
+
+	expect_ident(lex, name);
+	if((node = find_node(ldf, name)) < 0) fatal(lex, "unknown node '%s'", name);
+
+	return node;
+}
+
+static void add_node(lexer_t *lex, ldf_t *ldf) {
+	if(ldf->node_count >= MAX_NODES) fatal(lex, "too many nodes");
+	expect_ident(lex, ldf->nodes[ldf->node_count].name);
+	if(find_node(ldf, ldf->nodes[ldf->node_count].name) >= 0) fatal(lex, "duplicate node");
+	ldf->nodes[ldf->node_count++].classic = false;
+}
+
+static void parse_nodes(lexer_t *lex, ldf_t *ldf) {
+	// Master: <name>, <time base>, <jitter>;
+	// Slaves: <name>, ...;
+	// The master is always node index 0.
+	char kind[NAME_MAX_LEN];
+
+	while(!is_punct(lex, '}')) {
+		expect_ident(lex, kind);
+		expect_punct(lex, ':');
+		if(strcmp(kind, "Master") == 0) {
+			if(ldf->node_count != 0) fatal(lex, "master must be given first and only once");
+			add_node(lex, ldf);
+			skip_statement(lex);
+		} else if(strcmp(kind, "Slaves") == 0) {
+			if(ldf->node_count == 0) fatal(lex, "master must be given first and only once");
+			add_node(lex, ldf);
+			while(is_punct(lex, ',')) {
+				next(lex);
+				add_node(lex, ldf);
+			}
+			expect_punct(lex, ';');
+		} else {
+			skip_statement(lex);
+		}
+	}
+}
+
+static void parse_signals(lexer_t *lex, ldf_t *ldf, const bool diagnostic) {
+	// <name>: <size>, <init>, <publisher>, <subscriber>, ...;
+	// <name>: <size>, <init>; (diagnostic)
+	// The initial value is either a scalar or, for byte arrays, a list of
+	// bytes in braces.
+	signal_t *sig;
+	unsigned int n;
+
+	while(!is_punct(lex, '}')) {
+		if(ldf->signal_count >= MAX_SIGNALS) fatal(lex, "too many signals");
+		sig = &ldf->signals[ldf->signal_count];
+		memset(sig, 0, sizeof(*sig));
+		expect_ident(lex, sig->name);
+		if(find_signal(ldf, sig->name) >= 0) fatal(lex, "duplicate signal '%s'", sig->name);
+		expect_punct(lex, ':');
+		sig->size = (uint8_t)expect_number(lex, 64);
+		expect_punct(lex, ',');
+		sig->array = is_punct(lex, '{');
+		if(sig->size == 0 || (sig->array ? sig->size % 8 != 0 : sig->size > 16)) fatal(lex, "invalid size of signal '%s'", sig->name);
+		if(sig->array) {
+			next(lex);
+			for(n = 0; ; n++) {
+				if(n >= sizeof(sig->init)) fatal(lex, "too many initial values");
+				sig->init[n] = (uint8_t)expect_number(lex, 0xFF);
+				if(!is_punct(lex, ',')) break;
+				next(lex);
+			}
+			expect_punct(lex, '}');
+		} else {
+			unsigned long val = expect_number(lex, 0xFFFF);
+			sig->init[0] = (uint8_t)val;
+			sig->init[1] = (uint8_t)(val >> 8);
+		}
+		sig->publisher = -1;
+		if(!diagnostic) {
+			expect_punct(lex, ',');
+			sig->publisher = expect_node(lex, ldf);
+			while(is_punct(lex, ',')) {
+				next(lex);
+				if(sig->subscriber_count >= MAX_SUBSCRIBERS) fatal(lex, "too many subscribers");
+				sig->subscribers[sig->subscriber_count++] = expect_node(lex, ldf);
+			}
+		}
+		expect_punct(lex, ';');
+		ldf->signal_count++;
+	}
+}
+
+static void parse_frames(lexer_t *lex, ldf_t *ldf, const bool diagnostic) {
+	// <name>: <id>, <publisher>, <length> { <signal>, <offset>; ... }
+	// <name>: <id> { <signal>, <offset>; ... } (diagnostic)
+	// Diagnostic frames are 8 bytes, published by the master (request) or
+	// whichever slave is addressed (response).
+	char name[NAME_MAX_LEN];
+	frame_t *frm;
+	uint64_t used, bits;
+	int sig;
+
+	while(!is_punct(lex, '}')) {
+		if(ldf->frame_count >= MAX_FRAMES) fatal(lex, "too many frames");
+		frm = &ldf->frames[ldf->frame_count];
+		memset(frm, 0, sizeof(*frm));
+		expect_ident(lex, frm->name);
+		expect_punct(lex, ':');
+		frm->id = (uint8_t)expect_number(lex, 0x3F);
+		for(unsigned int i = 0; i < ldf->frame_count; i++) {
+			if(ldf->frames[i].id == frm->id) fatal(lex, "frame '%s' has same ID as '%s'", frm->name, ldf->frames[i].name);
+		}
+		if(diagnostic) {
+			frm->publisher = (frm->id == FID_MASTER_REQ ? 0 : -1);
+			frm->len = 8;
+		} else {
+			expect_punct(lex, ',');
+			frm->publisher = expect_node(lex, ldf);
+			expect_punct(lex, ',');
+			frm->len = (uint8_t)expect_number(lex, 8);
+			if(frm->len == 0) fatal(lex, "invalid length of frame '%s'", frm->name);
+		}
+		expect_punct(lex, '{');
+		used = 0;
+		while(!is_punct(lex, '}')) {
+			if(frm->signal_count >= MAX_FRAME_SIGNALS) fatal(lex, "too many signals in frame");
+			expect_ident(lex, name);
+			if((sig = find_signal(ldf, name)) < 0) fatal(lex, "unknown signal '%s'", name);
+			expect_punct(lex, ',');
+			frm->signals[frm->signal_count].signal = sig;
+			frm->signals[frm->signal_count].offset = (uint8_t)expect_number(lex, 63);
+			if(frm->signals[frm->signal_count].offset + ldf->signals[sig].size > frm->len * 8) {
+				fatal(lex, "signal '%s' does not fit in frame '%s'", name, frm->name);
+			}
+			if(ldf->signals[sig].array && frm->signals[frm->signal_count].offset % 8 != 0) {
+				fatal(lex, "byte array signal '%s' is not byte-aligned", name);
+			}
+			bits = (ldf->signals[sig].size < 64 ? (1ULL << ldf->signals[sig].size) - 1 : ~0ULL) << frm->signals[frm->signal_count].offset;
+			if(used & bits) fatal(lex, "signal '%s' overlaps another in frame '%s'", name, frm->name);
+			used |= bits;
+			if(!diagnostic && ldf->signals[sig].publisher != frm->publisher) {
+				fatal(lex, "signal '%s' is not published by publisher of frame '%s'", name, frm->name);
+			}
+			frm->signal_count++;
+			expect_punct(lex, ';');
+		}
+		next(lex);
+		ldf->frame_count++;
+	}
+}
+
+static void parse_node_attributes(lexer_t *lex, ldf_t *ldf) {
+	// <node> { LIN_protocol = "<version>"; ... }
+	// Only the protocol version is of interest, to tell LIN 1.x nodes, which
+	// use the classic checksum.
+	int node;
+
+	while(!is_punct(lex, '}')) {
+		node = expect_node(lex, ldf);
+		expect_punct(lex, '{');
+		while(!is_punct(lex, '}')) {
+			if(lex->tok.type == TOK_EOF) fatal(lex, "unexpected end of file");
+			if(lex->tok.type == TOK_IDENT && strcmp(lex->tok.text, "LIN_protocol") == 0) {
+				next(lex);
+				expect_punct(lex, '=');
+				if(lex->tok.type != TOK_STRING) fatal(lex, "expected protocol version string");
+				ldf->nodes[node].classic = (lex->tok.text[0] == '1');
+				next(lex);
+				expect_punct(lex, ';');
+			} else {
+				skip_statement(lex);
+			}
+		}
+		next(lex);
+	}
+}
+
+static void parse_ldf(lexer_t *lex, ldf_t *ldf, const bool diagnostic) {
+	// Top level consists of '<name> = <value>;' statements and named blocks.
+	// Blocks not needed for the tables (schedules, encodings, etc.) are
+	// skipped over.
+	char name[NAME_MAX_LEN];
+
+	next(lex);
+	while(lex->tok.type != TOK_EOF) {
+		expect_ident(lex, name);
+		if(is_punct(lex, '=')) {
+			next(lex);
+			if(strcmp(name, "LIN_protocol_version") == 0 && lex->tok.type == TOK_STRING) {
+				strcpy(ldf->protocol_version, lex->tok.text);
+			}
+			skip_statement(lex);
+		} else if(is_punct(lex, '{')) {
+			next(lex);
+			if(strcmp(name, "Nodes") == 0) {
+				parse_nodes(lex, ldf);
+			} else if(strcmp(name, "Signals") == 0) {
+				if(ldf->node_count == 0) fatal(lex, "signals given before nodes");
+				parse_signals(lex, ldf, false);
+			} else if(strcmp(name, "Diagnostic_signals") == 0 && diagnostic) {
+				parse_signals(lex, ldf, true);
+			} else if(strcmp(name, "Frames") == 0) {
+				parse_frames(lex, ldf, false);
+			} else if(strcmp(name, "Diagnostic_frames") == 0 && diagnostic) {
+				parse_frames(lex, ldf, true);
+			} else if(strcmp(name, "Node_attributes") == 0) {
+				parse_node_attributes(lex, ldf);
+			} else {
+				while(!is_punct(lex, '}') && lex->tok.type != TOK_EOF) skip_statement(lex);
+			}
+			expect_punct(lex, '}');
+		} else if(is_punct(lex, ';')) {
+			next(lex);
+		} else {
+			fatal(lex, "unexpected '%s'", lex->tok.text);
+		}
+	}
+
+	if(ldf->node_count == 0) fatal(lex, "no nodes defined");
+}
+
+/******************************************************************************/
+
+static bool subscribes(const signal_t *sig, const int node) {
+	// Diagnostic signals have no subscribers listed: everyone takes part.
+	if(sig->publisher < 0) return true;
+	for(unsigned int i = 0; i < sig->subscriber_count; i++) {
+		if(sig->subscribers[i] == node) return true;
+	}
+	return false;
+}
+
+static bool publishes(const frame_t *frm, const int node) {
+	// The slave response diagnostic frame is published by whichever slave is
+	// addressed, so by any slave.
+	return (frm->publisher == node || (frm->publisher < 0 && node != 0));
+}
+
+static bool uses_signal(const ldf_t *ldf, const frame_t *frm, const unsigned int i, const int node) {
+	return (publishes(frm, node) || subscribes(&ldf->signals[frm->signals[i].signal], node));
+}
+
+static bool frame_used(const ldf_t *ldf, const frame_t *frm, const int node) {
+	if(publishes(frm, node)) return true;
+	for(unsigned int i = 0; i < frm->signal_count; i++) {
+		if(subscribes(&ldf->signals[frm->signals[i].signal], node)) return true;
+	}
+	return false;
+}
+
+static bool frame_classic(const ldf_t *ldf, const frame_t *frm) {
+	// Classic if the whole cluster is LIN 1.x, if a diagnostic frame, if the
+	// publisher is a LIN 1.x slave, or if published by the master only for
+	// LIN 1.x slaves.
+	bool any = false, all = true;
+	const signal_t *sig;
+
+	if(ldf->protocol_version[0] == '1' || frm->id >= FID_MASTER_REQ) return true;
+	if(frm->publisher > 0) return ldf->nodes[frm->publisher].classic;
+
+	for(unsigned int i = 0; i < frm->signal_count; i++) {
+		sig = &ldf->signals[frm->signals[i].signal];
+		for(unsigned int j = 0; j < sig->subscriber_count; j++) {
+			any = true;
+			if(!ldf->nodes[sig->subscribers[j]].classic) all = false;
+		}
+	}
+	return (any && all);
+}
+
+static void put_bits(uint8_t *data, const unsigned int offset, const unsigned int size, const uint8_t *val) {
+	for(unsigned int i = 0; i < size; i++) {
+		const unsigned int bit = offset + i;
+		if(val[i / 8] & (1 << (i % 8))) {
+			data[bit / 8] |= (uint8_t)(1 << (bit % 8));
+		} else {
+			data[bit / 8] &= (uint8_t)~(1 << (bit % 8));
+		}
+	}
+}
+
+static void make_ident(char *out, const char *prefix, const char *kind, const char *name) {
+	// Upper-cased, e.g. LDF_FRAME_CEM_FRM1.
+	size_t n = 0;
+
+	for(const char *s = prefix; *s != '\0'; s++) out[n++] = (char)toupper((unsigned char)*s);
+	out[n++] = '_';
+	for(const char *s = kind; *s != '\0'; s++) out[n++] = *s;
+	out[n++] = '_';
+	for(const char *s = name; *s != '\0'; s++) out[n++] = (char)toupper((unsigned char)*s);
+	out[n] = '\0';
+}
+
+static void write_frame_decl(FILE *file, const ldf_t *ldf, const frame_t *frm, const int node, const char *prefix, const bool cksum) {
+	// A structure holding the value of each of the frame's signals used by the
+	// node, and prototype of the function to pack or unpack them.
+	const signal_t *sig;
+
+	fprintf(file, "// Signals of frame %s (ID 0x%02X).\ntypedef struct {\n", frm->name, frm->id);
+	for(unsigned int i = 0; i < frm->signal_count; i++) {
+		if(!uses_signal(ldf, frm, i, node)) continue;
+		sig = &ldf->signals[frm->signals[i].signal];
+		if(sig->array) {
+			fprintf(file, "\tuint8_t %s[%u];\n", sig->name, sig->size / 8);
+		} else {
+			fprintf(file, "\t%s %s;\n", (sig->size > 8 ? "uint16_t" : "uint8_t"), sig->name);
+		}
+	}
+	fprintf(file, "} %s_%s_t;\n\n", prefix, frm->name);
+
+	if(publishes(frm, node)) {
+		fprintf(file, "extern %s %s_pack_%s(const %s_%s_t *s);\n\n", (cksum ? "uint8_t" : "void"), prefix, frm->name, prefix, frm->name);
+	} else {
+		fprintf(file, "extern void %s_unpack_%s(%s_%s_t *s);\n\n", prefix, frm->name, prefix, frm->name);
+	}
+}
+
+static void write_pack(FILE *file, const ldf_t *ldf, const frame_t *frm, const char *prefix, const unsigned int offset, const bool cksum, const uint8_t cksum_pid) {
+	// Each data byte is assembled from the signals overlapping it and written
+	// once, so there is no read-modify-write of the buffer. A signal lying on
+	// byte boundaries is moved whole, and others are shifted and masked into
+	// place. Bits of the value above the signal's size are masked off only
+	// where they would otherwise land in the byte. Unused bits are set.
+	const signal_t *sig;
+	unsigned int lo, hi, width, shift_in, shift_out, terms;
+	uint8_t fill;
+	bool mask;
+
+	fprintf(file, "%s %s_pack_%s(const %s_%s_t *s) {\n", (cksum ? "uint8_t" : "void"), prefix, frm->name, prefix, frm->name);
+	if(cksum) fprintf(file, "\tuint16_t sum = 0x%02X;\n\tuint8_t b;\n\n", cksum_pid);
+
+	for(unsigned int i = 0; i < frm->len; i++) {
+		fprintf(file, (cksum ? "\tb = " : "\t%s_data[%u] = "), prefix, offset + i);
+		fill = 0xFF;
+		terms = 0;
+		for(unsigned int j = 0; j < frm->signal_count; j++) {
+			sig = &ldf->signals[frm->signals[j].signal];
+			lo = frm->signals[j].offset;
+			hi = lo + sig->size;
+			if(hi <= i * 8 || lo >= i * 8 + 8) continue;
+			if(lo < i * 8) lo = i * 8;
+			if(hi > i * 8 + 8) hi = i * 8 + 8;
+			width = hi - lo;
+			shift_in = lo - frm->signals[j].offset;
+			shift_out = lo - i * 8;
+			fill &= (uint8_t)~(((1U << width) - 1) << shift_out);
+
+			if(terms++ > 0) fputs(" | ", file);
+			if(sig->array) {
+				fprintf(file, "s->%s[%u]", sig->name, shift_in / 8);
+				continue;
+			}
+			mask = (width < 8 - shift_out && shift_in + width < (sig->size > 8 ? 16U : 8U));
+			if(shift_out > 0) fputc('(', file);
+			if(mask) fputc('(', file);
+			if(shift_in > 0) fputc('(', file);
+			fprintf(file, "s->%s", sig->name);
+			if(shift_in > 0) fprintf(file, " >> %u)", shift_in);
+			if(mask) fprintf(file, " & 0x%02X)", (1U << width) - 1);
+			if(shift_out > 0) fprintf(file, " << %u)", shift_out);
+		}
+		if(fill != 0 || terms == 0) fprintf(file, "%s0x%02X", (terms > 0 ? " | " : ""), fill);
+		fputs(";\n", file);
+		if(cksum) fprintf(file, "\t%s_data[%u] = b;\n\tsum += b;\n", prefix, offset + i);
+	}
+
+	if(cksum) fputs("\n\tsum = (sum & 0xFF) + (sum >> 8);\n\treturn (uint8_t)~(sum + (sum >> 8));\n", file);
+	fputs("}\n", file);
+}
+
+static void write_unpack(FILE *file, const ldf_t *ldf, const frame_t *frm, const int node, const char *prefix, const unsigned int offset) {
+	// Each signal is assembled from the data bytes it overlaps: a signal lying
+	// on byte boundaries is moved whole, and others are shifted and masked out
+	// of place.
+	const signal_t *sig;
+	unsigned int lo, hi, width, shift_in, shift_out, terms, byte;
+
+	fprintf(file, "void %s_unpack_%s(%s_%s_t *s) {\n", prefix, frm->name, prefix, frm->name);
+
+	for(unsigned int j = 0; j < frm->signal_count; j++) {
+		if(!uses_signal(ldf, frm, j, node)) continue;
+		sig = &ldf->signals[frm->signals[j].signal];
+		if(sig->array) {
+			for(unsigned int i = 0; i < sig->size / 8U; i++) {
+				fprintf(file, "\ts->%s[%u] = %s_data[%u];\n", sig->name, i, prefix, offset + frm->signals[j].offset / 8 + i);
+			}
+			continue;
+		}
+		fprintf(file, "\ts->%s = ", sig->name);
+		terms = 0;
+		for(lo = frm->signals[j].offset; lo < frm->signals[j].offset + sig->size; lo = hi) {
+			byte = lo / 8;
+			hi = byte * 8 + 8;
+			if(hi > frm->signals[j].offset + sig->size) hi = frm->signals[j].offset + sig->size;
+			width = hi - lo;
+			shift_in = lo - byte * 8;
+			shift_out = lo - frm->signals[j].offset;
+
+			if(terms++ > 0) fputs(" | ", file);
+			if(shift_out > 0) fprintf(file, "(%s", (sig->size > 8 ? "(uint16_t)" : ""));
+			if(shift_in + width < 8) fputc('(', file);
+			if(shift_in > 0) fputc('(', file);
+			fprintf(file, "%s_data[%u]", prefix, offset + byte);
+			if(shift_in > 0) fprintf(file, " >> %u)", shift_in);
+			if(shift_in + width < 8) fprintf(file, " & 0x%02X)", (1U << width) - 1);
+			if(shift_out > 0) fprintf(file, " << %u)", shift_out);
+		}
+		fputs(";\n", file);
+	}
+
+	fputs("}\n", file);
+}
+
+static int compare_frame_ids(const void *a, const void *b) {
+	return (int)(*(const frame_t * const *)a)->id - (int)(*(const frame_t * const *)b)->id;
+}
+
+static bool generate(const ldf_t *ldf, const char *ldf_path, const int node, const char *prefix, const char *out_path, const bool cksum) {
+	// Writes the .h and .c files. Only frames the node publishes, or in which
+	// it subscribes to any signal, are included, and of those only signals it
+	// publishes or subscribes to. Frames are in ascending order of ID. Each
+	// frame with any such signals gets a function to pack them, if the node
+	// publishes it, otherwise to unpack them.
+	const frame_t *used[MAX_FRAMES];
+	unsigned int used_signals[MAX_FRAMES];
+	const frame_t *frm;
+	const signal_t *sig;
+	static uint8_t data[MAX_FRAMES * 8];
+	unsigned int used_count = 0, signal_count = 0, data_size = 0, sig_index, offset;
+	char path[1024], ident[NAME_MAX_LEN * 2 + 16], guard[NAME_MAX_LEN + 8];
+	const char *base;
+	FILE *file;
+	bool publish;
+	size_t n;
+
+	for(unsigned int i = 0; i < ldf->frame_count; i++) {
+		if(frame_used(ldf, &ldf->frames[i], node)) used[used_count++] = &ldf->frames[i];
+	}
+	qsort(used, used_count, sizeof(used[0]), compare_frame_ids);
+
+	if((base = strrchr(out_path, '/')) != NULL) base++;
+	else base = out_path;
+	for(n = 0; base[n] != '\0' && n < NAME_MAX_LEN; n++) guard[n] = (isalnum((unsigned char)base[n]) ? (char)toupper((unsigned char)base[n]) : '_');
+	strcpy(&guard[n], "_H__");
+
+	// Header.
+	snprintf(path, sizeof(path), "%s.h", out_path);
+	if((file = fopen(path, "w")) == NULL) {
+		perror(path);
+		return false;
+	}
+	fprintf(file, "// Generated by linldf from %s for node %s. Do not edit.\n\n", ldf_path, ldf->nodes[node].name);
+	fprintf(file, "#ifndef %s\n#define %s\n\n", guard, guard);
+	fprintf(file, "#include <stdint.h>\n#include \"lin_frames.h\"\n\n");
+	for(unsigned int i = 0; i < used_count; i++) {
+		frm = used[i];
+		used_signals[i] = 0;
+		for(unsigned int j = 0; j < frm->signal_count; j++) {
+			if(uses_signal(ldf, frm, j, node)) used_signals[i]++;
+		}
+		signal_count += used_signals[i];
+		data_size += frm->len;
+	}
+	if(data_size > UINT8_MAX || signal_count > UINT8_MAX) {
+		fputs("Error: too many frames or signals for node (tables are indexed by 8-bit values)\n", stderr);
+		fclose(file);
+		return false;
+	}
+	make_ident(ident, prefix, "FRAME", "COUNT");
+	fprintf(file, "#define %s %u\n", ident, used_count);
+	make_ident(ident, prefix, "SIGNAL", "COUNT");
+	fprintf(file, "#define %s %u\n", ident, signal_count);
+	make_ident(ident, prefix, "DATA", "SIZE");
+	fprintf(file, "#define %s %u\n", ident, data_size);
+	make_ident(ident, prefix, "FRAME", "FLAGS_SIZE");
+	fprintf(file, "#define %s %u\n", ident, (used_count > 0 ? (used_count + 7) / 8 : 1));
+	make_ident(ident, prefix, "SIGNAL", "FLAGS_SIZE");
+	fprintf(file, "#define %s %u\n\n", ident, (signal_count > 0 ? (signal_count + 7) / 8 : 1));
+
+	fputs("// Index of each frame in frame table.\n", file);
+	for(unsigned int i = 0; i < used_count; i++) {
+		make_ident(ident, prefix, "FRAME", used[i]->name);
+		fprintf(file, "#define %s %u\n", ident, i);
+	}
+	fputs("\n// Index of each signal in signal table.\n", file);
+	sig_index = 0;
+	for(unsigned int i = 0; i < used_count; i++) {
+		frm = used[i];
+		for(unsigned int j = 0; j < frm->signal_count; j++) {
+			if(!uses_signal(ldf, frm, j, node)) continue;
+			sig = &ldf->signals[frm->signals[j].signal];
+			make_ident(ident, prefix, "SIGNAL", sig->name);
+			fprintf(file, "#define %s %u\n", ident, sig_index++);
+		}
+	}
+	fputc('\n', file);
+	make_ident(ident, prefix, "FRAME", "COUNT");
+	fprintf(file, "extern const lin_frame_def_t %s_frames[%s];\n", prefix, ident);
+	make_ident(ident, prefix, "SIGNAL", "COUNT");
+	fprintf(file, "extern const lin_signal_def_t %s_signals[%s];\n", prefix, ident);
+	make_ident(ident, prefix, "DATA", "SIZE");
+	fprintf(file, "extern uint8_t %s_data[%s];\n", prefix, ident);
+	make_ident(ident, prefix, "FRAME", "FLAGS_SIZE");
+	fprintf(file, "extern uint8_t %s_frame_flags[%s];\n", prefix, ident);
+	make_ident(ident, prefix, "SIGNAL", "FLAGS_SIZE");
+	fprintf(file, "extern uint8_t %s_signal_flags[%s];\n", prefix, ident);
+	fprintf(file, "extern const lin_frame_table_t %s_table;\n\n", prefix);
+	for(unsigned int i = 0; i < used_count; i++) {
+		if(used_signals[i] > 0) write_frame_decl(file, ldf, used[i], node, prefix, cksum);
+	}
+	fprintf(file, "#endif // %s\n", guard);
+	if(fclose(file) != 0) {
+		perror(path);
+		return false;
+	}
+
+	// Source.
+	snprintf(path, sizeof(path), "%s.c", out_path);
+	if((file = fopen(path, "w")) == NULL) {
+		perror(path);
+		return false;
+	}
+	fprintf(file, "// Generated by linldf from %s for node %s. Do not edit.\n\n", ldf_path, ldf->nodes[node].name);
+	fprintf(file, "#include <stdint.h>\n#include \"lin_frames.h\"\n#include \"%s.h\"\n\n", base);
+
+	make_ident(ident, prefix, "FRAME", "COUNT");
+	fprintf(file, "const lin_frame_def_t %s_frames[%s] = {\n", prefix, ident);
+	sig_index = 0;
+	offset = 0;
+	for(unsigned int i = 0; i < used_count; i++) {
+		frm = used[i];
+		publish = publishes(frm, node);
+		n = used_signals[i];
+		fprintf(file, "\t{ 0x%02X, %u, %s, %u, %u, %u }, // %s (ID 0x%02X)\n", lin_get_protected_id(frm->id), frm->len,
+			(frame_classic(ldf, frm) ? (publish ? "LIN_FRAME_FLAG_CLASSIC | LIN_FRAME_FLAG_PUBLISH" : "LIN_FRAME_FLAG_CLASSIC") : (publish ? "LIN_FRAME_FLAG_PUBLISH" : "0")),
+			offset, sig_index, (unsigned int)n, frm->name, frm->id);
+
+		// Unused bits are recessive (1), and signals start at their initial
+		// values.
+		memset(&data[offset], 0xFF, frm->len);
+		for(unsigned int j = 0; j < frm->signal_count; j++) {
+			sig = &ldf->signals[frm->signals[j].signal];
+			put_bits(&data[offset], frm->signals[j].offset, sig->size, sig->init);
+		}
+
+		sig_index += (unsigned int)n;
+		offset += frm->len;
+	}
+	fputs("};\n\n", file);
+
+	make_ident(ident, prefix, "SIGNAL", "COUNT");
+	fprintf(file, "const lin_signal_def_t %s_signals[%s] = {\n", prefix, ident);
+	for(unsigned int i = 0; i < used_count; i++) {
+		frm = used[i];
+		for(unsigned int j = 0; j < frm->signal_count; j++) {
+			if(!uses_signal(ldf, frm, j, node)) continue;
+			sig = &ldf->signals[frm->signals[j].signal];
+			fprintf(file, "\t{ %u, %u }, // %s\n", frm->signals[j].offset, sig->size, sig->name);
+		}
+	}
+	fputs("};\n\n", file);
+
+	make_ident(ident, prefix, "DATA", "SIZE");
+	fprintf(file, "uint8_t %s_data[%s] = {", prefix, ident);
+	for(unsigned int i = 0; i < data_size; i++) {
+		fprintf(file, "%s0x%02X", (i % 8 == 0 ? "\n\t" : " "), data[i]);
+		if(i + 1 < data_size) fputc(',', file);
+	}
+	fputs("\n};\n\n", file);
+
+	make_ident(ident, prefix, "FRAME", "FLAGS_SIZE");
+	fprintf(file, "uint8_t %s_frame_flags[%s];\n", prefix, ident);
+	make_ident(ident, prefix, "SIGNAL", "FLAGS_SIZE");
+	fprintf(file, "uint8_t %s_signal_flags[%s];\n\n", prefix, ident);
+	make_ident(ident, prefix, "FRAME", "COUNT");
+	fprintf(file, "const lin_frame_table_t %s_table = {\n\t%s_frames,\n\t%s_signals,\n\t%s_data,\n\t%s_frame_flags,\n\t%s_signal_flags,\n\t%s\n};\n",
+		prefix, prefix, prefix, prefix, prefix, prefix, ident);
+
+	offset = 0;
+	for(unsigned int i = 0; i < used_count; i++) {
+		frm = used[i];
+		if(used_signals[i] > 0) {
+			fputc('\n', file);
+			if(publishes(frm, node)) {
+				write_pack(file, ldf, frm, prefix, offset, cksum, (frame_classic(ldf, frm) ? 0 : lin_get_protected_id(frm->id)));
+			} else {
+				write_unpack(file, ldf, frm, node, prefix, offset);
+			}
+		}
+		offset += frm->len;
+	}
+	if(fclose(file) != 0) {
+		perror(path);
+		return false;
+	}
+
+	fprintf(stderr, "%u frames, %u signals, %u bytes of data\n", used_count, signal_count, data_size);
+
+	return true;
+}
+
+/******************************************************************************/
+
+static char *read_file(const char *path) {
+	FILE *file;
+	char *buf = NULL;
+	size_t len = 0, cap = 0, n;
+
+	if((file = fopen(path, "r")) == NULL) {
+		perror(path);
+		return NULL;
+	}
+	do {
+		if(cap - len < 4096) {
+			cap = (cap == 0 ? 65536 : cap * 2);
+			if((buf = realloc(buf, cap + 1)) == NULL) {
+				fputs("Error: out of memory\n", stderr);
+				fclose(file);
+				return NULL;
+			}
+		}
+		n = fread(&buf[len], 1, cap - len, file);
+		len += n;
+	} while(n > 0);
+	fclose(file);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+int main(int argc, char *argv[]) {
+	static ldf_t ldf;
+	const char *node_name = NULL, *prefix = "ldf", *out_path = NULL;
+	lexer_t lex;
+	bool diagnostic = false, cksum = false;
+	char *src;
+	int opt, node;
+
+	while((opt = getopt(argc, argv, "n:p:o:dc")) != -1) {
+		switch(opt) {
+			case 'n':
+				node_name = optarg;
+				break;
+			case 'p':
+				prefix = optarg;
+				if(strlen(prefix) >= NAME_MAX_LEN || !(isalpha((unsigned char)*prefix) || *prefix == '_')) goto usage;
+				for(const char *s = prefix; *s != '\0'; s++) {
+					if(!isalnum((unsigned char)*s) && *s != '_') goto usage;
+				}
+				break;
+			case 'o':
+				out_path = optarg;
+				break;
+			case 'd':
+				diagnostic = true;
+				break;
+			case 'c':
+				cksum = true;
+				break;
+			default:
+				goto usage;
+		}
+	}
+	if(optind != argc - 1 || node_name == NULL) goto usage;
+	if(out_path == NULL) out_path = prefix;
+
+	if((src = read_file(argv[optind])) == NULL) return EXIT_FAILURE;
+
+	lex.path = argv[optind];
+	lex.src = src;
+	lex.pos = 0;
+	lex.line = 1;
+	parse_ldf(&lex, &ldf, diagnostic);
+
+	if((node = find_node(&ldf, node_name)) < 0) {
+		fprintf(stderr, "Error: node '%s' not found in %s\n", node_name, argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	free(src);
+
+	return (generate(&ldf, argv[optind], node, prefix, out_path, cksum) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+usage:
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
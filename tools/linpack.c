@@ -0,0 +1,256 @@
+/*******************************************************************************
+ *
+ * linpack.c - LIN capture compression tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lincap.h"
+#include "lin_pack.h"
+
+static const char usage_str[] =
+	"Usage: linpack c <capture> <packed>   Compress a capture\n"
+	"       linpack d <packed> <capture>   Decompress to a capture\n"
+	"       linpack t <capture>            Test round trip and report ratio/speed\n";
+
+/******************************************************************************/
+
+static double elapsed_s(const struct timespec *since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+	FILE *file = fopen(path, "rb");
+	uint8_t *buf = NULL;
+	long size;
+
+	if(file == NULL) {
+		perror(path);
+		return NULL;
+	}
+
+	if(fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+		buf = malloc((size_t)size + 1);
+		if(buf != NULL && fread(buf, 1, (size_t)size, file) != (size_t)size) {
+			free(buf);
+			buf = NULL;
+		}
+		*len = (size_t)size;
+	}
+	if(buf == NULL) perror(path);
+
+	fclose(file);
+
+	return buf;
+}
+
+static int cmd_compress(const char *in_path, const char *out_path) {
+	static lin_pack_state_t st;
+	uint8_t token[LIN_PACK_TOKEN_MAX];
+	lincap_reader_t cap;
+	lincap_frame_t frame;
+	FILE *out;
+	bool ok = true;
+	size_t packed_size = LIN_PACK_HEADER_SIZE, len;
+	uint32_t count = 0;
+
+	if(!lincap_open(&cap, in_path)) return EXIT_FAILURE;
+
+	out = fopen(out_path, "wb");
+	if(out == NULL) {
+		perror(out_path);
+		lincap_close(&cap);
+		return EXIT_FAILURE;
+	}
+
+	// The record count is not known up front when reading from standard
+	// input, so the header is written again with the number of records
+	// actually packed once they have all been read.
+	lin_pack_init(&st);
+	lin_pack_encode_header(token, cap.baud, 0);
+	ok = (fwrite(token, LIN_PACK_HEADER_SIZE, 1, out) == 1);
+
+	while(ok && lincap_read(&cap, &frame)) {
+		len = lin_pack_encode(&st, &frame, token);
+		ok = (fwrite(token, len, 1, out) == 1);
+		packed_size += len;
+		count++;
+	}
+
+	if(ok) {
+		lin_pack_encode_header(token, cap.baud, count);
+		ok = (fseek(out, 0, SEEK_SET) == 0 && fwrite(token, LIN_PACK_HEADER_SIZE, 1, out) == 1);
+	}
+
+	ok = (fclose(out) == 0) && ok;
+	if(!ok) {
+		perror(out_path);
+	} else {
+		fprintf(stderr, "%u records, %zu -> %zu bytes (%.1fx)\n", count,
+			(size_t)LINCAP_HEADER_SIZE + (size_t)count * LINCAP_RECORD_SIZE, packed_size,
+			((double)LINCAP_HEADER_SIZE + (double)count * LINCAP_RECORD_SIZE) / packed_size);
+	}
+
+	lincap_close(&cap);
+
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static int cmd_decompress(const char *in_path, const char *out_path) {
+	static lin_pack_state_t st;
+	lincap_writer_t wr;
+	lincap_frame_t frame;
+	uint32_t baud, count;
+	size_t len, pos, n;
+	uint8_t *buf;
+	bool ok = true;
+
+	if((buf = read_file(in_path, &len)) == NULL) return EXIT_FAILURE;
+
+	if(len < LIN_PACK_HEADER_SIZE || !lin_pack_decode_header(buf, &baud, &count)) {
+		fprintf(stderr, "%s: not a packed LIN capture file\n", in_path);
+		free(buf);
+		return EXIT_FAILURE;
+	}
+
+	if(!lincap_create(&wr, out_path, baud)) {
+		free(buf);
+		return EXIT_FAILURE;
+	}
+
+	lin_pack_init(&st);
+	for(pos = LIN_PACK_HEADER_SIZE; ok && wr.record_count < count; pos += n) {
+		if((n = lin_pack_decode(&st, buf + pos, len - pos, &frame)) == 0) {
+			fprintf(stderr, "%s: corrupt data at offset %zu\n", in_path, pos);
+			ok = false;
+		} else {
+			ok = lincap_write(&wr, &frame);
+		}
+	}
+
+	ok = lincap_finish(&wr) && ok;
+	free(buf);
+
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static bool frames_equal(const lincap_frame_t *a, const lincap_frame_t *b) {
+	return a->time_us == b->time_us && a->resp_delay_us == b->resp_delay_us && a->pid == b->pid
+		&& a->data_len == b->data_len && memcmp(a->data, b->data, a->data_len) == 0
+		&& a->cksum == b->cksum && a->flags == b->flags;
+}
+
+static int cmd_test(const char *in_path) {
+	// Runs the encoder and decoder entirely in memory, so that the speeds
+	// reported are those of the codec alone. Decoding is repeated enough times
+	// to give a stable figure.
+	const unsigned int decode_passes = 10;
+	static lin_pack_state_t st;
+	lincap_reader_t cap;
+	lincap_frame_t *frames = NULL, *grown, frame;
+	uint8_t *packed = NULL;
+	size_t packed_len = 0, raw_len, pos, n, capacity = 0;
+	struct timespec t0;
+	double enc_s, dec_s;
+	uint32_t i = 0, bad = 0;
+	bool ok = true;
+
+	if(!lincap_open(&cap, in_path)) return EXIT_FAILURE;
+
+	// Frames are read into an array grown as needed, rather than one sized by
+	// the record count, because that is not known when reading standard input.
+	while(ok && lincap_read(&cap, &frame)) {
+		if(i == capacity) {
+			capacity = (capacity > 0 ? capacity * 2 : 4096);
+			grown = realloc(frames, capacity * sizeof(lincap_frame_t));
+			if(grown == NULL) {
+				ok = false;
+				break;
+			}
+			frames = grown;
+		}
+		frames[i++] = frame;
+	}
+	if(ok) ok = ((packed = malloc(((size_t)i + 1) * LIN_PACK_TOKEN_MAX)) != NULL);
+	if(!ok) {
+		fputs("out of memory\n", stderr);
+		lincap_close(&cap);
+		free(frames);
+		free(packed);
+		return EXIT_FAILURE;
+	}
+
+	raw_len = (size_t)i * LINCAP_RECORD_SIZE;
+
+	lin_pack_init(&st);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(uint32_t j = 0; j < i; j++) packed_len += lin_pack_encode(&st, &frames[j], packed + packed_len);
+	enc_s = elapsed_s(&t0);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(unsigned int pass = 0; pass < decode_passes; pass++) {
+		lin_pack_init(&st);
+		pos = 0;
+		for(uint32_t j = 0; j < i; j++) {
+			n = lin_pack_decode(&st, packed + pos, packed_len - pos, &frame);
+			if(n == 0 || !frames_equal(&frame, &frames[j])) {
+				bad++;
+				break;
+			}
+			pos += n;
+		}
+	}
+	dec_s = elapsed_s(&t0) / decode_passes;
+
+	printf("records = %u, raw = %zu bytes, packed = %zu bytes, ratio = %.1fx\n", i, raw_len, packed_len,
+		(packed_len > 0 ? (double)raw_len / packed_len : 0.0));
+	printf("encode = %.1f MB/s, decode = %.1f MB/s, round trip %s\n", raw_len / enc_s / 1e6, raw_len / dec_s / 1e6,
+		(bad == 0 ? "OK" : "FAILED"));
+
+	lincap_close(&cap);
+	free(frames);
+	free(packed);
+
+	return (bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+	if(argc == 4 && strcmp(argv[1], "c") == 0) {
+		return cmd_compress(argv[2], argv[3]);
+	} else if(argc == 4 && strcmp(argv[1], "d") == 0) {
+		return cmd_decompress(argv[2], argv[3]);
+	} else if(argc == 3 && strcmp(argv[1], "t") == 0) {
+		return cmd_test(argv[2]);
+	}
+
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ *
+ * linstat.c - LIN capture bus load and timing statistics tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lincap.h"
+#include "lin_analyze.h"
+
+static const char usage_str[] =
+	"Usage: linstat [-w <window_us>] [-W] [-e] <capture>\n"
+	"\n"
+	"  -w  Length of bus load windows in microseconds (default 1000000)\n"
+	"  -W  Output load and error count of each window as it completes\n"
+	"  -e  Output each frame that fails verification\n"
+	"\n"
+	"A capture of \"-\" reads from standard input.\n";
+
+/******************************************************************************/
+
+static void print_window(const lin_analyze_window_t *window, void *ctx) {
+	(void)ctx;
+	printf("window %llu: load = %.1f%%, frames = %u, errors = %u%s\n", (unsigned long long)window->start_us,
+		100.0 * window->busy_us / window->length_us, window->frames, window->errors, (window->partial ? " (partial)" : ""));
+}
+
+int main(int argc, char *argv[]) {
+	static lin_analyze_t an;
+	unsigned long long window_us = LIN_ANALYZE_DEFAULT_WINDOW_US;
+	bool print_windows = false, print_errors = false;
+	char line[LINCAP_FORMAT_MAX];
+	lincap_reader_t cap;
+	lincap_frame_t frame;
+	char *end;
+	int opt;
+
+	while((opt = getopt(argc, argv, "w:We")) != -1) {
+		switch(opt) {
+			case 'w':
+				window_us = strtoull(optarg, &end, 0);
+				if(*end != '\0' || window_us == 0) {
+					fputs(usage_str, stderr);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'W': print_windows = true; break;
+			case 'e': print_errors = true; break;
+			default:
+				fputs(usage_str, stderr);
+				return EXIT_FAILURE;
+		}
+	}
+	if(optind != argc - 1) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	if(!lincap_open(&cap, argv[optind])) return EXIT_FAILURE;
+
+	lin_analyze_init(&an, cap.baud, window_us, (print_windows ? print_window : NULL), NULL);
+
+	while(lincap_read(&cap, &frame)) {
+		if(lin_analyze_frame(&an, &frame) != LINCAP_STATUS_OK && print_errors) {
+			lincap_format_frame(line, &frame, lincap_frame_verify(&frame));
+			fputs(line, stdout);
+		}
+	}
+	lin_analyze_finish(&an);
+
+	if(print_windows || print_errors) putchar('\n');
+	lin_analyze_report(&an, stdout);
+
+	lincap_close(&cap);
+
+	return EXIT_SUCCESS;
+}
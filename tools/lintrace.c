@@ -0,0 +1,116 @@
+/*******************************************************************************
+ *
+ * lintrace.c - LIN event trace decoding tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lin_trace_decode.h"
+
+static const char usage_str[] =
+	"Usage: lintrace [-c <clock_hz>] <file>\n"
+	"\n"
+	"  -c  Frequency of the timer clock, to give times in microseconds rather\n"
+	"      than timer ticks\n"
+	"\n"
+	"Every trace dump found in the file is decoded. A file of \"-\" reads from\n"
+	"standard input.\n";
+
+/******************************************************************************/
+
+static void print_time(const uint64_t ticks, const double clock_hz) {
+	if(clock_hz > 0) {
+		printf(" %14.3f", ticks * 1e6 / clock_hz);
+	} else {
+		printf(" %14llu", (unsigned long long)ticks);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	FILE *in;
+	lin_trace_decoder_t dec;
+	lin_trace_event_t ev;
+	char type[16], status[16];
+	double clock_hz = 0;
+	uint16_t lost;
+	uint8_t count;
+	char *end;
+	int opt;
+
+	while((opt = getopt(argc, argv, "c:")) != -1) {
+		switch(opt) {
+			case 'c':
+				clock_hz = strtod(optarg, &end);
+				if(*end != '\0' || clock_hz <= 0) {
+					fputs(usage_str, stderr);
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				fputs(usage_str, stderr);
+				return EXIT_FAILURE;
+		}
+	}
+	if(optind != argc - 1) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	if(strcmp(argv[optind], "-") == 0) {
+		in = stdin;
+	} else if((in = fopen(argv[optind], "rb")) == NULL) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	lin_trace_decode_init(&dec, in);
+	while(lin_trace_decode_dump(&dec, &lost, &count)) {
+		printf("# Dump %u: %u records, %u lost\n", dec.dumps, count, lost);
+		printf("# %14s %14s  %-12s  %-4s  %s\n", (clock_hz > 0 ? "time (us)" : "time"), (clock_hz > 0 ? "delta (us)" : "delta"), "event", "pid", "status");
+
+		for(uint8_t i = 0; i < count; i++) {
+			if(!lin_trace_decode_event(&dec, &ev)) {
+				fprintf(stderr, "dump %u truncated\n", dec.dumps);
+				break;
+			}
+			lin_trace_format_type(type, sizeof(type), ev.type);
+			lin_trace_format_status(status, sizeof(status), ev.type, ev.status);
+			putchar(' ');
+			print_time(ev.time, clock_hz);
+			print_time(ev.delta, clock_hz);
+			printf("  %-12s  0x%02X  %s\n", type, ev.pid, status);
+		}
+	}
+
+	fprintf(stderr, "%u dumps, %u records, %u lost\n", dec.dumps, dec.records, dec.lost_total);
+
+	if(in != stdin) fclose(in);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+/*******************************************************************************
+ *
+ * linvec.c - LIN checksum test vector generation and checking tool
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lin_checksum.h"
+
+// Vector record format, as read by the test program in vector mode. The flags
+// byte gives the data length in its low nibble, plus the checksum type. It is
+// followed by the protected ID, the data bytes, and the expected checksum.
+#define VECTOR_LEN_MASK 0x0F
+#define VECTOR_FLAG_CLASSIC 0x80
+#define VECTOR_MAX_SIZE (1 + 1 + 8 + 1)
+
+typedef struct {
+	uint8_t flags;
+	uint8_t pid;
+	uint8_t data[8];
+	uint8_t cksum;
+} vector_t;
+
+static const char usage_str[] =
+	"Usage: linvec gen [-n <count>] [-s <seed>] [-C | -E] <vectors>\n"
+	"       linvec run <vectors> <results>\n"
+	"       linvec check [-v] <vectors> <results>\n"
+	"\n"
+	"  gen    Generate random vectors, with checksums from a reference model\n"
+	"  run    Verify vectors with the host-compiled library, writing results as\n"
+	"         the test program does\n"
+	"  check  Compare results from the test program against vectors\n"
+	"\n"
+	"  -n  Number of vectors to generate (default 100000)\n"
+	"  -s  Seed for random generation (default 1)\n"
+	"  -C  Generate only classic checksum vectors\n"
+	"  -E  Generate only enhanced checksum vectors\n"
+	"  -v  Output every failed vector\n";
+
+/******************************************************************************/
+
+static uint32_t prng_next(uint32_t *state) {
+	// Xorshift32; the state must never be zero.
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return (*state = x);
+}
+
+static uint8_t reference_checksum(const vector_t *vec) {
+	// Deliberately implemented differently from the library: the whole sum is
+	// accumulated first and the carries folded back in afterwards.
+	const uint8_t len = vec->flags & VECTOR_LEN_MASK;
+	uint32_t sum = (vec->flags & VECTOR_FLAG_CLASSIC ? 0 : vec->pid);
+
+	for(uint8_t i = 0; i < len; i++) sum += vec->data[i];
+	while(sum > 0xFF) sum = (sum & 0xFF) + (sum >> 8);
+
+	return (uint8_t)~sum;
+}
+
+static size_t encode_vector(uint8_t *buf, const vector_t *vec) {
+	const uint8_t len = vec->flags & VECTOR_LEN_MASK;
+	size_t n = 0;
+
+	buf[n++] = vec->flags;
+	buf[n++] = vec->pid;
+	memcpy(&buf[n], vec->data, len);
+	n += len;
+	buf[n++] = vec->cksum;
+
+	return n;
+}
+
+static bool read_vector(FILE *file, vector_t *vec, bool *bad) {
+	// Returns false at the end of the file, with bad set if it is malformed
+	// or truncated rather than ending cleanly after the last vector.
+	int c;
+	uint8_t len;
+
+	*bad = false;
+	if((c = fgetc(file)) == EOF) return false;
+	vec->flags = (uint8_t)c;
+	len = vec->flags & VECTOR_LEN_MASK;
+	if(len > 8) {
+		fputs("Error: malformed vector\n", stderr);
+		*bad = true;
+		return false;
+	}
+	if(fread(&vec->pid, 1, 1, file) != 1 || fread(vec->data, 1, len, file) != len || fread(&vec->cksum, 1, 1, file) != 1) {
+		fputs("Error: truncated vector\n", stderr);
+		*bad = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void generate_vector(vector_t *vec, uint32_t *state, const int mode) {
+	// Some vectors have data biased towards extreme byte values, so that long
+	// runs of carries (and none at all) are well represented.
+	static const uint8_t extremes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+	const uint32_t r = prng_next(state);
+	const bool biased = ((r >> 8) & 0x3) == 0;
+	const uint8_t len = (uint8_t)((r >> 12) % 9);
+	bool classic;
+
+	switch(mode) {
+		case 'C': classic = true; break;
+		case 'E': classic = false; break;
+		default: classic = (r >> 10) & 1; break;
+	}
+
+	vec->flags = len | (classic ? VECTOR_FLAG_CLASSIC : 0);
+	vec->pid = (uint8_t)(r >> 24);
+	memset(vec->data, 0, sizeof(vec->data));
+	for(uint8_t i = 0; i < len; i++) {
+		const uint32_t d = prng_next(state);
+		vec->data[i] = (biased ? extremes[(d >> 8) % sizeof(extremes)] : (uint8_t)(d >> 24));
+	}
+	vec->cksum = reference_checksum(vec);
+}
+
+static int cmd_gen(int argc, char *argv[]) {
+	unsigned long count = 100000, seed = 1;
+	uint8_t buf[VECTOR_MAX_SIZE];
+	uint32_t state;
+	vector_t vec;
+	FILE *out;
+	int opt, mode = 0;
+	char *end;
+
+	while((opt = getopt(argc, argv, "n:s:CE")) != -1) {
+		switch(opt) {
+			case 'n':
+				count = strtoul(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 's':
+				seed = strtoul(optarg, &end, 0);
+				if(*end != '\0') goto usage;
+				break;
+			case 'C':
+			case 'E':
+				mode = opt;
+				break;
+			default:
+				goto usage;
+		}
+	}
+	if(optind != argc - 1) goto usage;
+
+	if((out = fopen(argv[optind], "wb")) == NULL) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	state = (uint32_t)seed;
+	if(state == 0) state = 1;
+	for(unsigned long i = 0; i < count; i++) {
+		generate_vector(&vec, &state, mode);
+		fwrite(buf, 1, encode_vector(buf, &vec), out);
+	}
+
+	if(fclose(out) != 0) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%lu vectors written\n", count);
+
+	return EXIT_SUCCESS;
+
+usage:
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
+
+static bool vector_pass(const vector_t *vec) {
+	const uint8_t len = vec->flags & VECTOR_LEN_MASK;
+
+	if(vec->flags & VECTOR_FLAG_CLASSIC) {
+		return (lin_calculate_checksum_classic(vec->data, len) == vec->cksum && lin_verify_checksum_classic(vec->cksum, vec->data, len));
+	} else {
+		return (lin_calculate_checksum_enhanced(vec->pid, vec->data, len) == vec->cksum && lin_verify_checksum_enhanced(vec->cksum, vec->pid, vec->data, len));
+	}
+}
+
+static int cmd_run(int argc, char *argv[]) {
+	uint32_t count = 0, failed = 0;
+	uint8_t out_byte = 0;
+	bool bad;
+	vector_t vec;
+	FILE *in, *out;
+
+	if(argc != 3) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	if((in = fopen(argv[1], "rb")) == NULL) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	if((out = fopen(argv[2], "wb")) == NULL) {
+		perror(argv[2]);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	while(read_vector(in, &vec, &bad)) {
+		if(vector_pass(&vec)) {
+			out_byte |= 1 << (count % 8);
+		} else {
+			failed++;
+		}
+		if(++count % 8 == 0) {
+			fputc(out_byte, out);
+			out_byte = 0;
+		}
+	}
+	if(count % 8 != 0) fputc(out_byte, out);
+
+	fclose(in);
+	fclose(out);
+
+	printf("vectors = %u, passed = %u, failed = %u\n", count, count - failed, failed);
+
+	return (failed == 0 && !bad ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static int cmd_check(int argc, char *argv[]) {
+	uint32_t count = 0, failed = 0, ref_failed = 0;
+	bool verbose = false, bad, pass;
+	int opt, res_byte = 0;
+	vector_t vec;
+	FILE *in, *res;
+
+	while((opt = getopt(argc, argv, "v")) != -1) {
+		if(opt != 'v') {
+			fputs(usage_str, stderr);
+			return EXIT_FAILURE;
+		}
+		verbose = true;
+	}
+	if(optind != argc - 2) {
+		fputs(usage_str, stderr);
+		return EXIT_FAILURE;
+	}
+
+	if((in = fopen(argv[optind], "rb")) == NULL) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+	if((res = fopen(argv[optind + 1], "rb")) == NULL) {
+		perror(argv[optind + 1]);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	while(read_vector(in, &vec, &bad)) {
+		if(count % 8 == 0 && (res_byte = fgetc(res)) == EOF) {
+			fprintf(stderr, "Error: results end after %u vectors\n", count);
+			bad = true;
+			break;
+		}
+		pass = (res_byte >> (count % 8)) & 1;
+
+		// Vectors whose expected checksum disagrees with the reference model
+		// are a problem with the vector file rather than the target.
+		if(vec.cksum != reference_checksum(&vec)) ref_failed++;
+
+		if(!pass) {
+			failed++;
+			if(verbose) {
+				printf("%u: %s pid = 0x%02X, len = %u, data =", count, (vec.flags & VECTOR_FLAG_CLASSIC ? "classic" : "enhanced"), vec.pid, vec.flags & VECTOR_LEN_MASK);
+				for(uint8_t i = 0; i < (vec.flags & VECTOR_LEN_MASK); i++) printf(" %02X", vec.data[i]);
+				printf(", expected = 0x%02X\n", vec.cksum);
+			}
+		}
+		count++;
+	}
+	if(!bad && fgetc(res) != EOF) {
+		fprintf(stderr, "Error: results continue after %u vectors\n", count);
+		bad = true;
+	}
+
+	fclose(in);
+	fclose(res);
+
+	printf("vectors = %u, passed = %u, failed = %u", count, count - failed, failed);
+	if(ref_failed > 0) printf(" (%u vectors disagree with reference model)", ref_failed);
+	putchar('\n');
+
+	return (failed == 0 && ref_failed == 0 && !bad ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+	if(argc >= 2 && strcmp(argv[1], "gen") == 0) return cmd_gen(argc - 1, argv + 1);
+	if(argc >= 2 && strcmp(argv[1], "run") == 0) return cmd_run(argc - 1, argv + 1);
+	if(argc >= 2 && strcmp(argv[1], "check") == 0) return cmd_check(argc - 1, argv + 1);
+
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
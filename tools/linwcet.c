@@ -0,0 +1,390 @@
+/*******************************************************************************
+ *
+ * linwcet.c - Worst-case execution time report for compiled LIN library
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lin_checksum.h"
+#include "stm8emu.h"
+
+// RAM locations of function arguments passed by reference.
+#define DATA_ADDR 0x0100
+#define FID_OUT_ADDR 0x00F0
+#define FAR_PTR_ADDR 0x00E0
+
+// Flash location of data for far functions (as for linemu).
+#define FAR_DATA_ADDR 0x1FFFC
+
+#define MAX_STEPS_PER_CALL 10000
+#define MAX_LEN 255
+
+// Data length at which a total is given in the report, being the longest LIN
+// frame.
+#define REPORT_LEN 8
+
+// Inputs for the cross-check, which must match those used by the test
+// program's benchmark of library functions. Protected ID functions are
+// checked at whatever arguments it gives.
+#define REF_DATA 0xFF
+#define REF_PID 0x80
+#define REF_CKSUM 0x55
+
+typedef enum {
+	FN_CLASSIC,
+	FN_ENHANCED,
+	FN_VERIFY_CLASSIC,
+	FN_VERIFY_ENHANCED,
+	FN_GET_PID,
+	FN_VERIFY_PID,
+	FN_CLASSIC_FAR,
+	FN_ENHANCED_FAR,
+	FN_VERIFY_CLASSIC_FAR,
+	FN_VERIFY_ENHANCED_FAR,
+	FN_COUNT
+} fn_t;
+
+// Bytes of arguments each function has passed on the stack.
+static const uint8_t fn_stack_args[FN_COUNT] = { 0, 1, 1, 4, 0, 0, 0, 1, 1, 4 };
+
+static const char *fn_names[FN_COUNT] = {
+	"lin_calculate_checksum_classic",
+	"lin_calculate_checksum_enhanced",
+	"lin_verify_checksum_classic",
+	"lin_verify_checksum_enhanced",
+	"lin_get_protected_id",
+	"lin_verify_protected_id",
+	"lin_calculate_checksum_classic_far",
+	"lin_calculate_checksum_enhanced_far",
+	"lin_verify_checksum_classic_far",
+	"lin_verify_checksum_enhanced_far",
+};
+
+typedef struct {
+	stm8emu_t *emu;
+	uint32_t fn_addr[FN_COUNT];
+	bool large;
+	uint64_t rng;
+	unsigned int stack_max;
+} harness_t;
+
+typedef struct {
+	// Worst case over all inputs tried (only the first for functions without
+	// data), and for the reference input, at each data length. Functions
+	// without data instead have the latter for each argument value.
+	uint32_t worst[MAX_LEN + 1];
+	uint32_t ref[MAX_LEN + 1];
+	// Greatest stack depth below the arguments, including return address.
+	unsigned int stack;
+} timing_t;
+
+static const char usage_str[] =
+	"Usage: linwcet [-m <model>] [-w <wait_states>] [-b <bench_log>] <image.ihx> [<image.map>]\n"
+	"\n"
+	"  -m  Memory model the image was compiled for, 'medium' (default) or 'large'\n"
+	"  -w  Greatest number of flash wait states to report for (default 1)\n"
+	"  -b  Cross-check against simulator output of test program built with BENCH=1\n"
+	"\n"
+	"The map file defaults to the image path with a .map extension.\n";
+
+/******************************************************************************/
+
+static uint8_t rand8(harness_t *h) {
+	// xorshift64
+	h->rng ^= h->rng << 13;
+	h->rng ^= h->rng >> 7;
+	h->rng ^= h->rng << 17;
+	return (uint8_t)h->rng;
+}
+
+static uint32_t call(harness_t *h, const fn_t fn, const uint8_t a, const uint16_t x, const uint8_t *stack_args, const uint8_t stack_len) {
+	// Returns the cycles taken from the function's first instruction up to
+	// and including its return. Also keeps track of the deepest stack.
+	const uint64_t start = h->emu->cycles;
+	unsigned int depth;
+	const stm8emu_status_t status = stm8emu_call(h->emu, h->fn_addr[fn], h->large, a, x, stack_args, stack_len, MAX_STEPS_PER_CALL);
+
+	if(status != STM8EMU_OK) {
+		fprintf(stderr, "Error: %s: %s (pc = 0x%06X)\n", fn_names[fn], stm8emu_status_str(status), h->emu->fault_pc);
+		exit(EXIT_FAILURE);
+	}
+
+	depth = (unsigned int)(STM8EMU_CALL_STACK_TOP - stack_len - h->emu->sp_low);
+	if(depth > h->stack_max) h->stack_max = depth;
+
+	return (uint32_t)(h->emu->cycles - start);
+}
+
+static bool is_far(const fn_t fn) {
+	return (fn >= FN_CLASSIC_FAR);
+}
+
+static uint32_t call_checksum(harness_t *h, const fn_t fn, const uint8_t cksum, const uint8_t pid, const uint8_t len) {
+	// Data must already be in place at DATA_ADDR, or FAR_DATA_ADDR for far
+	// functions, which take a pointer to its address instead. Far functions
+	// take the same arguments as their near equivalents.
+	const uint16_t data_arg = (is_far(fn) ? FAR_PTR_ADDR : DATA_ADDR);
+	uint8_t stack[4];
+
+	switch(is_far(fn) ? fn - (FN_CLASSIC_FAR - FN_CLASSIC) : fn) {
+		case FN_CLASSIC:
+			return call(h, fn, len, data_arg, NULL, 0);
+		case FN_ENHANCED:
+			stack[0] = len;
+			return call(h, fn, pid, data_arg, stack, 1);
+		case FN_VERIFY_CLASSIC:
+			stack[0] = len;
+			return call(h, fn, cksum, data_arg, stack, 1);
+		default:
+			stack[0] = pid;
+			stack[1] = data_arg >> 8;
+			stack[2] = data_arg & 0xFF;
+			stack[3] = len;
+			return call(h, fn, cksum, 0, stack, 4);
+	}
+}
+
+static void measure_checksum(harness_t *h, const fn_t fn, timing_t *t) {
+	// The worst case at each length is taken over data of all zeroes, all
+	// ones, and random, with several PIDs, and with checksums that both pass
+	// and fail verification.
+	static const uint8_t pids[] = { 0x00, REF_PID, 0xFF };
+	uint8_t *data = &h->emu->mem[is_far(fn) ? FAR_DATA_ADDR : DATA_ADDR];
+	uint8_t cksum[3];
+	uint32_t cycles;
+
+	h->stack_max = 0;
+	for(unsigned int len = 0; len <= MAX_LEN; len++) {
+		t->worst[len] = 0;
+		for(unsigned int pattern = 0; pattern < 3; pattern++) {
+			for(unsigned int i = 0; i < len; i++) data[i] = (pattern == 0 ? 0x00 : (pattern == 1 ? 0xFF : rand8(h)));
+			for(size_t p = 0; p < sizeof(pids); p++) {
+				cksum[0] = (fn == FN_VERIFY_CLASSIC || fn == FN_VERIFY_CLASSIC_FAR ? lin_calculate_checksum_classic(data, (uint8_t)len) : lin_calculate_checksum_enhanced(pids[p], data, (uint8_t)len));
+				cksum[1] = cksum[0] + 1;
+				cksum[2] = REF_CKSUM;
+				for(size_t c = 0; c < sizeof(cksum); c++) {
+					cycles = call_checksum(h, fn, cksum[c], pids[p], (uint8_t)len);
+					if(cycles > t->worst[len]) t->worst[len] = cycles;
+				}
+			}
+		}
+
+		memset(data, REF_DATA, len);
+		t->ref[len] = call_checksum(h, fn, REF_CKSUM, REF_PID, (uint8_t)len);
+	}
+	t->stack = h->stack_max;
+}
+
+static void measure_pid(harness_t *h, const fn_t fn, timing_t *t) {
+	// Every possible argument value is tried.
+	uint32_t cycles;
+
+	h->stack_max = 0;
+	t->worst[0] = 0;
+	for(unsigned int b = 0; b <= 0xFF; b++) {
+		cycles = call(h, fn, (uint8_t)b, FID_OUT_ADDR, NULL, 0);
+		if(cycles > t->worst[0]) t->worst[0] = cycles;
+		t->ref[b] = cycles;
+	}
+	t->stack = h->stack_max;
+}
+
+static void print_timing(const fn_t fn, const uint8_t wait_states, const timing_t *t) {
+	// For functions taking data, the cost is given as a closed form of data
+	// length, provided every length fits it. Zero length is given separately
+	// as it usually takes an early exit.
+	const int32_t per_byte = (int32_t)t->worst[2] - (int32_t)t->worst[1];
+	const int32_t fixed = (int32_t)t->worst[1] - per_byte;
+	uint32_t max = 0;
+	bool linear = true;
+	char form[32];
+
+	if(fn == FN_GET_PID || fn == FN_VERIFY_PID) {
+		printf("%-36s %4u %8s %20u %8s %5u %5u\n", fn_names[fn], wait_states, "-", t->worst[0], "-", fn_stack_args[fn], t->stack);
+		return;
+	}
+
+	for(unsigned int len = 1; len <= MAX_LEN; len++) {
+		if(t->worst[len] != (uint32_t)(fixed + per_byte * (int32_t)len)) linear = false;
+		if(t->worst[len] > max) max = t->worst[len];
+	}
+
+	if(linear) {
+		snprintf(form, sizeof(form), "%d + %d * len", fixed, per_byte);
+	} else {
+		snprintf(form, sizeof(form), "<= %u (non-linear)", max);
+	}
+	printf("%-36s %4u %8u %20s %8u %5u %5u\n", fn_names[fn], wait_states, t->worst[0], form, t->worst[REPORT_LEN], fn_stack_args[fn], t->stack);
+}
+
+static bool cross_check(const char *path, const timing_t *timings) {
+	// The measured cycles include the calling code's overhead, which must be
+	// the same for every data length if the per-byte cost was predicted right,
+	// or for protected ID functions, for every argument. A single measurement
+	// can't show anything. Returns whether everything agreed.
+	char line[256], name[64], kind[4];
+	unsigned int val, measured;
+	int32_t overhead[FN_COUNT], diff;
+	unsigned int count[FN_COUNT] = { 0 };
+	bool mismatch[FN_COUNT] = { false };
+	bool ok = true;
+	FILE *file;
+	size_t fn;
+
+	if((file = fopen(path, "r")) == NULL) {
+		perror(path);
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		if(sscanf(line, "CYCLES: %63s %3s = %u: %u", name, kind, &val, &measured) != 4 || val > MAX_LEN) continue;
+		for(fn = 0; fn < FN_COUNT && strcmp(name, fn_names[fn]) != 0; fn++);
+		if(fn == FN_COUNT) continue;
+		if(strcmp(kind, (fn == FN_GET_PID || fn == FN_VERIFY_PID ? "arg" : "len")) != 0) continue;
+
+		diff = (int32_t)measured - (int32_t)timings[fn].ref[val];
+		if(count[fn] == 0) {
+			overhead[fn] = diff;
+		} else if(diff != overhead[fn] && !mismatch[fn]) {
+			printf("%-36s MISMATCH at %s = %u: measured %u, predicted %u + %d overhead\n", fn_names[fn], kind, val, measured,
+				timings[fn].ref[val], overhead[fn]);
+			mismatch[fn] = true;
+		}
+		count[fn]++;
+	}
+	fclose(file);
+
+	for(fn = 0; fn < FN_COUNT; fn++) {
+		if(count[fn] == 0) {
+			printf("%-36s NOT MEASURED\n", fn_names[fn]);
+			ok = false;
+		} else if(count[fn] == 1) {
+			printf("%-36s NOT CROSS-CHECKED (1 measured)\n", fn_names[fn]);
+			ok = false;
+		} else if(mismatch[fn]) {
+			ok = false;
+		} else {
+			printf("%-36s OK (%u measured, call overhead = %d)\n", fn_names[fn], count[fn], overhead[fn]);
+		}
+	}
+
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	static harness_t h;
+	static timing_t timings[FN_COUNT], t;
+	stm8emu_symtab_t symtab;
+	unsigned long max_wait = 1;
+	const char *bench_path = NULL;
+	char map_path[1024], report_col[16], *end, *dot;
+	bool ok = true;
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:w:b:")) != -1) {
+		switch(opt) {
+			case 'm':
+				if(strcmp(optarg, "large") == 0) h.large = true;
+				else if(strcmp(optarg, "medium") != 0) goto usage;
+				break;
+			case 'w':
+				max_wait = strtoul(optarg, &end, 0);
+				if(*end != '\0' || max_wait > 0xFF) goto usage;
+				break;
+			case 'b':
+				bench_path = optarg;
+				break;
+			default:
+				goto usage;
+		}
+	}
+	if(optind != argc - 1 && optind != argc - 2) goto usage;
+
+	if(optind == argc - 2) {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind + 1]);
+	} else {
+		snprintf(map_path, sizeof(map_path), "%s", argv[optind]);
+		if((dot = strrchr(map_path, '.')) != NULL && strchr(dot, '/') == NULL) *dot = '\0';
+		strncat(map_path, ".map", sizeof(map_path) - strlen(map_path) - 1);
+	}
+
+	if((h.emu = calloc(1, sizeof(*h.emu))) == NULL) {
+		fputs("Error: out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if(!stm8emu_load_ihx(h.emu, argv[optind])) return EXIT_FAILURE;
+	if(!stm8emu_load_map(&symtab, map_path)) return EXIT_FAILURE;
+	for(size_t i = 0; i < FN_COUNT; i++) {
+		if(!stm8emu_symbol_addr(&symtab, fn_names[i], &h.fn_addr[i])) {
+			fprintf(stderr, "Error: symbol for %s not found in %s\n", fn_names[i], map_path);
+			return EXIT_FAILURE;
+		}
+	}
+	stm8emu_free_map(&symtab);
+	h.rng = 1;
+
+	// Far functions are given a pointer to a 32-bit big-endian address.
+	h.emu->mem[FAR_PTR_ADDR + 0] = 0;
+	h.emu->mem[FAR_PTR_ADDR + 1] = (uint8_t)(FAR_DATA_ADDR >> 16);
+	h.emu->mem[FAR_PTR_ADDR + 2] = (uint8_t)(FAR_DATA_ADDR >> 8);
+	h.emu->mem[FAR_PTR_ADDR + 3] = (uint8_t)FAR_DATA_ADDR;
+
+	printf("WCET of %s (%s model), in cycles from entry to return, excluding CALL,\n", argv[optind], (h.large ? "large" : "medium"));
+	printf("and stack usage in bytes, of arguments and of call (return address and below):\n\n");
+	snprintf(report_col, sizeof(report_col), "len = %u", REPORT_LEN);
+	printf("%-36s %4s %8s %20s %8s %5s %5s\n", "function", "wait", "len = 0", "len > 0", report_col, "args", "stack");
+
+	for(unsigned int ws = 0; ws <= max_wait; ws++) {
+		h.emu->wait_states = (uint8_t)ws;
+		for(fn_t fn = 0; fn < FN_COUNT; fn++) {
+			if(fn == FN_GET_PID || fn == FN_VERIFY_PID) {
+				measure_pid(&h, fn, &t);
+			} else {
+				measure_checksum(&h, fn, &t);
+			}
+			print_timing(fn, (uint8_t)ws, &t);
+			// The simulator has no wait states, so only those timings are
+			// needed for the cross-check.
+			if(ws == 0) timings[fn] = t;
+		}
+	}
+
+	if(bench_path != NULL) {
+		printf("\nCross-check against %s (0 wait states):\n\n", bench_path);
+		ok = cross_check(bench_path, timings);
+	}
+
+	free(h.emu);
+
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+
+usage:
+	fputs(usage_str, stderr);
+	return EXIT_FAILURE;
+}
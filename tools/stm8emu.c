@@ -0,0 +1,1155 @@
+/*******************************************************************************
+ *
+ * stm8emu.c - STM8 CPU instruction set emulator
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "stm8emu.h"
+
+// Instruction prefix bytes.
+#define PRE_NONE 0x00
+#define PRE_72 0x72
+#define PRE_90 0x90
+#define PRE_91 0x91
+#define PRE_92 0x92
+
+// Flags affected by the various classes of operation.
+#define FLAGS_NZ (STM8EMU_CC_N | STM8EMU_CC_Z)
+#define FLAGS_NZC (STM8EMU_CC_N | STM8EMU_CC_Z | STM8EMU_CC_C)
+#define FLAGS_VNZ (STM8EMU_CC_V | STM8EMU_CC_N | STM8EMU_CC_Z)
+#define FLAGS_VNZC (STM8EMU_CC_V | STM8EMU_CC_N | STM8EMU_CC_Z | STM8EMU_CC_C)
+#define FLAGS_VHNZC (STM8EMU_CC_V | STM8EMU_CC_H | STM8EMU_CC_N | STM8EMU_CC_Z | STM8EMU_CC_C)
+
+// Value of fetch_word when nothing is held from a previous fetch.
+#define FETCH_WORD_NONE UINT32_MAX
+
+// Memory accessors record an out-of-range access in the fault flag rather
+// than aborting, which is checked once the instruction completes. They also
+// add up wait state cycles, which immediate operands (being part of the
+// instruction fetch) don't incur again when read.
+typedef struct {
+	stm8emu_t *emu;
+	bool fault;
+	bool immediate;
+	uint8_t wait_cycles;
+	uint32_t fetch_end;
+} ctx_t;
+
+/******************************************************************************/
+
+static uint8_t rd8(ctx_t *c, const uint32_t addr) {
+	if(addr >= STM8EMU_MEM_SIZE) {
+		c->fault = true;
+		return 0;
+	}
+	if(c->emu->wait_states > 0 && addr >= STM8EMU_FLASH_START && !c->immediate) c->wait_cycles += c->emu->wait_states;
+	return c->emu->mem[addr];
+}
+
+static void wr8(ctx_t *c, const uint32_t addr, const uint8_t val) {
+	if(addr >= STM8EMU_MEM_SIZE) {
+		c->fault = true;
+		return;
+	}
+	c->emu->mem[addr] = val;
+}
+
+static uint16_t rd16(ctx_t *c, const uint32_t addr) {
+	// All multi-byte values are big-endian.
+	return (uint16_t)((rd8(c, addr) << 8) | rd8(c, addr + 1));
+}
+
+static void wr16(ctx_t *c, const uint32_t addr, const uint16_t val) {
+	wr8(c, addr, (uint8_t)(val >> 8));
+	wr8(c, addr + 1, (uint8_t)val);
+}
+
+static uint32_t rd24(ctx_t *c, const uint32_t addr) {
+	return ((uint32_t)rd8(c, addr) << 16) | rd16(c, addr + 1);
+}
+
+static void fetch_wait(ctx_t *c, const uint32_t addr) {
+	// Flash is read for instructions a 32-bit word at a time, with each word
+	// taking wait states. This assumes none of that is hidden by prefetching,
+	// so gives an upper bound.
+	stm8emu_t *emu = c->emu;
+
+	if(addr >= STM8EMU_FLASH_START && (addr >> 2) != emu->fetch_word) {
+		emu->fetch_word = addr >> 2;
+		c->wait_cycles += emu->wait_states;
+	}
+	c->fetch_end = addr + 1;
+}
+
+static uint8_t fetch8(ctx_t *c) {
+	stm8emu_t *emu = c->emu;
+
+	if(emu->pc >= STM8EMU_MEM_SIZE) {
+		c->fault = true;
+		return 0;
+	}
+	if(emu->wait_states > 0) fetch_wait(c, emu->pc);
+	return emu->mem[emu->pc++];
+}
+
+static uint16_t fetch16(ctx_t *c) {
+	const uint8_t hi = fetch8(c);
+	return (uint16_t)((hi << 8) | fetch8(c));
+}
+
+static uint32_t fetch24(ctx_t *c) {
+	const uint8_t ext = fetch8(c);
+	return ((uint32_t)ext << 16) | fetch16(c);
+}
+
+static void push8(ctx_t *c, const uint8_t val) {
+	wr8(c, c->emu->sp, val);
+	c->emu->sp--;
+}
+
+static uint8_t pop8(ctx_t *c) {
+	c->emu->sp++;
+	return rd8(c, c->emu->sp);
+}
+
+static void push16(ctx_t *c, const uint16_t val) {
+	push8(c, (uint8_t)val);
+	push8(c, (uint8_t)(val >> 8));
+}
+
+static uint16_t pop16(ctx_t *c) {
+	const uint8_t hi = pop8(c);
+	return (uint16_t)((hi << 8) | pop8(c));
+}
+
+/******************************************************************************/
+
+static void set_flags(stm8emu_t *emu, const uint8_t mask, const uint8_t flags) {
+	emu->cc = (uint8_t)((emu->cc & ~mask) | (flags & mask));
+}
+
+static uint8_t nz8(const uint8_t val) {
+	return (val & 0x80 ? STM8EMU_CC_N : 0) | (val == 0 ? STM8EMU_CC_Z : 0);
+}
+
+static uint8_t nz16(const uint16_t val) {
+	return (val & 0x8000 ? STM8EMU_CC_N : 0) | (val == 0 ? STM8EMU_CC_Z : 0);
+}
+
+static uint8_t add8(stm8emu_t *emu, const uint8_t a, const uint8_t b, const uint8_t carry) {
+	const unsigned int r = a + b + carry;
+	uint8_t f = nz8((uint8_t)r);
+	if(r > 0xFF) f |= STM8EMU_CC_C;
+	if(((a & 0xF) + (b & 0xF) + carry) > 0xF) f |= STM8EMU_CC_H;
+	if((a ^ r) & (b ^ r) & 0x80) f |= STM8EMU_CC_V;
+	set_flags(emu, FLAGS_VHNZC, f);
+	return (uint8_t)r;
+}
+
+static uint8_t sub8(stm8emu_t *emu, const uint8_t a, const uint8_t b, const uint8_t borrow) {
+	const unsigned int r = (unsigned int)a - b - borrow;
+	uint8_t f = nz8((uint8_t)r);
+	if((unsigned int)b + borrow > a) f |= STM8EMU_CC_C;
+	if((a ^ b) & (a ^ r) & 0x80) f |= STM8EMU_CC_V;
+	set_flags(emu, FLAGS_VNZC, f);
+	return (uint8_t)r;
+}
+
+static uint16_t add16(stm8emu_t *emu, const uint16_t a, const uint16_t b) {
+	const uint32_t r = (uint32_t)a + b;
+	uint8_t f = nz16((uint16_t)r);
+	if(r > 0xFFFF) f |= STM8EMU_CC_C;
+	if(((a & 0xFF) + (b & 0xFF)) > 0xFF) f |= STM8EMU_CC_H;
+	if((a ^ r) & (b ^ r) & 0x8000) f |= STM8EMU_CC_V;
+	set_flags(emu, FLAGS_VHNZC, f);
+	return (uint16_t)r;
+}
+
+static uint16_t sub16(stm8emu_t *emu, const uint16_t a, const uint16_t b, const bool cmp) {
+	const uint32_t r = (uint32_t)a - b;
+	uint8_t f = nz16((uint16_t)r);
+	if(b > a) f |= STM8EMU_CC_C;
+	if((b & 0xFF) > (a & 0xFF)) f |= STM8EMU_CC_H;
+	if((a ^ b) & (a ^ r) & 0x8000) f |= STM8EMU_CC_V;
+	// Compare doesn't affect the half-carry flag.
+	set_flags(emu, (cmp ? FLAGS_VNZC : FLAGS_VHNZC), f);
+	return (uint16_t)r;
+}
+
+static uint8_t alu8(stm8emu_t *emu, const uint8_t op, const uint8_t a, const uint8_t b) {
+	// Returns new accumulator value for the arithmetic/logic operations in rows
+	// 0-2, 4-5 and 8-B of the opcode map. Compare and bit test leave A as-is.
+	const uint8_t carry = emu->cc & STM8EMU_CC_C;
+
+	switch(op) {
+		case 0x0: return sub8(emu, a, b, 0); // SUB
+		case 0x1: sub8(emu, a, b, 0); return a; // CP
+		case 0x2: return sub8(emu, a, b, carry); // SBC
+		case 0x4: set_flags(emu, FLAGS_NZ, nz8(a & b)); return a & b; // AND
+		case 0x5: set_flags(emu, FLAGS_NZ, nz8(a & b)); return a; // BCP
+		case 0x8: set_flags(emu, FLAGS_NZ, nz8(a ^ b)); return a ^ b; // XOR
+		case 0x9: return add8(emu, a, b, carry); // ADC
+		case 0xA: set_flags(emu, FLAGS_NZ, nz8(a | b)); return a | b; // OR
+		case 0xB: return add8(emu, a, b, 0); // ADD
+		default: return a;
+	}
+}
+
+static bool rmw8(stm8emu_t *emu, const uint8_t op, uint8_t *val) {
+	// Read-modify-write operations on a byte. Returns false for opcode rows
+	// that are not such an operation.
+	const uint8_t v = *val, carry = emu->cc & STM8EMU_CC_C;
+	uint8_t r;
+
+	switch(op) {
+		case 0x0: // NEG
+			r = (uint8_t)-v;
+			set_flags(emu, FLAGS_VNZC, nz8(r) | (v == 0x80 ? STM8EMU_CC_V : 0) | (r != 0 ? STM8EMU_CC_C : 0));
+			break;
+		case 0x3: // CPL
+			r = (uint8_t)~v;
+			set_flags(emu, FLAGS_NZC, nz8(r) | STM8EMU_CC_C);
+			break;
+		case 0x4: // SRL
+			r = v >> 1;
+			set_flags(emu, FLAGS_NZC, nz8(r) | (v & 1));
+			break;
+		case 0x6: // RRC
+			r = (uint8_t)((v >> 1) | (carry << 7));
+			set_flags(emu, FLAGS_NZC, nz8(r) | (v & 1));
+			break;
+		case 0x7: // SRA
+			r = (uint8_t)((v >> 1) | (v & 0x80));
+			set_flags(emu, FLAGS_NZC, nz8(r) | (v & 1));
+			break;
+		case 0x8: // SLL
+			r = (uint8_t)(v << 1);
+			set_flags(emu, FLAGS_NZC, nz8(r) | (v >> 7));
+			break;
+		case 0x9: // RLC
+			r = (uint8_t)((v << 1) | carry);
+			set_flags(emu, FLAGS_NZC, nz8(r) | (v >> 7));
+			break;
+		case 0xA: // DEC
+			r = v - 1;
+			set_flags(emu, FLAGS_VNZ, nz8(r) | (r == 0x7F ? STM8EMU_CC_V : 0));
+			break;
+		case 0xC: // INC
+			r = v + 1;
+			set_flags(emu, FLAGS_VNZ, nz8(r) | (r == 0x80 ? STM8EMU_CC_V : 0));
+			break;
+		case 0xD: // TNZ
+			set_flags(emu, FLAGS_NZ, nz8(v));
+			return true;
+		case 0xE: // SWAP
+			r = (uint8_t)((v << 4) | (v >> 4));
+			set_flags(emu, FLAGS_NZ, nz8(r));
+			break;
+		case 0xF: // CLR
+			r = 0;
+			set_flags(emu, FLAGS_NZ, STM8EMU_CC_Z);
+			break;
+		default:
+			return false;
+	}
+
+	*val = r;
+	return true;
+}
+
+static bool rmw16(stm8emu_t *emu, const uint8_t op, uint16_t *val) {
+	// As above, but for index registers.
+	const uint16_t v = *val, carry = emu->cc & STM8EMU_CC_C;
+	uint16_t r;
+
+	switch(op) {
+		case 0x0: // NEGW
+			r = (uint16_t)-v;
+			set_flags(emu, FLAGS_VNZC, nz16(r) | (v == 0x8000 ? STM8EMU_CC_V : 0) | (r != 0 ? STM8EMU_CC_C : 0));
+			break;
+		case 0x3: // CPLW
+			r = (uint16_t)~v;
+			set_flags(emu, FLAGS_NZC, nz16(r) | STM8EMU_CC_C);
+			break;
+		case 0x4: // SRLW
+			r = v >> 1;
+			set_flags(emu, FLAGS_NZC, nz16(r) | (v & 1));
+			break;
+		case 0x6: // RRCW
+			r = (uint16_t)((v >> 1) | (carry << 15));
+			set_flags(emu, FLAGS_NZC, nz16(r) | (v & 1));
+			break;
+		case 0x7: // SRAW
+			r = (uint16_t)((v >> 1) | (v & 0x8000));
+			set_flags(emu, FLAGS_NZC, nz16(r) | (v & 1));
+			break;
+		case 0x8: // SLLW
+			r = (uint16_t)(v << 1);
+			set_flags(emu, FLAGS_NZC, nz16(r) | (v >> 15));
+			break;
+		case 0x9: // RLCW
+			r = (uint16_t)((v << 1) | carry);
+			set_flags(emu, FLAGS_NZC, nz16(r) | (v >> 15));
+			break;
+		case 0xA: // DECW
+			r = v - 1;
+			set_flags(emu, FLAGS_VNZ, nz16(r) | (r == 0x7FFF ? STM8EMU_CC_V : 0));
+			break;
+		case 0xC: // INCW
+			r = v + 1;
+			set_flags(emu, FLAGS_VNZ, nz16(r) | (r == 0x8000 ? STM8EMU_CC_V : 0));
+			break;
+		case 0xD: // TNZW
+			set_flags(emu, FLAGS_NZ, nz16(v));
+			return true;
+		case 0xE: // SWAPW
+			r = (uint16_t)((v << 8) | (v >> 8));
+			set_flags(emu, FLAGS_NZ, nz16(r));
+			break;
+		case 0xF: // CLRW
+			r = 0;
+			set_flags(emu, FLAGS_NZ, STM8EMU_CC_Z);
+			break;
+		default:
+			return false;
+	}
+
+	*val = r;
+	return true;
+}
+
+static bool branch_cond(const stm8emu_t *emu, const uint8_t pre, const uint8_t op) {
+	const bool c = emu->cc & STM8EMU_CC_C, z = emu->cc & STM8EMU_CC_Z;
+	const bool n = emu->cc & STM8EMU_CC_N, v = emu->cc & STM8EMU_CC_V;
+	const bool h = emu->cc & STM8EMU_CC_H;
+	const bool m = (emu->cc & (STM8EMU_CC_I1 | STM8EMU_CC_I0)) == (STM8EMU_CC_I1 | STM8EMU_CC_I0);
+
+	if(pre == PRE_90) {
+		switch(op & 0xF) {
+			case 0x8: return !h; // JRNH
+			case 0x9: return h; // JRH
+			case 0xC: return !m; // JRNM
+			case 0xD: return m; // JRM
+			case 0xE: return true; // JRIL (no interrupt line is ever high)
+			default: return false; // JRIH
+		}
+	}
+
+	switch(op & 0xF) {
+		case 0x0: return true; // JRA
+		case 0x1: return false; // JRF
+		case 0x2: return !c && !z; // JRUGT
+		case 0x3: return c || z; // JRULE
+		case 0x4: return !c; // JRNC
+		case 0x5: return c; // JRC
+		case 0x6: return !z; // JRNE
+		case 0x7: return z; // JREQ
+		case 0x8: return !v; // JRNV
+		case 0x9: return v; // JRV
+		case 0xA: return !n; // JRPL
+		case 0xB: return n; // JRMI
+		case 0xC: return !(z || (n != v)); // JRSGT
+		case 0xD: return z || (n != v); // JRSLE
+		case 0xE: return n == v; // JRSGE
+		default: return n != v; // JRSLT
+	}
+}
+
+/******************************************************************************/
+
+static bool rmw_addr(ctx_t *c, const uint8_t pre, const uint8_t col, const uint16_t ix, uint32_t *addr) {
+	// Effective address of read-modify-write operand for opcode columns 0, 3,
+	// 4, 6 and 7 (and 5 with 0x72 prefix), according to prefix. Returns false
+	// if the combination does not address memory.
+	stm8emu_t *emu = c->emu;
+
+	switch(col) {
+		case 0x0:
+			if(pre != PRE_NONE) return false;
+			*addr = (uint16_t)(emu->sp + fetch8(c));
+			return true;
+		case 0x3:
+			if(pre == PRE_NONE) *addr = fetch8(c);
+			else if(pre == PRE_72) *addr = rd16(c, fetch16(c));
+			else if(pre == PRE_92) *addr = rd16(c, fetch8(c));
+			else return false;
+			return true;
+		case 0x4:
+			if(pre != PRE_72 && pre != PRE_90) return false;
+			*addr = (uint16_t)(fetch16(c) + ix);
+			return true;
+		case 0x5:
+			if(pre != PRE_72) return false;
+			*addr = fetch16(c);
+			return true;
+		case 0x6:
+			if(pre == PRE_NONE || pre == PRE_90) *addr = (uint16_t)(fetch8(c) + ix);
+			else if(pre == PRE_72) *addr = (uint16_t)(rd16(c, fetch16(c)) + ix);
+			else *addr = (uint16_t)(rd16(c, fetch8(c)) + ix);
+			return true;
+		case 0x7:
+			if(pre != PRE_NONE && pre != PRE_90) return false;
+			*addr = ix;
+			return true;
+		default:
+			return false;
+	}
+}
+
+static bool op_addr(ctx_t *c, const uint8_t pre, const uint8_t col, const uint8_t size, const uint16_t ix, uint32_t *addr) {
+	// Effective address of operand for opcode columns 1 and A to F, according
+	// to prefix. Immediate operands are addressed where they sit in the
+	// instruction stream. Returns false if the combination is invalid.
+	stm8emu_t *emu = c->emu;
+
+	switch(col) {
+		case 0x1:
+			if(pre != PRE_NONE) return false;
+			*addr = (uint16_t)(emu->sp + fetch8(c));
+			return true;
+		case 0xA:
+			if(pre != PRE_NONE && pre != PRE_90) return false;
+			*addr = emu->pc;
+			for(uint8_t i = 0; i < size; i++) {
+				if(emu->wait_states > 0) fetch_wait(c, emu->pc);
+				emu->pc++;
+			}
+			c->immediate = true;
+			return true;
+		case 0xB:
+			if(pre != PRE_NONE && pre != PRE_90) return false;
+			*addr = fetch8(c);
+			return true;
+		case 0xC:
+			if(pre == PRE_NONE || pre == PRE_90) *addr = fetch16(c);
+			else if(pre == PRE_72) *addr = rd16(c, fetch16(c));
+			else *addr = rd16(c, fetch8(c));
+			return true;
+		case 0xD:
+			if(pre == PRE_NONE || pre == PRE_90) *addr = (uint16_t)(fetch16(c) + ix);
+			else if(pre == PRE_72) *addr = (uint16_t)(rd16(c, fetch16(c)) + ix);
+			else *addr = (uint16_t)(rd16(c, fetch8(c)) + ix);
+			return true;
+		case 0xE:
+			if(pre != PRE_NONE && pre != PRE_90) return false;
+			*addr = (uint16_t)(fetch8(c) + ix);
+			return true;
+		case 0xF:
+			if(pre != PRE_NONE && pre != PRE_90) return false;
+			*addr = ix;
+			return true;
+		default:
+			return false;
+	}
+}
+
+static stm8emu_status_t exec_special(ctx_t *c, const uint8_t pre, const uint8_t op, uint16_t *rx, uint16_t *ry) {
+	// Opcodes that don't fit the regular patterns of the opcode map.
+	stm8emu_t *emu = c->emu;
+	uint32_t addr, dst;
+	uint16_t w;
+	uint8_t b, rem;
+	int8_t rel;
+
+	switch(op) {
+		case 0x01: // RRWA X/Y
+			b = emu->a;
+			emu->a = (uint8_t)*rx;
+			*rx = (uint16_t)((b << 8) | (*rx >> 8));
+			set_flags(emu, FLAGS_NZ, nz16(*rx));
+			break;
+		case 0x02: // RLWA X/Y
+			b = emu->a;
+			emu->a = (uint8_t)(*rx >> 8);
+			*rx = (uint16_t)((*rx << 8) | b);
+			set_flags(emu, FLAGS_NZ, nz16(*rx));
+			break;
+		case 0x31: // EXG A,longmem
+			addr = fetch16(c);
+			b = rd8(c, addr);
+			wr8(c, addr, emu->a);
+			emu->a = b;
+			break;
+		case 0x32: // POP longmem
+			addr = fetch16(c);
+			wr8(c, addr, pop8(c));
+			break;
+		case 0x35: // MOV longmem,#byte
+			b = fetch8(c);
+			wr8(c, fetch16(c), b);
+			break;
+		case 0x3B: // PUSH longmem
+			push8(c, rd8(c, fetch16(c)));
+			break;
+		case 0x41: // EXG A,XL
+			b = emu->a;
+			emu->a = (uint8_t)emu->x;
+			emu->x = (uint16_t)((emu->x & 0xFF00) | b);
+			break;
+		case 0x42: // MUL X/Y,A
+			*rx = (uint16_t)((*rx & 0xFF) * emu->a);
+			set_flags(emu, STM8EMU_CC_H | STM8EMU_CC_C, 0);
+			break;
+		case 0x45: // MOV shortmem,shortmem
+			b = rd8(c, fetch8(c));
+			wr8(c, fetch8(c), b);
+			break;
+		case 0x4B: // PUSH #byte
+			push8(c, fetch8(c));
+			break;
+		case 0x51: // EXGW X,Y
+			w = emu->x;
+			emu->x = emu->y;
+			emu->y = w;
+			break;
+		case 0x52: // SUB SP,#byte
+			emu->sp -= fetch8(c);
+			break;
+		case 0x55: // MOV longmem,longmem
+			addr = fetch16(c);
+			dst = fetch16(c);
+			wr8(c, dst, rd8(c, addr));
+			break;
+		case 0x5B: // ADDW SP,#byte
+			emu->sp += fetch8(c);
+			break;
+		case 0x61: // EXG A,YL
+			b = emu->a;
+			emu->a = (uint8_t)emu->y;
+			emu->y = (uint16_t)((emu->y & 0xFF00) | b);
+			break;
+		case 0x62: // DIV X/Y,A
+			if(emu->a == 0) {
+				set_flags(emu, FLAGS_VHNZC, STM8EMU_CC_C);
+			} else {
+				rem = (uint8_t)(*rx % emu->a);
+				*rx /= emu->a;
+				emu->a = rem;
+				set_flags(emu, FLAGS_VHNZC, (*rx == 0 ? STM8EMU_CC_Z : 0));
+			}
+			break;
+		case 0x65: // DIVW X,Y
+			if(emu->y == 0) {
+				set_flags(emu, FLAGS_VHNZC, STM8EMU_CC_C);
+			} else {
+				w = emu->x % emu->y;
+				emu->x /= emu->y;
+				emu->y = w;
+				set_flags(emu, FLAGS_VHNZC, (emu->x == 0 ? STM8EMU_CC_Z : 0));
+			}
+			break;
+		case 0x6B: // LD (shortoff,SP),A
+			wr8(c, (uint16_t)(emu->sp + fetch8(c)), emu->a);
+			set_flags(emu, FLAGS_NZ, nz8(emu->a));
+			break;
+		case 0x7B: // LD A,(shortoff,SP)
+			emu->a = rd8(c, (uint16_t)(emu->sp + fetch8(c)));
+			set_flags(emu, FLAGS_NZ, nz8(emu->a));
+			break;
+		case 0x81: // RET
+			w = pop16(c);
+			emu->pc = (emu->pc & 0xFF0000) | w;
+			break;
+		case 0x84: // POP A
+			emu->a = pop8(c);
+			break;
+		case 0x85: // POPW X/Y
+			*rx = pop16(c);
+			break;
+		case 0x86: // POP CC
+			emu->cc = pop8(c);
+			break;
+		case 0x87: // RETF
+			b = pop8(c);
+			emu->pc = ((uint32_t)b << 16) | pop16(c);
+			break;
+		case 0x88: // PUSH A
+			push8(c, emu->a);
+			break;
+		case 0x89: // PUSHW X/Y
+			push16(c, *rx);
+			break;
+		case 0x8A: // PUSH CC
+			push8(c, emu->cc);
+			break;
+		case 0x8C: // CCF
+			emu->cc ^= STM8EMU_CC_C;
+			break;
+		case 0x8D: // CALLF extmem / CALLF [longptr.e]
+			addr = (pre == PRE_92 ? rd24(c, fetch16(c)) : fetch24(c));
+			push16(c, (uint16_t)emu->pc);
+			push8(c, (uint8_t)(emu->pc >> 16));
+			emu->pc = addr;
+			break;
+		case 0x93: // LDW X,Y / LDW Y,X
+			*rx = *ry;
+			break;
+		case 0x94: // LDW SP,X/Y
+			emu->sp = *rx;
+			break;
+		case 0x95: // LD XH/YH,A
+			*rx = (uint16_t)((*rx & 0x00FF) | (emu->a << 8));
+			break;
+		case 0x96: // LDW X/Y,SP
+			*rx = emu->sp;
+			break;
+		case 0x97: // LD XL/YL,A
+			*rx = (uint16_t)((*rx & 0xFF00) | emu->a);
+			break;
+		case 0x98: // RCF
+			emu->cc &= ~STM8EMU_CC_C;
+			break;
+		case 0x99: // SCF
+			emu->cc |= STM8EMU_CC_C;
+			break;
+		case 0x9A: // RIM
+			emu->cc = (uint8_t)((emu->cc & ~(STM8EMU_CC_I1 | STM8EMU_CC_I0)) | STM8EMU_CC_I1);
+			break;
+		case 0x9B: // SIM
+			emu->cc |= STM8EMU_CC_I1 | STM8EMU_CC_I0;
+			break;
+		case 0x9C: // RVF
+			emu->cc &= ~STM8EMU_CC_V;
+			break;
+		case 0x9D: // NOP
+			break;
+		case 0x9E: // LD A,XH/YH
+			emu->a = (uint8_t)(*rx >> 8);
+			break;
+		case 0x9F: // LD A,XL/YL
+			emu->a = (uint8_t)*rx;
+			break;
+		case 0xA7: // LDF (extoff,X/Y),A / LDF ([longptr.e],X/Y),A
+		case 0xAF: // LDF A,(extoff,X/Y) / LDF A,([longptr.e],X/Y)
+			addr = ((pre == PRE_91 || pre == PRE_92) ? rd24(c, fetch16(c)) : fetch24(c));
+			addr = (addr + *rx) & 0xFFFFFF;
+			if(op == 0xA7) {
+				wr8(c, addr, emu->a);
+			} else {
+				emu->a = rd8(c, addr);
+			}
+			set_flags(emu, FLAGS_NZ, nz8(emu->a));
+			break;
+		case 0xAC: // JPF extmem / JPF [longptr.e]
+			emu->pc = (pre == PRE_92 ? rd24(c, fetch16(c)) : fetch24(c));
+			break;
+		case 0xAD: // CALLR
+			rel = (int8_t)fetch8(c);
+			push16(c, (uint16_t)emu->pc);
+			emu->pc = (emu->pc & 0xFF0000) | (uint16_t)(emu->pc + rel);
+			break;
+		case 0xBC: // LDF A,extmem / LDF A,[longptr.e]
+		case 0xBD: // LDF extmem,A / LDF [longptr.e],A
+			addr = (pre == PRE_92 ? rd24(c, fetch16(c)) : fetch24(c));
+			if(op == 0xBC) {
+				emu->a = rd8(c, addr);
+			} else {
+				wr8(c, addr, emu->a);
+			}
+			set_flags(emu, FLAGS_NZ, nz8(emu->a));
+			break;
+		default:
+			return STM8EMU_ERR_ILLEGAL;
+	}
+
+	return STM8EMU_OK;
+}
+
+static bool is_special(const uint8_t pre, const uint8_t op) {
+	// Whether opcode (with given prefix) is one handled by exec_special().
+	// Those with a Y register variant also take the 0x90 prefix, and those
+	// with a far pointer variant take 0x91/0x92.
+	switch(op) {
+		case 0x01: case 0x02: case 0x42: case 0x62: case 0x85: case 0x89:
+		case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: case 0x9E: case 0x9F:
+			return (pre == PRE_NONE || pre == PRE_90);
+		case 0xA7: case 0xAF:
+			return (pre != PRE_72);
+		case 0x8D: case 0xAC: case 0xBC: case 0xBD:
+			return (pre == PRE_NONE || pre == PRE_92);
+		case 0x31: case 0x32: case 0x35: case 0x3B: case 0x41: case 0x45: case 0x4B:
+		case 0x51: case 0x52: case 0x55: case 0x5B: case 0x61: case 0x65: case 0x6B: case 0x7B:
+		case 0x81: case 0x84: case 0x86: case 0x87: case 0x88: case 0x8A: case 0x8C:
+		case 0x98: case 0x99: case 0x9A: case 0x9B: case 0x9C: case 0x9D: case 0xAD:
+			return (pre == PRE_NONE);
+		default:
+			return false;
+	}
+}
+
+// Cycles taken by instructions are according to the STM8 CPU programming
+// manual (PM0044), which assumes the pipeline is never stalled. Where the count
+// depends on the operands (DIV and DIVW), the maximum is given.
+
+static uint8_t special_cycles(const uint8_t pre, const uint8_t op) {
+	// For opcodes handled by exec_special().
+	switch(op) {
+		case 0x31: return 3; // EXG A,longmem
+		case 0x42: return 4; // MUL
+		case 0x62: case 0x65: return 17; // DIV, DIVW
+		case 0x5B: return 2; // ADDW SP,#byte
+		case 0x81: case 0xAD: return 4; // RET, CALLR
+		case 0x87: return 5; // RETF
+		case 0x85: case 0x89: return 2; // POPW, PUSHW
+		case 0x8D: return (pre == PRE_92 ? 8 : 5); // CALLF
+		case 0xAC: return (pre == PRE_92 ? 6 : 2); // JPF
+		case 0xA7: case 0xAF: return (pre == PRE_91 || pre == PRE_92 ? 5 : 1); // LDF indexed
+		case 0xBC: case 0xBD: return (pre == PRE_92 ? 5 : 1); // LDF
+		default: return 1;
+	}
+}
+
+static uint8_t regular_cycles(const uint8_t pre, const uint8_t col, const uint8_t row) {
+	// For opcodes in the regular part of the opcode map, with memory operands
+	// or in columns 1 and A to F.
+	const bool indirect = (pre == PRE_72 || pre == PRE_91 || pre == PRE_92) && (col == 0x3 || col == 0x6 || col == 0xC || col == 0xD);
+
+	if(col == 0x0 || (col >= 0x3 && col <= 0x7)) return (indirect ? 4 : 1);
+	if(col == 0x1 && (row == 0x6 || row == 0x7 || row == 0xC || row == 0xD)) return 2; // LDW Y,(SP), ADDW/SUBW X,#word
+
+	switch(row) {
+		case 0x3: case 0xE: case 0xF: return (indirect ? 5 : 2); // CPW, LDW
+		case 0xC: return (indirect ? 5 : 1); // JP
+		case 0xD: return (indirect ? 6 : 4); // CALL
+		default: return (indirect ? 4 : 1);
+	}
+}
+
+stm8emu_status_t stm8emu_step(stm8emu_t *emu) {
+	ctx_t ctx = { emu, false, false, 0, emu->pc }, *c = &ctx;
+	stm8emu_status_t status = STM8EMU_OK;
+	uint8_t pre = PRE_NONE, op, col, row, b, pos;
+	uint16_t *rx, *ry, w;
+	uint32_t addr;
+	uint8_t cycles = 1;
+	int8_t rel;
+
+	emu->fault_pc = emu->pc;
+
+	op = fetch8(c);
+	if(op == PRE_72 || op == PRE_90 || op == PRE_91 || op == PRE_92) {
+		pre = op;
+		op = fetch8(c);
+	}
+	col = op >> 4;
+	row = op & 0xF;
+
+	// The 0x90 and 0x91 prefixes swap the roles of the X and Y registers (for
+	// both indexing and as operands of word instructions).
+	if(pre == PRE_90 || pre == PRE_91) {
+		rx = &emu->y;
+		ry = &emu->x;
+	} else {
+		rx = &emu->x;
+		ry = &emu->y;
+	}
+
+	if(pre == PRE_72 && col <= 0x1) {
+		// BTJT/BTJF longmem,#pos,rel and BSET/BRES longmem,#pos
+		addr = fetch16(c);
+		pos = (row >> 1) & 0x7;
+		b = rd8(c, addr);
+		if(col == 0x0) {
+			rel = (int8_t)fetch8(c);
+			set_flags(emu, STM8EMU_CC_C, (b >> pos) & 1);
+			cycles = 2;
+			if(((b >> pos) & 1) == !(row & 1)) {
+				emu->pc = (emu->pc & 0xFF0000) | (uint16_t)(emu->pc + rel);
+				cycles++;
+			}
+		} else {
+			wr8(c, addr, (uint8_t)((row & 1) ? (b & ~(1 << pos)) : (b | (1 << pos))));
+		}
+	} else if(pre == PRE_90 && col == 0x1) {
+		// BCPL/BCCM longmem,#pos
+		addr = fetch16(c);
+		pos = (row >> 1) & 0x7;
+		b = rd8(c, addr);
+		if(row & 1) {
+			b = (uint8_t)((emu->cc & STM8EMU_CC_C) ? (b | (1 << pos)) : (b & ~(1 << pos)));
+		} else {
+			b ^= (uint8_t)(1 << pos);
+		}
+		wr8(c, addr, b);
+	} else if(pre == PRE_72 && col >= 0xA && col != 0xC && col != 0xD) {
+		// Word add/subtract with Y, or with operands not available otherwise.
+		// (Other 0x72-prefixed instructions in columns C and D are the regular
+		// ones with long pointer addressing.)
+		cycles = 2;
+		switch(op) {
+			case 0xA9: emu->y = add16(emu, emu->y, fetch16(c)); break;
+			case 0xB9: emu->y = add16(emu, emu->y, rd16(c, fetch16(c))); break;
+			case 0xF9: emu->y = add16(emu, emu->y, rd16(c, (uint16_t)(emu->sp + fetch8(c)))); break;
+			case 0xBB: emu->x = add16(emu, emu->x, rd16(c, fetch16(c))); break;
+			case 0xFB: emu->x = add16(emu, emu->x, rd16(c, (uint16_t)(emu->sp + fetch8(c)))); break;
+			case 0xA2: emu->y = sub16(emu, emu->y, fetch16(c), false); break;
+			case 0xB2: emu->y = sub16(emu, emu->y, rd16(c, fetch16(c)), false); break;
+			case 0xF2: emu->y = sub16(emu, emu->y, rd16(c, (uint16_t)(emu->sp + fetch8(c))), false); break;
+			case 0xB0: emu->x = sub16(emu, emu->x, rd16(c, fetch16(c)), false); break;
+			case 0xF0: emu->x = sub16(emu, emu->x, rd16(c, (uint16_t)(emu->sp + fetch8(c))), false); break;
+			default: status = STM8EMU_ERR_ILLEGAL; break;
+		}
+	} else if(col == 0x2) {
+		// JRxx
+		rel = (int8_t)fetch8(c);
+		if(pre != PRE_NONE && pre != PRE_90) status = STM8EMU_ERR_ILLEGAL;
+		else if(pre == PRE_90 && (row < 0x8 || row == 0xA || row == 0xB)) status = STM8EMU_ERR_ILLEGAL;
+		else if(branch_cond(emu, pre, op)) {
+			emu->pc = (emu->pc & 0xFF0000) | (uint16_t)(emu->pc + rel);
+			cycles++;
+		}
+	} else if(op == 0x80 || op == 0x82 || op == 0x83 || op == 0x8B || op == 0x8E || op == 0x8F) {
+		// IRET, INT, TRAP, BREAK, HALT, WFI/WFE
+		status = STM8EMU_ERR_HALT;
+	} else if(is_special(pre, op)) {
+		status = exec_special(c, pre, op, rx, ry);
+		cycles = special_cycles(pre, op);
+	} else if(col == 0x8 || col == 0x9 || (col <= 0x7 && col != 0x1 && (row == 0x1 || row == 0x2 || row == 0x5 || row == 0xB))) {
+		// Remaining irregular opcodes, or regular ones with a prefix they
+		// don't take.
+		status = STM8EMU_ERR_ILLEGAL;
+	} else if(col == 0x4 && pre == PRE_NONE) {
+		// Read-modify-write of A
+		if(!rmw8(emu, row, &emu->a)) status = STM8EMU_ERR_ILLEGAL;
+	} else if(col == 0x5 && (pre == PRE_NONE || pre == PRE_90)) {
+		// Read-modify-write of X/Y. INCW, DECW, SWAPW and CLRW take 1 cycle,
+		// the others 2.
+		if(!rmw16(emu, row, rx)) status = STM8EMU_ERR_ILLEGAL;
+		if(row != 0xA && row != 0xC && row != 0xE && row != 0xF) cycles = 2;
+	} else if(col == 0x0 || (col >= 0x3 && col <= 0x7)) {
+		// Read-modify-write of memory
+		cycles = regular_cycles(pre, col, row);
+		if(!rmw_addr(c, pre, col, *rx, &addr)) {
+			status = STM8EMU_ERR_ILLEGAL;
+		} else {
+			b = rd8(c, addr);
+			if(!rmw8(emu, row, &b)) status = STM8EMU_ERR_ILLEGAL;
+			else if(row != 0xD) wr8(c, addr, b);
+		}
+	} else {
+		// Columns 1 and A to F: accumulator and index register operations
+		// with all other addressing modes. Stores of an index register to
+		// memory indexed by that same register store the other one instead.
+		if(col == 0x1 && (row == 0x6 || row == 0x7)) {
+			rx = &emu->y;
+		} else if(col == 0x1) {
+			rx = &emu->x;
+		}
+		w = *rx;
+		if(col >= 0xD && (row == 0x3 || row == 0xF)) rx = ry;
+		cycles = regular_cycles(pre, col, row);
+		if(col == 0x1 && (row == 0xC || row == 0xD)) {
+			// ADDW/SUBW X,#word
+			w = fetch16(c);
+			emu->x = (row == 0xC ? add16(emu, emu->x, w) : sub16(emu, emu->x, w, false));
+		} else if(!op_addr(c, pre, col, ((row == 0x3 || row == 0xE) ? 2 : 1), w, &addr)) {
+			status = STM8EMU_ERR_ILLEGAL;
+		} else {
+			switch(row) {
+				case 0x3: // CPW
+					sub16(emu, *rx, rd16(c, addr), true);
+					break;
+				case 0x6: // LD A,mem / LDW Y,(shortoff,SP)
+					if(col == 0x1) {
+						*rx = rd16(c, addr);
+						set_flags(emu, FLAGS_NZ, nz16(*rx));
+					} else {
+						emu->a = rd8(c, addr);
+						set_flags(emu, FLAGS_NZ, nz8(emu->a));
+					}
+					break;
+				case 0x7: // LD mem,A / LDW (shortoff,SP),Y
+					if(col == 0x1) {
+						wr16(c, addr, *rx);
+						set_flags(emu, FLAGS_NZ, nz16(*rx));
+					} else {
+						wr8(c, addr, emu->a);
+						set_flags(emu, FLAGS_NZ, nz8(emu->a));
+					}
+					break;
+				case 0xC: // JP
+					emu->pc = (emu->pc & 0xFF0000) | (uint16_t)addr;
+					break;
+				case 0xD: // CALL
+					push16(c, (uint16_t)emu->pc);
+					emu->pc = (emu->pc & 0xFF0000) | (uint16_t)addr;
+					break;
+				case 0xE: // LDW X/Y,mem
+					*rx = rd16(c, addr);
+					set_flags(emu, FLAGS_NZ, nz16(*rx));
+					break;
+				case 0xF: // LDW mem,X/Y
+					wr16(c, addr, *rx);
+					set_flags(emu, FLAGS_NZ, nz16(*rx));
+					break;
+				default:
+					emu->a = alu8(emu, row, emu->a, rd8(c, addr));
+					break;
+			}
+		}
+	}
+
+	if(status == STM8EMU_OK && ctx.fault) status = STM8EMU_ERR_ADDRESS;
+	if(status == STM8EMU_OK) {
+		emu->steps++;
+		emu->cycles += cycles + ctx.wait_cycles;
+		if(emu->sp < emu->sp_low) emu->sp_low = emu->sp;
+		// The prefetched word is discarded if control was transferred.
+		if(emu->wait_states > 0 && emu->pc != ctx.fetch_end) emu->fetch_word = FETCH_WORD_NONE;
+	}
+
+	return status;
+}
+
+void stm8emu_reset(stm8emu_t *emu) {
+	// Memory contents are retained.
+	emu->a = 0;
+	emu->x = 0;
+	emu->y = 0;
+	emu->sp = 0x03FF;
+	emu->sp_low = emu->sp;
+	emu->cc = STM8EMU_CC_I1 | STM8EMU_CC_I0;
+	emu->pc = 0x8000;
+	emu->steps = 0;
+	emu->cycles = 0;
+	emu->fault_pc = 0;
+	emu->fetch_word = FETCH_WORD_NONE;
+}
+
+static void cover_edge(stm8emu_t *emu, const uint32_t from) {
+	// Edges are identified by hashing the addresses of the instruction just
+	// executed and the one it passed control to, so straight-line code and
+	// each direction of a branch count separately. Counts saturate.
+	uint8_t *count = &emu->coverage[((from * 0x9E3779B1UL) ^ emu->pc) & (STM8EMU_COV_SIZE - 1)];
+	if(*count < 0xFF) (*count)++;
+}
+
+stm8emu_status_t stm8emu_run(stm8emu_t *emu, const uint32_t stop_pc, const uint64_t max_steps) {
+	stm8emu_status_t status;
+	const uint64_t limit = emu->steps + max_steps;
+	uint32_t from;
+
+	while(emu->pc != stop_pc) {
+		if(emu->steps >= limit) return STM8EMU_ERR_LIMIT;
+		from = emu->pc;
+		if((status = stm8emu_step(emu)) != STM8EMU_OK) return status;
+		if(emu->coverage != NULL) cover_edge(emu, from);
+	}
+
+	return STM8EMU_OK;
+}
+
+stm8emu_status_t stm8emu_call(stm8emu_t *emu, const uint32_t addr, const bool large, const uint8_t a, const uint16_t x, const uint8_t *stack_args, const uint8_t stack_len, const uint64_t max_steps) {
+	// Calls a function according to SDCC's calling convention version 1. The
+	// first argument is in A (if 8-bit) or X (if 16-bit), the second in X or A
+	// respectively if it fits, and the rest on the stack, first lowest. In the
+	// medium model, the callee removes stack arguments before returning with
+	// RET; in the large model, it returns with RETF and the caller removes
+	// them. The instruction and cycle counts are carried over from previous
+	// calls.
+	const uint8_t ret_size = (large ? 3 : 2);
+	const uint64_t steps = emu->steps, cycles = emu->cycles;
+	stm8emu_status_t status;
+	uint16_t expected_sp;
+
+	stm8emu_reset(emu);
+	emu->steps = steps;
+	emu->cycles = cycles;
+	emu->a = a;
+	emu->x = x;
+	emu->y = 0xA55A;
+	emu->cc = 0;
+	emu->sp = (uint16_t)(STM8EMU_CALL_STACK_TOP - stack_len);
+	if(stack_len > 0) memcpy(&emu->mem[emu->sp + 1], stack_args, stack_len);
+	expected_sp = (large ? emu->sp : STM8EMU_CALL_STACK_TOP);
+	emu->sp -= ret_size;
+	memset(&emu->mem[emu->sp + 1], (STM8EMU_CALL_RETURN_ADDR >> 16) & 0xFF, ret_size);
+	emu->mem[emu->sp + ret_size - 1] = (STM8EMU_CALL_RETURN_ADDR >> 8) & 0xFF;
+	emu->mem[emu->sp + ret_size] = STM8EMU_CALL_RETURN_ADDR & 0xFF;
+	emu->sp_low = emu->sp;
+	emu->pc = addr;
+
+	if((status = stm8emu_run(emu, STM8EMU_CALL_RETURN_ADDR, max_steps)) != STM8EMU_OK) return status;
+	if(emu->sp != expected_sp) {
+		emu->fault_pc = emu->pc;
+		return STM8EMU_ERR_STACK;
+	}
+
+	return STM8EMU_OK;
+}
+
+/******************************************************************************/
+
+static int hex_byte(const char *s) {
+	int hi, lo;
+
+	if(!isxdigit((unsigned char)s[0]) || !isxdigit((unsigned char)s[1])) return -1;
+	hi = (isdigit((unsigned char)s[0]) ? s[0] - '0' : toupper((unsigned char)s[0]) - 'A' + 10);
+	lo = (isdigit((unsigned char)s[1]) ? s[1] - '0' : toupper((unsigned char)s[1]) - 'A' + 10);
+
+	return (hi << 4) | lo;
+}
+
+bool stm8emu_load_ihx(stm8emu_t *emu, const char *path) {
+	// Intel HEX, as output by SDCC. Extended linear and segment address records
+	// are supported for images in the large memory model above 64 KB.
+	// A record is a length, address, type, up to 255 data bytes and checksum.
+	char line[600];
+	uint8_t rec[255 + 5];
+	uint32_t base = 0, addr;
+	unsigned long line_num = 0;
+	int len, val;
+	uint8_t sum;
+	FILE *file;
+
+	if((file = fopen(path, "r")) == NULL) {
+		perror(path);
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		line_num++;
+		if(line[0] != ':') continue;
+
+		sum = 0;
+		len = hex_byte(&line[1]);
+		for(int i = 0; len >= 0 && i < len + 5; i++) {
+			if((val = hex_byte(&line[1 + i * 2])) < 0) {
+				len = -1;
+				break;
+			}
+			rec[i] = (uint8_t)val;
+			sum += (uint8_t)val;
+		}
+		if(len < 0 || sum != 0) {
+			fprintf(stderr, "%s:%lu: Error: malformed record\n", path, line_num);
+			fclose(file);
+			return false;
+		}
+
+		addr = base + (uint32_t)((rec[1] << 8) | rec[2]);
+		switch(rec[3]) {
+			case 0x00:
+				if(addr + len > STM8EMU_MEM_SIZE) {
+					fprintf(stderr, "%s:%lu: Error: data outside of address space\n", path, line_num);
+					fclose(file);
+					return false;
+				}
+				memcpy(&emu->mem[addr], &rec[4], len);
+				break;
+			case 0x01:
+				fclose(file);
+				return true;
+			case 0x02:
+				base = (uint32_t)((rec[4] << 8) | rec[5]) << 4;
+				break;
+			case 0x04:
+				base = (uint32_t)((rec[4] << 8) | rec[5]) << 16;
+				break;
+			default:
+				break;
+		}
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+bool stm8emu_load_map(stm8emu_symtab_t *symtab, const char *path) {
+	// Global symbols are listed in the linker map file on lines consisting of
+	// a hex address followed by the symbol name (then its module name).
+	char line[512], name[STM8EMU_SYMBOL_MAX];
+	stm8emu_symbol_t *syms;
+	size_t capacity = 0;
+	unsigned long addr;
+	FILE *file;
+
+	symtab->symbols = NULL;
+	symtab->count = 0;
+
+	if((file = fopen(path, "r")) == NULL) {
+		perror(path);
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		if(sscanf(line, " %lx %63s", &addr, name) != 2 || name[0] != '_') continue;
+		if(symtab->count == capacity) {
+			capacity = (capacity > 0 ? capacity * 2 : 256);
+			if((syms = realloc(symtab->symbols, capacity * sizeof(*syms))) == NULL) {
+				fputs("Error: out of memory\n", stderr);
+				stm8emu_free_map(symtab);
+				fclose(file);
+				return false;
+			}
+			symtab->symbols = syms;
+		}
+		strcpy(symtab->symbols[symtab->count].name, name);
+		symtab->symbols[symtab->count].addr = (uint32_t)addr;
+		symtab->count++;
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+bool stm8emu_symbol_addr(const stm8emu_symtab_t *symtab, const char *name, uint32_t *addr) {
+	// Names may be given with or without the leading underscore that C symbols
+	// have in the map.
+	for(size_t i = 0; i < symtab->count; i++) {
+		const char *sym = symtab->symbols[i].name;
+		if(strcmp(sym, name) == 0 || (name[0] != '_' && strcmp(sym + 1, name) == 0)) {
+			*addr = symtab->symbols[i].addr;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void stm8emu_free_map(stm8emu_symtab_t *symtab) {
+	free(symtab->symbols);
+	symtab->symbols = NULL;
+	symtab->count = 0;
+}
+
+const char *stm8emu_status_str(const stm8emu_status_t status) {
+	switch(status) {
+		case STM8EMU_OK: return "OK";
+		case STM8EMU_ERR_ILLEGAL: return "illegal or unsupported instruction";
+		case STM8EMU_ERR_ADDRESS: return "access outside of address space";
+		case STM8EMU_ERR_HALT: return "halt or interrupt instruction";
+		case STM8EMU_ERR_LIMIT: return "instruction limit exceeded";
+		case STM8EMU_ERR_STACK: return "stack not correctly unwound on return";
+		default: return "unknown error";
+	}
+}
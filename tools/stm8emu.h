@@ -0,0 +1,114 @@
+/*******************************************************************************
+ *
+ * stm8emu.h - STM8 CPU instruction set emulator header
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifndef STM8EMU_H_
+#define STM8EMU_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Size of emulated address space. Large enough for the 128 KB of flash (from
+// 0x8000) of the largest STM8S/AF devices, plus the far pointer/extended
+// address instructions used to reach it.
+#define STM8EMU_MEM_SIZE 0x28000
+
+#define STM8EMU_SYMBOL_MAX 64
+
+// Number of entries in a coverage map. Must be a power of two.
+#define STM8EMU_COV_SIZE 4096
+
+// Start of flash memory. Instruction fetches and data reads from here onwards
+// incur any wait states that are configured.
+#define STM8EMU_FLASH_START 0x8000
+
+// Layout of RAM used by stm8emu_call(). The stack grows down from the top of
+// 2 KB of RAM, which all STM8 devices have, and the called function returns to
+// an address at which emulation is stopped.
+#define STM8EMU_CALL_STACK_TOP 0x07FF
+#define STM8EMU_CALL_RETURN_ADDR 0x000000
+
+// Condition code register flags.
+#define STM8EMU_CC_V 0x80
+#define STM8EMU_CC_I1 0x20
+#define STM8EMU_CC_H 0x10
+#define STM8EMU_CC_I0 0x08
+#define STM8EMU_CC_N 0x04
+#define STM8EMU_CC_Z 0x02
+#define STM8EMU_CC_C 0x01
+
+typedef enum {
+	STM8EMU_OK = 0,
+	STM8EMU_ERR_ILLEGAL,	// Unknown or unsupported opcode
+	STM8EMU_ERR_ADDRESS,	// Access outside of emulated address space
+	STM8EMU_ERR_HALT,		// HALT, WFI, WFE, TRAP, BREAK, INT or IRET
+	STM8EMU_ERR_LIMIT,		// Too many instructions executed
+	STM8EMU_ERR_STACK,		// Stack pointer not as expected after a call
+} stm8emu_status_t;
+
+typedef struct {
+	uint32_t pc;
+	uint16_t x;
+	uint16_t y;
+	uint16_t sp;
+	uint16_t sp_low; // Lowest value of SP after any instruction (i.e. deepest stack)
+	uint8_t a;
+	uint8_t cc;
+	uint64_t steps; // Instructions executed
+	uint64_t cycles; // CPU cycles taken by instructions executed
+	uint8_t wait_states; // Flash wait states (0 or 1 on real devices)
+	uint32_t fetch_word; // Address (divided by 4) of flash word last fetched
+	uint32_t fault_pc; // Address of instruction that caused an error
+	uint8_t *coverage; // If not NULL, hit count of each control flow edge taken (hashed)
+	uint8_t mem[STM8EMU_MEM_SIZE];
+} stm8emu_t;
+
+typedef struct {
+	char name[STM8EMU_SYMBOL_MAX];
+	uint32_t addr;
+} stm8emu_symbol_t;
+
+typedef struct {
+	stm8emu_symbol_t *symbols;
+	size_t count;
+} stm8emu_symtab_t;
+
+/******************************************************************************/
+
+extern void stm8emu_reset(stm8emu_t *emu);
+extern stm8emu_status_t stm8emu_step(stm8emu_t *emu);
+extern stm8emu_status_t stm8emu_run(stm8emu_t *emu, const uint32_t stop_pc, const uint64_t max_steps);
+extern stm8emu_status_t stm8emu_call(stm8emu_t *emu, const uint32_t addr, const bool large, const uint8_t a, const uint16_t x, const uint8_t *stack_args, const uint8_t stack_len, const uint64_t max_steps);
+
+extern bool stm8emu_load_ihx(stm8emu_t *emu, const char *path);
+
+extern bool stm8emu_load_map(stm8emu_symtab_t *symtab, const char *path);
+extern bool stm8emu_symbol_addr(const stm8emu_symtab_t *symtab, const char *name, uint32_t *addr);
+extern void stm8emu_free_map(stm8emu_symtab_t *symtab);
+
+extern const char *stm8emu_status_str(const stm8emu_status_t status);
+
+#endif // STM8EMU_H_
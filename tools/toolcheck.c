@@ -0,0 +1,715 @@
+/*******************************************************************************
+ *
+ * toolcheck.c - Host test program for host tool modules
+ *
+ * Copyright (c) 2023 Basil Hussain
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+// Tracing is compiled into the host copy of lin_trace.c used here, so its
+// functions must be declared.
+#define LIN_TRACE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lin_checksum.h"
+#include "lincap.h"
+#include "lin_index.h"
+#include "lin_pack.h"
+#include "lin_analyze.h"
+#include "lin_frames.h"
+#include "ldfcheck.h"
+#include "lin_bus.h"
+#include "lin_master.h"
+#include "lin_gateway.h"
+#include "lin_trace.h"
+#include "lin_trace_decode.h"
+
+// Tests of the modules behind the host tools, which (unlike the library) are
+// not covered by the test program run in the simulator. Output follows that
+// of the test program. Scratch files are written to the folder given as the
+// argument (the current folder by default). The ldfcheck tables and functions
+// are generated by linldf from toolcheck.ldf when building. Trace dumps are
+// made by a host build of the library's trace buffer, whose timestamps are
+// record sequence numbers.
+
+// Number of records in the capture indexed, and records per index block.
+#define INDEX_TEST_RECORDS 1000
+#define INDEX_TEST_BLOCK 64
+
+// Number of frames packed and unpacked at each data length.
+#define PACK_TEST_FRAMES 400
+
+// Number of sets of signal values or frame data each generated pack or unpack
+// function is tested with: all zeroes, all ones, then pseudo-random.
+#define LDF_TEST_CASES 16
+
+// Room for the trace dumps made by the trace test.
+#define TRACE_TEST_BUF_SIZE 1024
+
+typedef struct {
+	unsigned int pass_count;
+	unsigned int fail_count;
+} test_result_t;
+
+#define print_test_name() \
+	do { \
+		puts("----------------------------------------"); \
+		puts(__func__); \
+		puts("----------------------------------------"); \
+	} while(0)
+
+#define count_test_result(x, r) \
+	do { \
+		puts((x) ? "PASS" : "FAIL"); \
+		if(x) { \
+			(r)->pass_count++; \
+		} else { \
+			(r)->fail_count++; \
+		} \
+	} while(0)
+
+static const char *scratch_dir = ".";
+
+/******************************************************************************/
+
+static void scratch_path(char *path, const size_t size, const char *name) {
+	snprintf(path, size, "%s/%s", scratch_dir, name);
+}
+
+static void index_test_frame(const uint32_t rec, lincap_frame_t *frame) {
+	// Pairs of records share a time, frame IDs cycle through 0 to 6, and every
+	// tenth record has a bad checksum.
+	memset(frame, 0, sizeof(*frame));
+	frame->time_us = (uint64_t)(rec / 2) * 1000;
+	frame->pid = lin_get_protected_id((uint8_t)(rec % 7));
+	frame->data_len = (uint8_t)(rec % 9);
+	for(uint8_t i = 0; i < frame->data_len; i++) frame->data[i] = (uint8_t)(rec + i);
+	frame->cksum = lin_calculate_checksum_enhanced(frame->pid, frame->data, frame->data_len);
+	if(rec % 10 == 0) frame->cksum ^= 0x01;
+}
+
+static bool index_test_matches(const lin_index_query_t *query, const uint32_t rec) {
+	lincap_frame_t frame;
+
+	index_test_frame(rec, &frame);
+	return ((query->fid == LIN_INDEX_ANY_FID || query->fid == (frame.pid & 0x3F)) &&
+		frame.time_us >= query->time_from && frame.time_us < query->time_to &&
+		(!query->failed_only || rec % 10 == 0));
+}
+
+typedef struct {
+	const lin_index_query_t *query;
+	uint32_t count;
+	int32_t last; // Record of last match, to check they are in order
+	bool ok;
+} index_test_ctx_t;
+
+static bool index_test_match(const uint32_t record, const lincap_frame_t *frame, void *ctx) {
+	// Each match must be one the query asks for, in ascending order, and read
+	// back from the capture intact.
+	index_test_ctx_t *c = ctx;
+	lincap_frame_t expected;
+
+	index_test_frame(record, &expected);
+	if(!index_test_matches(c->query, record) || (int32_t)record <= c->last ||
+		frame->time_us != expected.time_us || frame->pid != expected.pid || frame->data_len != expected.data_len ||
+		memcmp(frame->data, expected.data, expected.data_len) != 0 || frame->cksum != expected.cksum) {
+		c->ok = false;
+	}
+	c->last = (int32_t)record;
+	c->count++;
+
+	return true;
+}
+
+static void test_index(test_result_t *results) {
+	// A capture with a trailing partial record is indexed, and the index saved
+	// and loaded again. It must not be stale until the capture changes, and
+	// each query must match exactly the records a scan of the capture finds.
+	static const lin_index_query_t queries[] = {
+		{ LIN_INDEX_ANY_FID, 0, UINT64_MAX, false },
+		{ 3, 0, UINT64_MAX, false },
+		{ 3, 100500, 250000, false },
+		{ LIN_INDEX_ANY_FID, 100000, 100001, false }, // Time shared by two records
+		{ LIN_INDEX_ANY_FID, 0, UINT64_MAX, true },
+		{ 5, 20000, 400000, true },
+		{ 6, 500000, 500000, false }, // Empty range
+		{ LIN_INDEX_ANY_FID, 1000000, UINT64_MAX, false }, // After last record
+	};
+	static const uint8_t partial[10] = { 0 };
+	char cap_path[1024], idx_path[1024];
+	lin_index_t built, idx;
+	lincap_writer_t wr;
+	lincap_reader_t cap;
+	lincap_frame_t frame;
+	lin_index_stats_t stats;
+	index_test_ctx_t ctx;
+	uint32_t expected;
+	FILE *file;
+	bool pass;
+
+	print_test_name();
+
+	scratch_path(cap_path, sizeof(cap_path), "toolcheck.lcap");
+	scratch_path(idx_path, sizeof(idx_path), "toolcheck.lcap.idx");
+
+	puts("TEST 01:");
+	pass = lincap_create(&wr, cap_path, LINCAP_DEFAULT_BAUD);
+	for(uint32_t rec = 0; pass && rec < INDEX_TEST_RECORDS; rec++) {
+		index_test_frame(rec, &frame);
+		pass = lincap_write(&wr, &frame);
+	}
+	if(pass) pass = lincap_finish(&wr);
+	if(pass && (file = fopen(cap_path, "ab")) != NULL) {
+		pass = (fwrite(partial, sizeof(partial), 1, file) == 1);
+		pass = (fclose(file) == 0) && pass;
+	}
+	pass = pass && lin_index_build(&built, cap_path, INDEX_TEST_BLOCK);
+	if(!pass) {
+		puts("can't create capture and index");
+		count_test_result(false, results);
+		return;
+	}
+	printf("records = %u, blocks = %u, capture size = %llu\n", built.record_count, built.block_count, (unsigned long long)built.capture_size);
+	pass = (built.record_count == INDEX_TEST_RECORDS && built.block_count == (INDEX_TEST_RECORDS + INDEX_TEST_BLOCK - 1) / INDEX_TEST_BLOCK &&
+		built.capture_size == LINCAP_HEADER_SIZE + (uint64_t)INDEX_TEST_RECORDS * LINCAP_RECORD_SIZE + sizeof(partial) &&
+		!lin_index_is_stale(&built, cap_path));
+	count_test_result(pass, results);
+
+	puts("TEST 02:");
+	pass = lin_index_save(&built, idx_path) && lin_index_load(&idx, idx_path);
+	if(pass) {
+		pass = (idx.record_count == built.record_count && idx.block_records == built.block_records &&
+			idx.block_count == built.block_count && idx.capture_size == built.capture_size &&
+			memcmp(idx.posting_count, built.posting_count, sizeof(idx.posting_count)) == 0 &&
+			memcmp(idx.block_time, built.block_time, built.block_count * sizeof(uint64_t)) == 0 &&
+			memcmp(idx.postings, built.postings, built.record_count * sizeof(uint32_t)) == 0 &&
+			memcmp(idx.fail_bitmap, built.fail_bitmap, (built.record_count + 7) / 8) == 0);
+	}
+	printf("saved and loaded %s\n", (pass ? "identically" : "differently"));
+	lin_index_free(&built);
+	count_test_result(pass, results);
+	if(!pass) return;
+
+	for(size_t i = 0; i < (sizeof(queries) / sizeof(queries[0])); i++) {
+		printf("TEST %02u:\n", (unsigned int)i + 3);
+		expected = 0;
+		for(uint32_t rec = 0; rec < INDEX_TEST_RECORDS; rec++) {
+			if(index_test_matches(&queries[i], rec)) expected++;
+		}
+		ctx.query = &queries[i];
+		ctx.count = 0;
+		ctx.last = -1;
+		ctx.ok = true;
+		pass = lincap_open(&cap, cap_path);
+		if(pass) {
+			pass = lin_index_query(&idx, &cap, &queries[i], index_test_match, &ctx, &stats);
+			lincap_close(&cap);
+		}
+		printf("fid = %d, from = %llu, to = %llu, failed only = %d: expected = %u, matches = %u, candidates = %u\n",
+			queries[i].fid, (unsigned long long)queries[i].time_from, (unsigned long long)queries[i].time_to,
+			queries[i].failed_only, expected, ctx.count, stats.candidates);
+		pass = pass && ctx.ok && ctx.count == expected && stats.matches == expected;
+		count_test_result(pass, results);
+	}
+
+	printf("TEST %02u:\n", (unsigned int)(sizeof(queries) / sizeof(queries[0])) + 3);
+	if((file = fopen(cap_path, "ab")) != NULL) {
+		fputc(0, file);
+		fclose(file);
+	}
+	pass = lin_index_is_stale(&idx, cap_path);
+	printf("stale after capture changed = %d\n", pass);
+	count_test_result(pass, results);
+
+	lin_index_free(&idx);
+	remove(cap_path);
+	remove(idx_path);
+}
+
+static uint32_t pack_rand(uint32_t *state) {
+	// xorshift32
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static void test_pack(test_result_t *results) {
+	// Frames of eight IDs in turn, all with the same data length, are packed
+	// and unpacked again, and every field must come back the same. The
+	// payload of each ID goes through a cycle of new, repeated, changed in one
+	// byte, and back to the one before last, so that each way of encoding it
+	// is used. Frame IDs alternate between classic and enhanced checksums, and
+	// there are occasional bad checksums, missing responses, and timing
+	// jitter both small and large. Payload modes used are counted from the
+	// low two bits of each control byte (see lin_pack.c).
+	static lincap_frame_t frames[PACK_TEST_FRAMES];
+	static uint8_t packed[PACK_TEST_FRAMES * LIN_PACK_TOKEN_MAX];
+	lin_pack_payload_t last[8], before_last[8];
+	lin_pack_state_t st;
+	lincap_frame_t *f, frame;
+	uint32_t modes[4], rng = 1, mismatches;
+	uint64_t time_us = 0;
+	size_t len, pos, n;
+	uint8_t fid;
+	bool pass;
+
+	print_test_name();
+
+	for(uint8_t data_len = 0; data_len <= LINCAP_DATA_MAX; data_len++) {
+		printf("TEST %02u:\n", data_len + 1);
+
+		memset(last, 0, sizeof(last));
+		memset(before_last, 0, sizeof(before_last));
+		for(uint32_t k = 0; k < PACK_TEST_FRAMES; k++) {
+			f = &frames[k];
+			memset(f, 0, sizeof(*f));
+			fid = (uint8_t)(k % 8);
+			time_us += 1000 + (k % 5 == 0 ? 3 : 0) + (k % 11 == 0 ? 500 : 0);
+			f->time_us = time_us;
+			f->resp_delay_us = (uint16_t)(200 + (k % 7 == 0 ? 2 : 0) + (k % 23 == 0 ? 1000 : 0));
+			f->pid = lin_get_protected_id(fid);
+			f->flags = (fid % 2 == 0 ? LINCAP_FLAG_CLASSIC : 0);
+
+			if(k % 17 == 16) {
+				f->flags |= LINCAP_FLAG_NO_RESPONSE;
+				continue;
+			}
+
+			f->data_len = data_len;
+			switch((k / 8) % 6) {
+				case 1:
+				case 4:
+					memcpy(f->data, last[fid].data, data_len);
+					break;
+				case 2:
+					memcpy(f->data, last[fid].data, data_len);
+					if(data_len > 0) f->data[(k / 8) % data_len] ^= 0x5A;
+					break;
+				case 3:
+					memcpy(f->data, before_last[fid].data, data_len);
+					break;
+				default:
+					for(uint8_t i = 0; i < data_len; i++) f->data[i] = (uint8_t)pack_rand(&rng);
+					break;
+			}
+			if(memcmp(f->data, last[fid].data, data_len) != 0) {
+				before_last[fid] = last[fid];
+				memcpy(last[fid].data, f->data, data_len);
+			}
+
+			if(f->flags & LINCAP_FLAG_CLASSIC) {
+				f->cksum = lin_calculate_checksum_classic(f->data, f->data_len);
+			} else {
+				f->cksum = lin_calculate_checksum_enhanced(f->pid, f->data, f->data_len);
+			}
+			if(k % 13 == 12) f->cksum ^= 0x01;
+		}
+
+		memset(modes, 0, sizeof(modes));
+		lin_pack_init(&st);
+		len = 0;
+		for(uint32_t k = 0; k < PACK_TEST_FRAMES; k++) {
+			n = lin_pack_encode(&st, &frames[k], packed + len);
+			modes[packed[len] & 0x03]++;
+			len += n;
+		}
+
+		mismatches = 0;
+		lin_pack_init(&st);
+		pos = 0;
+		for(uint32_t k = 0; k < PACK_TEST_FRAMES; k++) {
+			f = &frames[k];
+			memset(&frame, 0, sizeof(frame));
+			n = lin_pack_decode(&st, packed + pos, len - pos, &frame);
+			if(n == 0 || frame.time_us != f->time_us || frame.resp_delay_us != f->resp_delay_us || frame.pid != f->pid ||
+				frame.data_len != f->data_len || memcmp(frame.data, f->data, f->data_len) != 0 || frame.cksum != f->cksum ||
+				frame.flags != f->flags) {
+				mismatches++;
+			}
+			if(n == 0) break;
+			pos += n;
+		}
+
+		printf("data length = %u, packed = %u bytes, same = %u, dictionary = %u, delta = %u, literal = %u, mismatches = %u\n",
+			data_len, (unsigned int)len, modes[0], modes[1], modes[2], modes[3], mismatches);
+		pass = (mismatches == 0 && pos == len && (data_len < 1 || (modes[1] > 0 && modes[3] > 0)) && (data_len < 2 || modes[2] > 0));
+		count_test_result(pass, results);
+	}
+}
+
+static unsigned int partial_windows;
+
+static void count_partial(const lin_analyze_window_t *window, void *ctx) {
+	(void)ctx;
+	if(window->partial) partial_windows++;
+}
+
+static void test_analyze_windows(test_result_t *results) {
+	// Each case analyses a number of 8-byte frames at a fixed period from time
+	// zero, plus optionally one more frame on its own at a later time, with
+	// 1 second windows. Each frame takes 6458 us at 19200 baud, so 100 frames
+	// in a window give a load of 64.58% (in the 60-70% band). The last window
+	// is partial, and must not count towards the peak or load bands.
+	static const struct {
+		uint32_t count;
+		uint64_t period_us;
+		uint64_t extra_us; // Zero for none
+		uint32_t expected_windows;
+		uint32_t expected_band_6;
+	} tests[] = {
+		{ 100, 10000, 1000000, 1, 1 }, // Lone frame in last window
+		{ 100, 10000, 1999999, 1, 1 },
+		{ 50, 10000, 0, 0, 0 }, // Shorter than a window
+		{ 250, 10000, 0, 2, 2 },
+		{ 100, 10000, 2500000, 2, 1 }, // Empty window in between
+	};
+	static lin_analyze_t an;
+	lincap_frame_t frame;
+	uint32_t band_total;
+	double peak;
+	bool pass;
+
+	print_test_name();
+
+	memset(&frame, 0, sizeof(frame));
+	frame.pid = lin_get_protected_id(0x10);
+	frame.data_len = 8;
+	frame.cksum = lin_calculate_checksum_enhanced(frame.pid, frame.data, frame.data_len);
+
+	for(size_t i = 0; i < (sizeof(tests) / sizeof(tests[0])); i++) {
+		printf("TEST %02u:\n", (unsigned int)i + 1);
+		partial_windows = 0;
+		lin_analyze_init(&an, LINCAP_DEFAULT_BAUD, 1000000, count_partial, NULL);
+		for(uint32_t j = 0; j < tests[i].count; j++) {
+			frame.time_us = j * tests[i].period_us;
+			lin_analyze_frame(&an, &frame);
+		}
+		if(tests[i].extra_us > 0) {
+			frame.time_us = tests[i].extra_us;
+			lin_analyze_frame(&an, &frame);
+		}
+		lin_analyze_finish(&an);
+
+		band_total = 0;
+		for(unsigned int b = 0; b < LIN_ANALYZE_LOAD_BANDS; b++) band_total += an.band_windows[b];
+		peak = (an.window_count > 0 ? 100.0 * an.peak_window.busy_us / an.peak_window.length_us : 0.0);
+		pass = (an.window_count == tests[i].expected_windows && band_total == tests[i].expected_windows &&
+			an.band_windows[6] == tests[i].expected_band_6 && partial_windows == 1 && peak <= 100.0 &&
+			(an.window_count == 0 || !an.peak_window.partial));
+		printf("windows = %u, band 6 = %u, partial = %u, peak = %.1f%%\n", an.window_count, an.band_windows[6], partial_windows, peak);
+		count_test_result(pass, results);
+	}
+}
+
+static uint32_t rng_state = 1;
+
+static uint16_t test_value(const unsigned int n) {
+	// xorshift32
+	if(n == 0) return 0x0000;
+	if(n == 1) return 0xFFFF;
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return (uint16_t)rng_state;
+}
+
+static void model_put_bits(uint8_t *data, const unsigned int offset, const unsigned int size, const uint16_t val) {
+	// Bit by bit, as linldf does for initial values.
+	for(unsigned int i = 0; i < size; i++) {
+		const unsigned int bit = offset + i;
+		if(val & (1U << i)) {
+			data[bit / 8] |= (uint8_t)(1 << (bit % 8));
+		} else {
+			data[bit / 8] &= (uint8_t)~(1 << (bit % 8));
+		}
+	}
+}
+
+static uint16_t model_get_bits(const uint8_t *data, const unsigned int offset, const unsigned int size) {
+	uint16_t val = 0;
+
+	for(unsigned int i = 0; i < size; i++) {
+		const unsigned int bit = offset + i;
+		if(data[bit / 8] & (1 << (bit % 8))) val |= (uint16_t)(1U << i);
+	}
+
+	return val;
+}
+
+static void print_data(const char *name, const uint8_t *data, const uint8_t len) {
+	printf("%s:", name);
+	for(uint8_t i = 0; i < len; i++) printf(" %02X", data[i]);
+	putchar('\n');
+}
+
+static void test_ldf_pack(test_result_t *results) {
+	// Signal values are given with bits set above each signal's size, which
+	// must not leak into the frame. The frame data written, and the checksum
+	// returned, must match those made bit by bit with unused bits set, and the
+	// checksum functions of the library.
+	const lin_frame_def_t *tx = &ldfcheck_frames[LDFCHECK_FRAME_CEMTX];
+	const lin_frame_def_t *old = &ldfcheck_frames[LDFCHECK_FRAME_CEMOLD];
+	ldfcheck_CemTx_t tx_sig;
+	ldfcheck_CemOld_t old_sig;
+	uint8_t tx_expected[8], old_expected[8], tx_cksum, old_cksum;
+	bool pass;
+
+	print_test_name();
+
+	for(unsigned int i = 0; i < LDF_TEST_CASES; i++) {
+		printf("TEST %02u:\n", i + 1);
+
+		tx_sig.TxFlag = (uint8_t)test_value(i);
+		tx_sig.TxSpan = (uint8_t)test_value(i);
+		tx_sig.TxWide = test_value(i);
+		tx_sig.TxWord = test_value(i);
+		tx_sig.TxArray[0] = (uint8_t)test_value(i);
+		tx_sig.TxArray[1] = (uint8_t)test_value(i);
+		memset(tx_expected, 0xFF, sizeof(tx_expected));
+		model_put_bits(tx_expected, 0, 1, tx_sig.TxFlag);
+		model_put_bits(tx_expected, 5, 7, tx_sig.TxSpan);
+		model_put_bits(tx_expected, 12, 13, tx_sig.TxWide);
+		model_put_bits(tx_expected, 27, 16, tx_sig.TxWord);
+		model_put_bits(tx_expected, 48, 8, tx_sig.TxArray[0]);
+		model_put_bits(tx_expected, 56, 8, tx_sig.TxArray[1]);
+
+		old_sig.OldBits = (uint8_t)test_value(i);
+		old_sig.OldWide = test_value(i);
+		old_sig.OldByte = (uint8_t)test_value(i);
+		old_sig.OldWord = test_value(i);
+		memset(old_expected, 0xFF, sizeof(old_expected));
+		model_put_bits(old_expected, 2, 3, old_sig.OldBits);
+		model_put_bits(old_expected, 9, 10, old_sig.OldWide);
+		model_put_bits(old_expected, 24, 8, old_sig.OldByte);
+		model_put_bits(old_expected, 32, 16, old_sig.OldWord);
+
+		tx_cksum = ldfcheck_pack_CemTx(&tx_sig);
+		old_cksum = ldfcheck_pack_CemOld(&old_sig);
+		print_data("CemTx", &ldfcheck_data[tx->data_offset], tx->data_len);
+		print_data("CemOld", &ldfcheck_data[old->data_offset], old->data_len);
+		printf("checksums = 0x%02X, 0x%02X\n", tx_cksum, old_cksum);
+
+		pass = (memcmp(&ldfcheck_data[tx->data_offset], tx_expected, tx->data_len) == 0 &&
+			memcmp(&ldfcheck_data[old->data_offset], old_expected, old->data_len) == 0 &&
+			!(tx->flags & LIN_FRAME_FLAG_CLASSIC) && (old->flags & LIN_FRAME_FLAG_CLASSIC) &&
+			tx_cksum == lin_calculate_checksum_enhanced(tx->pid, tx_expected, tx->data_len) &&
+			old_cksum == lin_calculate_checksum_classic(old_expected, old->data_len));
+		count_test_result(pass, results);
+	}
+}
+
+static void test_ldf_unpack(test_result_t *results) {
+	// Every signal subscribed to must be read out of the frame data exactly
+	// as it is bit by bit, with no other bits.
+	const lin_frame_def_t *rx = &ldfcheck_frames[LDFCHECK_FRAME_LSMRX];
+	const lin_frame_def_t *rx2 = &ldfcheck_frames[LDFCHECK_FRAME_LSMRX2];
+	uint8_t *rx_data = &ldfcheck_data[rx->data_offset];
+	uint8_t *rx2_data = &ldfcheck_data[rx2->data_offset];
+	ldfcheck_LsmRx_t rx_sig;
+	ldfcheck_LsmRx2_t rx2_sig;
+	bool pass;
+
+	print_test_name();
+
+	for(unsigned int i = 0; i < LDF_TEST_CASES; i++) {
+		printf("TEST %02u:\n", i + 1);
+
+		for(uint8_t j = 0; j < rx->data_len; j++) rx_data[j] = (uint8_t)test_value(i);
+		for(uint8_t j = 0; j < rx2->data_len; j++) rx2_data[j] = (uint8_t)test_value(i);
+		print_data("LsmRx", rx_data, rx->data_len);
+		print_data("LsmRx2", rx2_data, rx2->data_len);
+
+		ldfcheck_unpack_LsmRx(&rx_sig);
+		ldfcheck_unpack_LsmRx2(&rx2_sig);
+		printf("RxFlag = 0x%X, RxSpan = 0x%02X, RxWide = 0x%04X, RxWord = 0x%04X, RxArray = %02X %02X\n",
+			rx_sig.RxFlag, rx_sig.RxSpan, rx_sig.RxWide, rx_sig.RxWord, rx_sig.RxArray[0], rx_sig.RxArray[1]);
+		printf("RxByte = 0x%02X, RxHalf = 0x%04X\n", rx2_sig.RxByte, rx2_sig.RxHalf);
+
+		pass = (rx_sig.RxFlag == model_get_bits(rx_data, 0, 1) &&
+			rx_sig.RxSpan == model_get_bits(rx_data, 5, 7) &&
+			rx_sig.RxWide == model_get_bits(rx_data, 12, 13) &&
+			rx_sig.RxWord == model_get_bits(rx_data, 27, 16) &&
+			rx_sig.RxArray[0] == model_get_bits(rx_data, 48, 8) &&
+			rx_sig.RxArray[1] == model_get_bits(rx_data, 56, 8) &&
+			rx2_sig.RxByte == model_get_bits(rx2_data, 0, 8) &&
+			rx2_sig.RxHalf == model_get_bits(rx2_data, 8, 16));
+		count_test_result(pass, results);
+	}
+}
+
+static uint8_t trace_buf[TRACE_TEST_BUF_SIZE];
+static size_t trace_len;
+
+static int trace_out(int c) {
+	if(trace_len < sizeof(trace_buf)) trace_buf[trace_len++] = (uint8_t)c;
+	return c;
+}
+
+static void trace_test_event(const uint16_t seq, lin_trace_event_t *event) {
+	// Type, PID and status of each record are made from its sequence number,
+	// which on the host is also its timestamp.
+	event->ticks = seq;
+	event->type = (seq % 5 == 4 ? LIN_TRACE_USER + (seq & 3) : LIN_TRACE_BREAK + (seq % 7));
+	event->pid = (uint8_t)(seq * 7);
+	event->status = (uint8_t)(seq ^ 0x5A);
+}
+
+static void trace_test_record(uint16_t *seq, const unsigned int count) {
+	lin_trace_event_t event;
+
+	for(unsigned int i = 0; i < count; i++) {
+		trace_test_event((*seq)++, &event);
+		lin_trace(event.type, event.pid, event.status);
+	}
+}
+
+static bool trace_test_dump(lin_trace_decoder_t *dec, const uint16_t first_seq, const uint16_t prev_seq, const uint16_t expected_lost,
+	const uint8_t expected_count, const uint8_t expected_decoded) {
+	// Decodes the next dump, which must hold the given number of records
+	// starting with the given one. The first record of all has a delta of zero,
+	// and every later one the difference from the record before it (prev_seq),
+	// whether or not records were lost in between.
+	lin_trace_event_t event, expected;
+	uint16_t lost;
+	uint8_t count, decoded = 0;
+	bool ok;
+
+	if(!lin_trace_decode_dump(dec, &lost, &count)) {
+		puts("no dump found");
+		return false;
+	}
+
+	ok = (lost == expected_lost && count == expected_count);
+	while(lin_trace_decode_event(dec, &event)) {
+		trace_test_event((uint16_t)(first_seq + decoded), &expected);
+		expected.delta = (first_seq + decoded == 0 ? 0 : (decoded == 0 ? (uint16_t)(first_seq - prev_seq) : 1));
+		if(event.ticks != expected.ticks || event.delta != expected.delta || event.time != expected.ticks ||
+			event.type != expected.type || event.pid != expected.pid || event.status != expected.status) {
+			ok = false;
+		}
+		decoded++;
+	}
+	printf("lost = %u, records = %u, decoded = %u\n", lost, count, decoded);
+
+	return ok && decoded == expected_decoded;
+}
+
+static void test_trace(test_result_t *results) {
+	// Records are made with the library's portable lin_trace_record and dumped
+	// to a buffer, along with some junk and a partial magic string before the
+	// first dump, as when other output is written to the same file. The dumps
+	// are: 10 records; 45 records, of which the buffer only holds the last
+	// LIN_TRACE_SIZE (32); none; and 3 records, with the last cut short.
+	static const struct {
+		uint8_t type;
+		uint8_t status;
+		const char *expected_type;
+		const char *expected_status;
+	} names[] = {
+		{ LIN_TRACE_HEADER, LIN_BUS_EVT_PID_ERROR, "HEADER", "pid error" },
+		{ LIN_TRACE_SLOT, LIN_MASTER_RESP_COLLISION, "SLOT", "collision" },
+		{ LIN_TRACE_VERIFY_OK, 0x81, "VERIFY_OK", "changed 0x81" },
+		{ LIN_TRACE_FORWARD, LIN_GATEWAY_DROP, "FORWARD", "drop" },
+		{ LIN_TRACE_FORWARD, 2, "FORWARD", "bus 2" },
+		{ LIN_TRACE_USER + 3, 0x42, "USER+3", "0x42" },
+		{ 0x7F, 0x01, "0x7F", "0x01" },
+	};
+	lin_trace_decoder_t dec;
+	char type[16], status[16];
+	uint16_t seq = 0, lost;
+	uint8_t count;
+	FILE *in;
+	bool pass;
+
+	print_test_name();
+
+	for(const char *junk = "xLTRxLT"; *junk != '\0'; junk++) trace_out(*junk);
+	trace_test_record(&seq, 10);
+	lin_trace_dump(trace_out);
+	trace_test_record(&seq, 45);
+	lin_trace_dump(trace_out);
+	lin_trace_dump(trace_out);
+	trace_test_record(&seq, 3);
+	lin_trace_dump(trace_out);
+	trace_len -= 2;
+
+	if((in = fmemopen(trace_buf, trace_len, "rb")) == NULL) {
+		perror("fmemopen");
+		count_test_result(false, results);
+		return;
+	}
+	lin_trace_decode_init(&dec, in);
+
+	puts("TEST 01:");
+	pass = trace_test_dump(&dec, 0, 0, 0, 10, 10);
+	count_test_result(pass, results);
+
+	puts("TEST 02:");
+	pass = trace_test_dump(&dec, 10 + 45 - LIN_TRACE_SIZE, 9, 45 - LIN_TRACE_SIZE, LIN_TRACE_SIZE, LIN_TRACE_SIZE);
+	count_test_result(pass, results);
+
+	puts("TEST 03:");
+	pass = trace_test_dump(&dec, 55, 54, 0, 0, 0);
+	count_test_result(pass, results);
+
+	puts("TEST 04:");
+	pass = trace_test_dump(&dec, 55, 54, 0, 3, 2) && !lin_trace_decode_dump(&dec, &lost, &count);
+	printf("dumps = %u, records = %u, lost = %u\n", dec.dumps, dec.records, dec.lost_total);
+	pass = pass && dec.dumps == 4 && dec.records == 10 + LIN_TRACE_SIZE + 2 && dec.lost_total == 45 - LIN_TRACE_SIZE;
+	count_test_result(pass, results);
+
+	fclose(in);
+
+	for(size_t i = 0; i < (sizeof(names) / sizeof(names[0])); i++) {
+		printf("TEST %02u:\n", (unsigned int)i + 5);
+		lin_trace_format_type(type, sizeof(type), names[i].type);
+		lin_trace_format_status(status, sizeof(status), names[i].type, names[i].status);
+		printf("type = %s, status = %s\n", type, status);
+		pass = (strcmp(type, names[i].expected_type) == 0 && strcmp(status, names[i].expected_status) == 0);
+		count_test_result(pass, results);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	test_result_t results = { 0, 0 };
+
+	if(argc > 1) scratch_dir = argv[1];
+
+	test_index(&results);
+	test_pack(&results);
+	test_analyze_windows(&results);
+	test_ldf_pack(&results);
+	test_ldf_unpack(&results);
+	test_trace(&results);
+
+	puts("----------------------------------------");
+	printf("TOTAL RESULTS: passed = %u, failed = %u\n", results.pass_count, results.fail_count);
+
+	return (results.fail_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}